@@ -392,7 +392,7 @@ void _update_details_page(QueueEvent * qevt, void * user_data){
     gui_update->uri = OnvifBaseService__get_endpoint(ONVIF_BASE_SERVICE(devserv));
     g_object_ref(gui_update->device);
     g_object_ref(gui_update->qevt);
-    gdk_threads_add_idle(G_SOURCE_FUNC(onvif_info_gui_update),gui_update);
+    gui_dispatch(G_SOURCE_FUNC(onvif_info_gui_update),gui_update);
 exit:
     if(hostname)
         g_object_unref(hostname);
@@ -433,9 +433,11 @@ void OnvifInfoPanel_update_details(OnvifInfoPanel * self){
     }
 
     g_signal_emit (self, signals[STARTED], 0, input->device);
-    priv->previous_event = EventQueue__insert_plain(OnvifApp__get_EventQueue(priv->app), input->device, _update_details_page,input, _update_details_page_cleanup);
+    //Hold a reference before the event can be dispatched and recycled
+    QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+    options.hold = TRUE;
+    priv->previous_event = EventQueue__insert_plain_with_options(OnvifApp__get_EventQueue(priv->app), &options, input->device, _update_details_page,input, _update_details_page_cleanup);
     priv->event_signal = g_signal_connect (priv->previous_event, "state-changed", G_CALLBACK (update_details_event_cancelled_cb), input);
-    g_object_ref(priv->previous_event);
 }
 
 void OnvifInfoPanel_clear_details(OnvifInfoPanel * self){
@@ -276,7 +276,7 @@ _update_network_page(QueueEvent * qevt, void * user_data){
     gui_update->inet = inet;
     g_object_ref(input->device); //Adding reference for gui thread
     g_object_ref(gui_update->qevt);
-    gdk_threads_add_idle(G_SOURCE_FUNC(onvif_network_gui_update),gui_update);
+    gui_dispatch(G_SOURCE_FUNC(onvif_network_gui_update),gui_update);
 }
 
 void 
@@ -308,9 +308,11 @@ OnvifNetworkPanel_update_details(OnvifNetworkPanel * self){
     }
 
     g_signal_emit (self, signals[STARTED], 0, input->device);
-    priv->previous_event = EventQueue__insert_plain(OnvifApp__get_EventQueue(priv->app), input->device, _update_network_page,input, _update_network_page_cleanup);
+    //Hold a reference before the event can be dispatched and recycled
+    QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+    options.hold = TRUE;
+    priv->previous_event = EventQueue__insert_plain_with_options(OnvifApp__get_EventQueue(priv->app), &options, input->device, _update_network_page,input, _update_network_page_cleanup);
     priv->event_signal = g_signal_connect (priv->previous_event, "state-changed", G_CALLBACK (update_network_event_cancelled_cb), input);
-    g_object_ref(priv->previous_event);
 }
 
 void OnvifNetworkPanel_clear_details(OnvifNetworkPanel * self){
@@ -235,6 +235,15 @@ OnvifMgrEncryptedStore__check_store_exists(QueueEvent * qevt, void * user_data){
     gdk_threads_add_idle(G_SOURCE_FUNC(OnvifMgrEncryptedStore__show_panel),self);
 }
 
+//Encryption runs on the CPU pool when the queue has one, so it never waits behind network calls
+static void
+OnvifMgrEncryptedStore__dispatch_cpu(OnvifMgrEncryptedStore * self, void (*callback)(QueueEvent * qevt, void * user_data)){
+    OnvifMgrEncryptedStorePrivate *priv = OnvifMgrEncryptedStore__get_instance_private (self);
+    QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+    options.pool = EventQueue__get_pool_id(priv->queue, EVENTQUEUE_POOL_CPU_NAME);
+    EventQueue__insert_with_options(priv->queue, &options, self, callback, self, NULL);
+}
+
 static void 
 OnvifMgrEncryptedStore__reset(GtkWidget * widget, OnvifMgrEncryptedStore * self){
     OnvifMgrEncryptedStorePrivate *priv = OnvifMgrEncryptedStore__get_instance_private (self);
@@ -250,7 +259,7 @@ OnvifMgrEncryptedStore__reset(GtkWidget * widget, OnvifMgrEncryptedStore * self)
     priv->passphrase = malloc(priv->passphrase_len);
     memcpy(priv->passphrase,OnvifMgrTrustStoreDialog__get_passphrase(priv->dialog),priv->passphrase_len);
 
-    EventQueue__insert(priv->queue, self, OnvifMgrEncryptedStore__create_store,self, NULL);
+    OnvifMgrEncryptedStore__dispatch_cpu(self, OnvifMgrEncryptedStore__create_store);
 }
 
 static void 
@@ -269,7 +278,7 @@ OnvifMgrEncryptedStore__login(OnvifMgrTrustStoreDialog * dialog, OnvifMgrEncrypt
         priv->passphrase = malloc(priv->passphrase_len);
         memcpy(priv->passphrase,OnvifMgrTrustStoreDialog__get_passphrase(priv->dialog),priv->passphrase_len);
 
-        EventQueue__insert(priv->queue, self, OnvifMgrEncryptedStore__read_store,self, NULL);
+        OnvifMgrEncryptedStore__dispatch_cpu(self, OnvifMgrEncryptedStore__read_store);
     } else {
         C_DEBUG("Creating new store. '%s'",klass->extension->store_path);
         OnvifMgrEncryptedStore__reset(NULL,self);
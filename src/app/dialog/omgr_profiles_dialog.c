@@ -129,7 +129,7 @@ OnvifMgrProfilesDialog__showing (GtkWidget *widget){
   OnvifMgrProfilesDialog * self = ONVIFMGR_PROFILESDIALOG(widget);
   OnvifMgrProfilesDialogPrivate *priv = OnvifMgrProfilesDialog__get_instance_private (self);
   OnvifMgrAppDialog__show_loading(ONVIFMGR_APPDIALOG(self),"Loading device profiles...");
-  EventQueue__insert_plain(priv->queue, priv->device, OnvifMgrProfilesDialog__load_profiles,self, NULL);
+  EventQueue__insert_plain_priority(priv->queue, QUEUEEVENT_PRIORITY_INTERACTIVE, priv->device, OnvifMgrProfilesDialog__load_profiles,self, NULL);
 }
 
 static void
@@ -2,40 +2,277 @@
 #include "gui_utils.h"
 #include "clogger.h"
 
-typedef struct {
-    GtkWidget * image;
-    GtkWidget * handle;
-} ImageGUIUpdate;
-
-typedef struct {
-    GtkWidget * label;
-    char * text;
-} GUILabelUpdate;
-
-typedef struct {
-    gpointer instance;
-    guint signalid;
-    gpointer param;
-} IdleSignalEmit;
-
-gboolean idle_signal_emit (void * user_data){
-    IdleSignalEmit * data = (IdleSignalEmit*)user_data;
-    g_signal_emit (data->instance, data->signalid, 0, data->param);
-    g_object_unref(data->instance);
-    if(data->param && G_IS_OBJECT(data->param))g_object_unref(data->param);
-    free(data);
-    return FALSE;
+#define GUI_DISPATCH_MAX_FREE 256
+
+typedef enum {
+    GUI_COALESCE_NONE,
+    GUI_COALESCE_ONCE, //Drop the new update if the same one is pending
+    GUI_COALESCE_REPLACE //Keep the pending position, with the new data
+} GUICoalesce;
+
+typedef struct _GUIUpdate GUIUpdate;
+struct _GUIUpdate {
+    void (*run)(GUIUpdate * update);
+    void (*release)(GUIUpdate * update, int ran); //Main thread only
+    GSourceFunc func;
+    gpointer target; //Coalescing key, along with run, func and detail
+    guint detail;
+    gpointer data;
+    GDestroyNotify drop;
+    GUICoalesce coalesce;
+    GUIUpdate * next;
+};
+
+static struct {
+    GMutex lock;
+    GUIUpdate * head;
+    GUIUpdate * tail;
+    GUIUpdate * discarded; //Coalesced away, released by the next drain
+    GUIUpdate * free_list;
+    int free_count;
+    GHashTable * pending; //Coalescable updates waiting to run
+    int scheduled;
+    GtkWidget * clock_widget;
+    guint tick_id;
+} gui_queue;
+
+static guint
+gui_update_hash(gconstpointer key){
+    const GUIUpdate * update = key;
+    return g_direct_hash(update->target) ^ g_direct_hash(update->func) ^ g_direct_hash(update->run) ^ update->detail;
+}
+
+static gboolean
+gui_update_equal(gconstpointer a, gconstpointer b){
+    const GUIUpdate * update_a = a;
+    const GUIUpdate * update_b = b;
+    if(update_a->run != update_b->run || update_a->func != update_b->func || update_a->target != update_b->target || update_a->detail != update_b->detail){
+        return FALSE;
+    }
+    return update_a->coalesce == GUI_COALESCE_REPLACE || update_a->data == update_b->data;
+}
+
+static GUIUpdate *
+gui_update_new(void (*run)(GUIUpdate * update), void (*release)(GUIUpdate * update, int ran), gpointer target, GUICoalesce coalesce){
+    GUIUpdate * update = NULL;
+    g_mutex_lock(&gui_queue.lock);
+    if(gui_queue.free_list){
+        update = gui_queue.free_list;
+        gui_queue.free_list = update->next;
+        gui_queue.free_count--;
+    }
+    g_mutex_unlock(&gui_queue.lock);
+    if(!update){
+        update = malloc(sizeof(GUIUpdate));
+    }
+    memset(update, 0, sizeof(GUIUpdate));
+    update->run = run;
+    update->release = release;
+    update->target = target;
+    update->coalesce = coalesce;
+    return update;
+}
+
+static void
+gui_update_free(GUIUpdate * update){
+    g_mutex_lock(&gui_queue.lock);
+    if(gui_queue.free_count < GUI_DISPATCH_MAX_FREE){
+        update->next = gui_queue.free_list;
+        gui_queue.free_list = update;
+        gui_queue.free_count++;
+        update = NULL;
+    }
+    g_mutex_unlock(&gui_queue.lock);
+    free(update);
+}
+
+static gboolean gui_dispatch_kick(gpointer user_data);
+
+static void
+gui_update_post(GUIUpdate * update){
+    int kick = FALSE;
+    g_mutex_lock(&gui_queue.lock);
+    if(update->coalesce != GUI_COALESCE_NONE){
+        if(!gui_queue.pending){
+            gui_queue.pending = g_hash_table_new(gui_update_hash, gui_update_equal);
+        }
+        GUIUpdate * existing = g_hash_table_lookup(gui_queue.pending, update);
+        if(existing){
+            if(update->coalesce == GUI_COALESCE_REPLACE){
+                //The discarded update carries the stale data, unless it is still the pending one
+                gpointer data = existing->data;
+                existing->data = update->data;
+                update->data = data != update->data ? data : NULL;
+            }
+            update->next = gui_queue.discarded;
+            gui_queue.discarded = update;
+            g_mutex_unlock(&gui_queue.lock);
+            return;
+        }
+        g_hash_table_add(gui_queue.pending, update);
+    }
+    update->next = NULL;
+    if(gui_queue.tail){
+        gui_queue.tail->next = update;
+    } else {
+        gui_queue.head = update;
+    }
+    gui_queue.tail = update;
+    if(!gui_queue.scheduled){
+        gui_queue.scheduled = TRUE;
+        kick = TRUE;
+    }
+    g_mutex_unlock(&gui_queue.lock);
+
+    if(kick){
+        gdk_threads_add_idle(gui_dispatch_kick, NULL);
+    }
+}
+
+//Run pending updates until the budget is spent. Returns TRUE if some are left.
+static gboolean
+gui_dispatch_drain(void){
+    gint64 deadline = g_get_monotonic_time() + GUI_DISPATCH_FRAME_BUDGET;
+    GUIUpdate * update;
+
+    g_mutex_lock(&gui_queue.lock);
+    GUIUpdate * discarded = gui_queue.discarded;
+    gui_queue.discarded = NULL;
+    g_mutex_unlock(&gui_queue.lock);
+    while((update = discarded)){
+        discarded = update->next;
+        if(update->release){
+            update->release(update, FALSE);
+        }
+        gui_update_free(update);
+    }
+
+    do {
+        g_mutex_lock(&gui_queue.lock);
+        update = gui_queue.head;
+        if(update){
+            gui_queue.head = update->next;
+            if(!gui_queue.head){
+                gui_queue.tail = NULL;
+            }
+            if(update->coalesce != GUI_COALESCE_NONE){
+                g_hash_table_remove(gui_queue.pending, update);
+            }
+        } else {
+            gui_queue.scheduled = FALSE;
+        }
+        g_mutex_unlock(&gui_queue.lock);
+        if(!update){
+            return FALSE;
+        }
+
+        update->run(update);
+        if(update->release){
+            update->release(update, TRUE);
+        }
+        gui_update_free(update);
+    } while(g_get_monotonic_time() < deadline);
+
+    return TRUE;
+}
+
+static gboolean
+gui_dispatch_tick(GtkWidget * widget, GdkFrameClock * frame_clock, gpointer user_data){
+    if(gui_dispatch_drain()){
+        return G_SOURCE_CONTINUE;
+    }
+    gui_queue.tick_id = 0;
+    return G_SOURCE_REMOVE;
+}
+
+//Main thread side of a post to an idle queue. Hands the queue over to the frame clock when possible.
+static gboolean
+gui_dispatch_kick(gpointer user_data){
+    GtkWidget * widget = gui_queue.clock_widget;
+    if(widget && gtk_widget_get_mapped(widget)){
+        if(!gui_queue.tick_id){
+            gui_queue.tick_id = gtk_widget_add_tick_callback(widget, gui_dispatch_tick, NULL, NULL);
+        }
+        return G_SOURCE_REMOVE;
+    }
+    return gui_dispatch_drain() ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+//An unmapped widget gets no frame, so the idle source takes over
+static void
+gui_dispatch_detach_cb(GtkWidget * widget, gpointer user_data){
+    if(gui_queue.tick_id){
+        gtk_widget_remove_tick_callback(widget, gui_queue.tick_id);
+        gui_queue.tick_id = 0;
+        g_idle_add(gui_dispatch_kick, NULL);
+    }
+}
+
+static void
+gui_dispatch_destroy_cb(GtkWidget * widget, gpointer user_data){
+    gui_dispatch_detach_cb(widget, user_data);
+    if(gui_queue.clock_widget == widget){
+        gui_queue.clock_widget = NULL;
+    }
+}
+
+void gui_dispatch_attach(GtkWidget * widget){
+    g_return_if_fail(GTK_IS_WIDGET(widget));
+    g_return_if_fail(gui_queue.clock_widget == NULL);
+    gui_queue.clock_widget = widget;
+    g_signal_connect (widget, "unmap", G_CALLBACK (gui_dispatch_detach_cb), NULL);
+    g_signal_connect (widget, "destroy", G_CALLBACK (gui_dispatch_destroy_cb), NULL);
+}
+
+static void
+gui_dispatch_run_func(GUIUpdate * update){
+    update->func(update->data);
 }
 
+static void
+gui_dispatch_release_func(GUIUpdate * update, int ran){
+    if(!ran && update->drop){
+        update->drop(update->data);
+    }
+}
+
+void gui_dispatch(GSourceFunc func, gpointer data){
+    g_return_if_fail(func != NULL);
+    GUIUpdate * update = gui_update_new(gui_dispatch_run_func, NULL, NULL, GUI_COALESCE_NONE);
+    update->func = func;
+    update->data = data;
+    gui_update_post(update);
+}
+
+void gui_dispatch_once(GSourceFunc func, gpointer data, GDestroyNotify drop){
+    g_return_if_fail(func != NULL);
+    GUIUpdate * update = gui_update_new(gui_dispatch_run_func, gui_dispatch_release_func, data, GUI_COALESCE_ONCE);
+    update->func = func;
+    update->data = data;
+    update->drop = drop;
+    gui_update_post(update);
+}
+
+static void
+gui_signal_emit_run(GUIUpdate * update){
+    g_signal_emit (update->target, update->detail, 0, update->data);
+}
+
+static void
+gui_signal_emit_release(GUIUpdate * update, int ran){
+    g_object_unref(update->target);
+    if(update->data && G_IS_OBJECT(update->data)) g_object_unref(update->data);
+}
+
+//The same signal raised again with the same parameter before it ran is only emitted once
 void gui_signal_emit(gpointer instance, guint singalid, gpointer param){
     g_return_if_fail(G_IS_OBJECT(instance));
-    IdleSignalEmit * emit = malloc(sizeof(IdleSignalEmit));
-    emit->instance= instance;
-    emit->signalid = singalid;
-    emit->param = param;
-    g_object_ref(emit->instance);
+    GUIUpdate * update = gui_update_new(gui_signal_emit_run, gui_signal_emit_release, instance, GUI_COALESCE_ONCE);
+    update->detail = singalid;
+    update->data = param;
+    g_object_ref(instance);
     if(G_IS_OBJECT(param)) g_object_ref(param);
-    gdk_threads_add_idle(G_SOURCE_FUNC(idle_signal_emit),emit);
+    gui_update_post(update);
 }
 
 void gui_widget_destroy(GtkWidget * widget, gpointer user_data){
@@ -46,59 +283,66 @@ void gui_container_remove(GtkWidget * widget, gpointer user_data){
     gtk_container_remove(GTK_CONTAINER(user_data),widget);
 }
 
-gboolean gui_update_widget_image_priv(void * user_data){
-    ImageGUIUpdate * iguiu = (ImageGUIUpdate *) user_data;
+static void
+gui_update_widget_image_run(GUIUpdate * update){
+    GtkWidget * handle = update->target;
+    GtkWidget * image = update->data;
 
-    if(GTK_IS_WIDGET(iguiu->handle)){
-        gtk_container_foreach (GTK_CONTAINER (iguiu->handle), (GtkCallback)gui_widget_destroy, NULL);
-        if(GTK_IS_WIDGET(iguiu->image)){
-            gtk_container_add (GTK_CONTAINER (iguiu->handle), iguiu->image);
-            gtk_widget_show (iguiu->image);
-            if(GTK_IS_SPINNER(iguiu->image)){
-                gtk_spinner_start (GTK_SPINNER (iguiu->image));
+    if(GTK_IS_WIDGET(handle)){
+        gtk_container_foreach (GTK_CONTAINER (handle), (GtkCallback)gui_widget_destroy, NULL);
+        if(GTK_IS_WIDGET(image)){
+            gtk_container_add (GTK_CONTAINER (handle), image);
+            gtk_widget_show (image);
+            if(GTK_IS_SPINNER(image)){
+                gtk_spinner_start (GTK_SPINNER (image));
             }
         }
     } else {
-        C_WARN("gui_update_widget_image_priv - invalid handle");
+        C_WARN("gui_update_widget_image_run - invalid handle");
     }
+}
 
-    free(iguiu);
-    return FALSE;
+//An image replaced before it was shown is still floating
+static void
+gui_update_widget_image_release(GUIUpdate * update, int ran){
+    GtkWidget * image = update->data;
+    if(!ran && GTK_IS_WIDGET(image) && !gtk_widget_get_parent(image)){
+        g_object_ref_sink(image);
+        gtk_widget_destroy(image);
+        g_object_unref(image);
+    }
 }
 
+//Only the last image set on a handle before the next drain is shown
 void gui_update_widget_image(GtkWidget * image, GtkWidget * handle){
     if(!G_IS_OBJECT(image) || !G_IS_OBJECT(handle)) return;
-    ImageGUIUpdate * iguiu = malloc(sizeof(ImageGUIUpdate));
-    iguiu->image = image;
-    iguiu->handle = handle;
-    gdk_threads_add_idle(G_SOURCE_FUNC(gui_update_widget_image_priv),iguiu);
+    GUIUpdate * update = gui_update_new(gui_update_widget_image_run, gui_update_widget_image_release, handle, GUI_COALESCE_REPLACE);
+    update->data = image;
+    gui_update_post(update);
 }
 
-gboolean gui_set_label_text_priv (void * user_data){
-    GUILabelUpdate * update = (GUILabelUpdate *) user_data;
-    if(!update->label || !GTK_IS_LABEL(update->label)) goto exit; //This may happen if the element was destroyed before the idle is dispatched
-    gtk_label_set_text(GTK_LABEL(update->label),update->text);
-
-exit:
-    if(update->text)
-        free(update->text);
-    free(update);
+static void
+gui_set_label_text_run(GUIUpdate * update){
+    GtkWidget * label = update->target;
+    if(!label || !GTK_IS_LABEL(label)) return; //This may happen if the element was destroyed before the update is dispatched
+    gtk_label_set_text(GTK_LABEL(label),update->data);
+}
 
-    return FALSE;
+static void
+gui_set_label_text_release(GUIUpdate * update, int ran){
+    free(update->data);
 }
 
+//Only the last text set on a label before the next drain is applied
 void gui_set_label_text (GtkWidget * widget, char * value){
     g_return_if_fail(widget != NULL);
     g_return_if_fail(GTK_IS_LABEL(widget));
-    GUILabelUpdate * iguiu = malloc(sizeof(GUILabelUpdate));
+    GUIUpdate * update = gui_update_new(gui_set_label_text_run, gui_set_label_text_release, widget, GUI_COALESCE_REPLACE);
     if(value){
-        iguiu->text = malloc(strlen(value)+1);
-        strcpy(iguiu->text,value);
-    } else {
-        iguiu->text = NULL;
+        update->data = malloc(strlen(value)+1);
+        strcpy(update->data,value);
     }
-    iguiu->label = widget;
-    gdk_threads_add_idle(G_SOURCE_FUNC(gui_set_label_text_priv),iguiu);
+    gui_update_post(update);
 }
 
 gboolean gui_widget_destroy_cb (void * user_data){
@@ -110,7 +354,7 @@ gboolean gui_widget_destroy_cb (void * user_data){
 }
 
 void safely_destroy_widget(GtkWidget * widget){
-    gdk_threads_add_idle(G_SOURCE_FUNC(gui_widget_destroy_cb),widget);
+    gui_dispatch_once(G_SOURCE_FUNC(gui_widget_destroy_cb),widget,NULL);
 }
 
 gboolean idle_start_spinner(void * user_data){
@@ -122,7 +366,7 @@ gboolean idle_start_spinner(void * user_data){
 }
 
 void safely_start_spinner(GtkWidget * widget){
-    gdk_threads_add_idle(G_SOURCE_FUNC(idle_start_spinner),widget);
+    gui_dispatch_once(G_SOURCE_FUNC(idle_start_spinner),widget,NULL);
 }
 
 void gui_widget_set_css(GtkWidget * widget, char * css){
@@ -151,7 +395,7 @@ void safely_set_widget_css(GtkWidget * widget, char * css){
     arr[0] = widget;
     arr[1] = malloc(strlen(css)+1);
     strcpy(arr[1],css);
-    gdk_threads_add_idle(G_SOURCE_FUNC(idle_set_widget_css),arr);
+    gui_dispatch(G_SOURCE_FUNC(idle_set_widget_css),arr);
 }
 
 gboolean gui_realize_make_square (GtkWidget *widget, gpointer p, gpointer player){
@@ -5,6 +5,19 @@
 
 #define GLIST_FOREACH(item, list) for(GList *__glist = list; __glist && (item = __glist->data, TRUE); __glist = __glist->next)
 
+/*
+ * Central GUI dispatch queue. Updates posted from any thread are drained on the main thread
+ * once per frame clock tick of the attached widget, within a time budget, instead of scheduling
+ * one idle source each. Pending updates to the same widget are coalesced.
+ * Without an attached and mapped widget, a single idle source drains the queue.
+ */
+#define GUI_DISPATCH_FRAME_BUDGET 4000 //Microseconds per drain, leaving most of a 60Hz frame to layout and paint
+
+void gui_dispatch_attach(GtkWidget * widget);
+//Runs func(data) on the main thread, in posting order. The return value is ignored.
+void gui_dispatch(GSourceFunc func, gpointer data);
+//Same, unless func is already pending for data. The duplicate is then released with drop on the main thread.
+void gui_dispatch_once(GSourceFunc func, gpointer data, GDestroyNotify drop);
 void gui_signal_emit(gpointer instance, guint singalid, gpointer data);
 void gui_widget_destroy(GtkWidget * widget, gpointer user_data);
 void gui_container_remove(GtkWidget * widget, gpointer user_data);
@@ -340,7 +340,7 @@ OnvifMgrDeviceRow__create_layout(OnvifMgrDeviceRow * self){
     gtk_grid_attach (GTK_GRID (priv->button_grid), priv->lbl_location, 1, 3, 1, 1);
 
     //Dispatch image creation using GUI thread, because GtkImage construction isn't safe
-    g_idle_add(OnvifMgrDeviceRow__attach_buttons,self);
+    gui_dispatch(OnvifMgrDeviceRow__attach_buttons,self);
 
     gtk_container_add (GTK_CONTAINER (self), priv->button_grid);
     //For some reason, spinner has a floating ref
@@ -632,7 +632,7 @@ void OnvifMgrDeviceRow__set_profile(OnvifMgrDeviceRow * self, OnvifMediaProfile
     g_signal_emit (self, signals[PROFILE_CHANGED], 0);
 
     g_object_ref(self);
-    gdk_threads_add_idle(G_SOURCE_FUNC(OnvifMgrDeviceRow__update_profile_btn),self);
+    gui_dispatch_once(G_SOURCE_FUNC(OnvifMgrDeviceRow__update_profile_btn),self,g_object_unref);
 }
 
 OnvifMediaProfile * OnvifMgrDeviceRow__get_profile(OnvifMgrDeviceRow * self){
@@ -782,9 +782,9 @@ void OnvifMgrDeviceRow__load_thumbnail(OnvifMgrDeviceRow * self){
         void ** data = malloc(sizeof(void*)*2);
         data[0] = self;
         data[1] = snapshot;
-        g_idle_add(OnvifMgrDeviceRow__display_snapshot,data);
+        gui_dispatch(OnvifMgrDeviceRow__display_snapshot,data);
     } else {
-        g_idle_add(OnvifMgrDeviceRow__display_locked,self);
+        gui_dispatch_once(OnvifMgrDeviceRow__display_locked,self,NULL);
     }
     ONVIFMGR_DEVICEROW_TRACE("%s OnvifMgrDeviceRow__load_thumbnail done",self);
 } 
@@ -833,7 +833,7 @@ void OnvifMgrDeviceRow__load_scopedata(OnvifMgrDeviceRow * self){
                 input = malloc(sizeof(void*) *2);
                 input[0] = self;
                 input[1] = scopes;
-                g_idle_add(G_SOURCE_FUNC(OnvifMgrEncryptedStore__gui_set_scopes),input);
+                gui_dispatch(G_SOURCE_FUNC(OnvifMgrEncryptedStore__gui_set_scopes),input);
                 break;
             case SOAP_FAULT_ACTION_NOT_SUPPORTED:
             case SOAP_FAULT_CONNECTION_ERROR:
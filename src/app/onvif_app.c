@@ -15,6 +15,15 @@
 #include "discoverer.h"
 #include "onvif_app_shutdown.h"
 
+#define ONVIF_APP_PRECONNECT_HOVER_DELAY 300 //Milliseconds a row stays hovered before its stream is pre-connected
+#define ONVIF_APP_PRECONNECT_NEXT_DELAY 1000 //Milliseconds after a selection before the next row is pre-connected
+/*
+ * Deadline of a pre-connect, in milliseconds. Only speculative work gets one:
+ * onvifsoap calls take no cancellable, so an expired event still holds its worker until the SOAP call returns,
+ * and an expired display or play would drop a late answer instead of loading it.
+ */
+#define ONVIF_APP_PRECONNECT_TIMEOUT 15000
+
 extern char _binary_tower_png_size[];
 extern char _binary_tower_png_start[];
 extern char _binary_tower_png_end[];
@@ -32,6 +41,8 @@ typedef struct {
     GtkWidget *btn_scan;
     GtkWidget *window;
     GtkWidget *listbox;
+    //Compared only, never dereferenced
+    GtkListBoxRow *hovered_row;
     GtkWidget *player_loading_handle;
     GtkWidget *task_label;
     GtkOverlay * overlay;
@@ -42,6 +53,14 @@ typedef struct {
     EventQueue * queue;
     OnvifMgrEncryptedStore * store;
     GstRtspPlayer * player;
+
+    //Devices added by discovery or the store, queued together on the next idle
+    GPtrArray * display_batch;
+    GMutex display_lock;
+
+    //Latest pre-connect of each heuristic, held so that moving on cancels it. GUI thread only.
+    QueueEvent * preconnect_hovered;
+    QueueEvent * preconnect_next;
 } OnvifAppPrivate;
 
 struct IdleRetryData {
@@ -67,6 +86,8 @@ static void OnvifApp__add_device(OnvifApp * app, OnvifMgrDeviceRow * omgr_device
 static void OnvifApp__select_device(OnvifApp * app,  GtkListBoxRow * row);
 static SoapFault OnvifApp__reload_device(QueueEvent * qevt, OnvifMgrDeviceRow * device);
 static void OnvifApp__display_device(OnvifApp * self, OnvifMgrDeviceRow * device);
+static void OnvifApp__insert_device_event(OnvifApp * self, QueueEventPriority priority, QueueEventCoalesce coalesce, OnvifMgrDeviceRow * device, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
+static void OnvifApp__preconnect_device(OnvifApp * self, GtkListBoxRow * row, int delay, QueueEvent ** pending, void (*callback)(QueueEvent * qevt, void * user_data));
 
 gboolean idle_select_device(void * user_data){
     OnvifMgrDeviceRow * device = ONVIFMGR_DEVICEROW(user_data);
@@ -113,17 +134,20 @@ gboolean idle_player_retry_stream(void * user_data){
     return FALSE;
 }
 
-void _wait_before_retry_stream(QueueEvent * qevt, void * user_data){
+//Dispatched after the retry delay elapsed. The delay doesn't hold a worker.
+void _delayed_retry_stream(QueueEvent * qevt, void * user_data){
     struct IdleRetryData * data = (struct IdleRetryData *) user_data;
     if(ONVIFMGR_DEVICEROWROW_HAS_OWNER(data->device) && OnvifMgrDeviceRow__is_selected(data->device) && !QueueEvent__is_cancelled(qevt)){
-        ONVIFMGR_DEVICEROW_TRACE("%s _wait_before_retry_stream",data->device);
-        sleep(2);//Wait to avoid spamming the camera
-        if(ONVIFMGR_DEVICEROWROW_HAS_OWNER(data->device) && OnvifMgrDeviceRow__is_selected(data->device) && !QueueEvent__is_cancelled(qevt)){
-            g_object_ref(data->device);
-            g_idle_add(G_SOURCE_FUNC(idle_player_retry_stream), data);
-            return;
-        }
+        ONVIFMGR_DEVICEROW_TRACE("%s _delayed_retry_stream",data->device);
+        struct IdleRetryData * idle_data = malloc(sizeof(struct IdleRetryData));
+        *idle_data = *data;
+        g_object_ref(idle_data->device);
+        g_idle_add(G_SOURCE_FUNC(idle_player_retry_stream), idle_data);
     }
+}
+
+//Also invoked when the retry is cancelled before it is due
+void _delayed_retry_stream_cleanup(QueueEvent * qevt, int cancelled, void * user_data){
     free(user_data);
 }
 
@@ -134,7 +158,8 @@ void _dicovery_found_server_cb (DiscoveryEvent * event) {
         return;
     }
     
-    gdk_threads_add_idle(G_SOURCE_FUNC(OnvifApp__disocvery_found_server_cb),event);
+    //A discovery burst is drained with the other GUI updates, within the frame budget
+    gui_dispatch(G_SOURCE_FUNC(OnvifApp__disocvery_found_server_cb),event);
 }
 
 void _start_onvif_discovery(QueueEvent * qevt, void * user_data){
@@ -150,7 +175,8 @@ void _start_onvif_discovery(QueueEvent * qevt, void * user_data){
     UdpDiscoverer__start(&discoverer, self, AppSettingsDiscovery__get_repeat(priv->settings->discovery), AppSettingsDiscovery__get_timeout(priv->settings->discovery));
     //TODO Support discovery cancel? (No way to cancel it as of right now)
     g_object_ref(self);
-    gdk_threads_add_idle(G_SOURCE_FUNC(OnvifApp__discovery_finished_cb),self);
+    //Posted after the found servers, so the scan button comes back once they are all added
+    gui_dispatch(G_SOURCE_FUNC(OnvifApp__discovery_finished_cb),self);
 }
 
 void _display_onvif_device(QueueEvent * qevt, void * user_data){
@@ -220,7 +246,7 @@ updatethumb:
         if(ONVIFMGR_DEVICEROWROW_HAS_OWNER(omgr_device) && OnvifMgrDeviceRow__is_selected(omgr_device) && !QueueEvent__is_cancelled(qevt)){
             g_object_ref(omgr_device);
             //TODO Handle event cancellation within GUI event
-            gdk_threads_add_idle(G_SOURCE_FUNC(idle_select_device),omgr_device);
+            gui_dispatch_once(G_SOURCE_FUNC(idle_select_device),omgr_device,g_object_unref);
         }
     }
 }
@@ -242,6 +268,11 @@ void _profile_callback (QueueEvent * qevt, void * user_data){
 
 }
 
+static int OnvifApp__profile_index(OnvifMgrDeviceRow * device){
+    OnvifMediaProfile * profile = OnvifMgrDeviceRow__get_profile(device);
+    return (profile) ? OnvifMediaProfile__get_index(profile) : 0;
+}
+
 void _play_onvif_stream(QueueEvent * qevt, void * user_data){
     ONVIFMGR_DEVICEROW_TRACE("_play_onvif_stream %s",user_data);
     OnvifMgrDeviceRow * device = ONVIFMGR_DEVICEROW(user_data);
@@ -254,6 +285,11 @@ void _play_onvif_stream(QueueEvent * qevt, void * user_data){
     OnvifDevice * odev = OnvifMgrDeviceRow__get_device(device);
     OnvifApp * app = OnvifMgrDeviceRow__get_app(device);
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
+
+    //A pre-connected stream already went through authentication, GetStreamUri and RTSP SETUP
+    if(OnvifDevice__is_authenticated(odev) && GstRtspPlayer__play_preconnected(priv->player, OnvifApp__profile_index(device), device)){
+        return;
+    }
     
     /* Authentication check */
     OnvifDevice__authenticate(odev);
@@ -263,8 +299,7 @@ void _play_onvif_stream(QueueEvent * qevt, void * user_data){
     }
 
     /* Set the URI to play */
-    OnvifMediaProfile * profile = OnvifMgrDeviceRow__get_profile(device);
-    OnvifUri * media_uri = OnvifMediaService__getStreamUri(OnvifDevice__get_media_service(odev),(profile) ? OnvifMediaProfile__get_index(profile) : 0);
+    OnvifUri * media_uri = OnvifMediaService__getStreamUri(OnvifDevice__get_media_service(odev),OnvifApp__profile_index(device));
     SoapFault * fault = SoapObject__get_fault(SOAP_OBJECT(media_uri));
     
     if(ONVIFMGR_DEVICEROWROW_HAS_OWNER(device) && *fault == SOAP_FAULT_NONE && !(qevt != NULL && QueueEvent__is_cancelled(qevt))){
@@ -289,6 +324,64 @@ void _play_onvif_stream(QueueEvent * qevt, void * user_data){
     g_object_unref(media_uri);
 }
 
+/*
+ * Speculative counterpart of _play_onvif_stream for a row likely to be clicked next.
+ * It never authenticates or prompts, so only devices already authenticated are pre-connected.
+ */
+static void _preconnect_onvif_stream(QueueEvent * qevt, OnvifMgrDeviceRow * device){
+    if(!ONVIFMGR_DEVICEROWROW_HAS_OWNER(device) || OnvifMgrDeviceRow__is_selected(device) || QueueEvent__is_cancelled(qevt)){
+        return;
+    }
+
+    OnvifDevice * odev = OnvifMgrDeviceRow__get_device(device);
+    if(!odev || !OnvifDevice__is_authenticated(odev)){
+        return;
+    }
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (OnvifMgrDeviceRow__get_app(device));
+    //Hovering again spares the GetStreamUri round trip
+    int profile = OnvifApp__profile_index(device);
+    if(GstRtspPlayer__is_preconnected(priv->player, profile, device)){
+        return;
+    }
+
+    OnvifUri * media_uri = OnvifMediaService__getStreamUri(OnvifDevice__get_media_service(odev),profile);
+    SoapFault * fault = SoapObject__get_fault(SOAP_OBJECT(media_uri));
+
+    //Selected meanwhile, the click plays it directly
+    if(ONVIFMGR_DEVICEROWROW_HAS_OWNER(device) && *fault == SOAP_FAULT_NONE && !OnvifMgrDeviceRow__is_selected(device) && !QueueEvent__is_cancelled(qevt)){
+        OnvifCredentials * ocreds = OnvifDevice__get_credentials(odev);
+        char * user = OnvifCredentials__get_username(ocreds);
+        char * pass = OnvifCredentials__get_password(ocreds);
+        char * port = OnvifDevice__get_port(odev);
+        char * host = OnvifDevice__get_host(odev);
+        GstRtspPlayer__preconnect(priv->player,OnvifUri__get_uri(media_uri),user,pass,host,port, profile, device);
+        if(pass)
+            free(pass);
+        if(user)
+            free(user);
+        if(port)
+            free(port);
+        if(host)
+            free(host);
+    }
+    g_object_unref(media_uri);
+}
+
+//Separate callbacks, so that hovering and selecting coalesce independently
+void _preconnect_hovered_stream(QueueEvent * qevt, void * user_data){
+    ONVIFMGR_DEVICEROW_TRACE("_preconnect_hovered_stream %s",user_data);
+    _preconnect_onvif_stream(qevt, ONVIFMGR_DEVICEROW(user_data));
+}
+
+void _preconnect_next_stream(QueueEvent * qevt, void * user_data){
+    ONVIFMGR_DEVICEROW_TRACE("_preconnect_next_stream %s",user_data);
+    _preconnect_onvif_stream(qevt, ONVIFMGR_DEVICEROW(user_data));
+}
+
+void _preconnect_stream_cleanup(QueueEvent * qevt, int cancelled, void * user_data){
+    g_object_unref(user_data);
+}
+
 void _stop_onvif_stream(QueueEvent * qevt, void * user_data){
     C_TRACE("_stop_onvif_stream");
     OnvifApp * app = ONVIFMGR_APP(user_data);
@@ -391,7 +484,7 @@ void _onvif_device_add(QueueEvent * qevt, void * user_data){
             //Extract scope
             omgr_device = OnvifMgrDeviceRow__new(app, onvif_dev, NULL, NULL, NULL);
             OnvifMgrDeviceRow__load_scopedata(ONVIFMGR_DEVICEROW(omgr_device));
-            gdk_threads_add_idle(G_SOURCE_FUNC(idle_add_device),omgr_device);
+            gui_dispatch(G_SOURCE_FUNC(idle_add_device),omgr_device);
             break;
         case SOAP_FAULT_CONNECTION_ERROR:
             g_object_set (dialog, "error", "Failed to connect...", NULL);
@@ -464,7 +557,7 @@ void OnvifApp__cred_dialog_login_cb(OnvifMgrAppDialog * app_dialog, OnvifMgrDevi
     OnvifMgrAppDialog__show_loading(app_dialog,"ONVIF Authentication attempt...");
     OnvifDevice__set_credentials(OnvifMgrDeviceRow__get_device(device),OnvifMgrCredentialsDialog__get_username(cred_dialog),OnvifMgrCredentialsDialog__get_password(cred_dialog));
     g_object_ref(device);
-    EventQueue__insert(priv->queue, device, _onvif_authentication_reload,app_dialog, _onvif_authentication_reload_cleanup);
+    OnvifApp__insert_device_event(OnvifMgrDeviceRow__get_app(device), QUEUEEVENT_PRIORITY_INTERACTIVE, EVENTQUEUE_COALESCE_NONE, device, _onvif_authentication_reload,app_dialog, _onvif_authentication_reload_cleanup);
 }
 
 void OnvifApp__cred_dialog_cancel_cb(OnvifMgrAppDialog * app_dialog, OnvifMgrDeviceRow * device){
@@ -483,7 +576,8 @@ void OnvifApp__player_retry_cb(GstRtspPlayer * player, GstRtspPlayerSession * se
         data->player = player;
         data->session = session;
         data->device = device;
-        EventQueue__insert_plain(priv->queue, device, _wait_before_retry_stream,data, NULL);
+        //Wait to avoid spamming the camera
+        EventQueue__insert_plain_delayed(priv->queue, 2000, device, _delayed_retry_stream,data, _delayed_retry_stream_cleanup);
     }
 }
 
@@ -511,20 +605,21 @@ void OnvifApp__player_started_cb(GstRtspPlayer * player, GstRtspPlayerSession *
     }
 }
 
-void OnvifApp__eq_dispatch_cb(EventQueue * queue, QueueEventType type, int running, int pending, int threadcount, QueueEvent * evt, OnvifApp * self){
+//Invoked on the main context with the latest counters
+void OnvifApp__eq_stats_cb(EventQueue * queue, int running, int pending, int threadcount, int delayed, OnvifApp * self){
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
 
-    C_TRACE("EventQueue %s : %d/%d/%d",g_enum_to_nick(QUEUE_TYPE_EVENTTYPE,type),running,pending,threadcount);
+    C_TRACE("EventQueue stats : %d/%d/%d (%d delayed)",running,pending,threadcount,delayed);
 
-    if(!GTK_IS_WIDGET(priv->task_label)){
+    if(!GTK_IS_LABEL(priv->task_label)){
         return;
     }
     
-    char str[10];
+    char str[24];
     memset(&str,'\0',sizeof(str));
-    sprintf(str, "[%d/%d]", running + pending,threadcount);
+    snprintf(str, sizeof(str), "[%d/%d]", running + pending,threadcount);
 
-    gui_set_label_text(priv->task_label,str);
+    gtk_label_set_text(GTK_LABEL(priv->task_label),str);
 }
 
 void OnvifApp__setting_view_mode_cb(AppSettingsStream * settings, GParamSpec* pspec, OnvifApp * app){
@@ -587,7 +682,10 @@ void OnvifApp__btn_scan_cb (GtkWidget *widget, OnvifApp * app) {
     // gtk_container_foreach (GTK_CONTAINER (priv->listbox), (GtkCallback)gui_container_remove, priv->listbox);
 
     //Multiple dispatch in case of packet dropped
-    EventQueue__insert(priv->queue, app, _start_onvif_discovery,app, NULL);
+    //Repeated clicks join the scan that is still pending
+    QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+    options.coalesce = EVENTQUEUE_COALESCE_KEEP_FIRST;
+    EventQueue__insert_with_options(priv->queue, &options, app, _start_onvif_discovery,app, NULL);
 }
 
 static void OnvifApp__profile_picker_cb (OnvifMgrDeviceRow *device){
@@ -601,7 +699,10 @@ static void OnvifApp__profile_picker_cb (OnvifMgrDeviceRow *device){
 
 static void OnvifApp__profile_changed_cb (OnvifMgrDeviceRow *device){
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (OnvifMgrDeviceRow__get_app(device));
-    EventQueue__insert(priv->queue, device, _profile_callback,device, NULL);
+    //Pre-connected to the previous profile's stream
+    GstRtspPlayer__discard_preconnected(priv->player, device);
+    //Only the latest profile selection matters
+    OnvifApp__insert_device_event(OnvifMgrDeviceRow__get_app(device), QUEUEEVENT_PRIORITY_INTERACTIVE, EVENTQUEUE_COALESCE_LAST_WINS, device, _profile_callback,device, NULL);
 }
 void OnvifApp__add_device_cb(OnvifMgrAppDialog * app_dialog, OnvifApp * app){
     const char * host = OnvifMgrAddDialog__get_host(ONVIFMGR_ADDDIALOG(app_dialog));
@@ -612,7 +713,7 @@ void OnvifApp__add_device_cb(OnvifMgrAppDialog * app_dialog, OnvifApp * app){
 
     OnvifMgrAppDialog__show_loading(app_dialog, "Testing ONVIF device configuration...");
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
-    EventQueue__insert(priv->queue, app, _onvif_device_add,app_dialog, NULL);
+    EventQueue__insert_priority(priv->queue, QUEUEEVENT_PRIORITY_INTERACTIVE, app, _onvif_device_add,app_dialog, NULL);
 }
 
 void OnvifApp__add_btn_cb (GtkWidget *widget, OnvifApp * app) {
@@ -628,6 +729,31 @@ void OnvifApp__row_selected_cb (GtkWidget *widget,   GtkListBoxRow* row, OnvifAp
     OnvifApp__select_device(app,row);
 }
 
+static gboolean OnvifApp__listbox_motion_cb (GtkWidget *widget, GdkEventMotion *event, OnvifApp* app){
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
+    GtkListBoxRow * row = gtk_list_box_get_row_at_y(GTK_LIST_BOX(widget), (gint) event->y);
+    if(row != priv->hovered_row){
+        priv->hovered_row = row;
+        OnvifApp__preconnect_device(app, row, ONVIF_APP_PRECONNECT_HOVER_DELAY, &priv->preconnect_hovered, _preconnect_hovered_stream);
+    }
+    return FALSE;
+}
+
+static gboolean OnvifApp__listbox_leave_cb (GtkWidget *widget, GdkEventCrossing *event, OnvifApp* app){
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
+    priv->hovered_row = NULL;
+    return FALSE;
+}
+
+//A trashed row's address may be reused by a new row, which must not play the trashed row's session
+static void OnvifApp__device_destroy_cb (OnvifMgrDeviceRow *device, OnvifApp * app){
+    if(!COwnableObject__has_owner(COWNABLE_OBJECT(app))){
+        return;
+    }
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
+    GstRtspPlayer__discard_preconnected(priv->player, device);
+}
+
 static gboolean OnvifApp__discovery_finished_cb (OnvifApp * self) {
     C_TRACE("OnvifApp__discovery_finished_cb");
     if(!COwnableObject__has_owner(COWNABLE_OBJECT(self))){
@@ -703,8 +829,11 @@ static void OnvifApp__select_device(OnvifApp * app,  GtkListBoxRow * row){
     C_DEBUG("OnvifApp__select_device");
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
 
-    //Stop previous stream
-    EventQueue__insert(priv->queue,app, _stop_onvif_stream,app, NULL);
+    //Stop previous stream. The new stream only starts once it is stopped.
+    QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+    options.priority = QUEUEEVENT_PRIORITY_INTERACTIVE;
+    options.hold = TRUE;
+    QueueEvent * stop_event = EventQueue__insert_with_options(priv->queue, &options, app, _stop_onvif_stream,app, NULL);
 
     if(!OnvifApp__set_device(app,row)){
         //In case the previous stream was in a retry cycle, force hide loading
@@ -722,21 +851,123 @@ static void OnvifApp__select_device(OnvifApp * app,  GtkListBoxRow * row){
         }
 
         gtk_spinner_start (GTK_SPINNER (priv->player_loading_handle));
-        EventQueue__insert(priv->queue, priv->device, _play_onvif_stream,priv->device, NULL);
+        if(stop_event){
+            //Cancelling the stop, or the device scope, drops the stream request with it
+            options = (QueueEventOptions) QUEUEEVENT_OPTIONS_INIT;
+            options.priority = QUEUEEVENT_PRIORITY_INTERACTIVE;
+            options.flags = QUEUEEVENT_FLAG_STRAND;
+            EventQueue__then(priv->queue, stop_event, &options, priv->device, _play_onvif_stream,priv->device, NULL);
+        } else {
+            OnvifApp__insert_device_event(app, QUEUEEVENT_PRIORITY_INTERACTIVE, EVENTQUEUE_COALESCE_NONE, priv->device, _play_onvif_stream,priv->device, NULL);
+        }
+
+        //Browsing usually moves on to the next row
+        GtkListBoxRow * next = gtk_list_box_get_row_at_index(GTK_LIST_BOX(priv->listbox), gtk_list_box_row_get_index(row) + 1);
+        OnvifApp__preconnect_device(app, next, ONVIF_APP_PRECONNECT_NEXT_DELAY, &priv->preconnect_next, _preconnect_next_stream);
     }
 
 exit:
+    if(stop_event){
+        EventQueue__release_event(priv->queue, stop_event);
+    }
     g_signal_emit (app, signals[DEVICE_CHANGED], 0, ONVIFMGR_DEVICEROW(row) /* details */);
 }
 
+static gboolean OnvifApp__flush_display_batch(OnvifApp * self){
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
+
+    g_mutex_lock(&priv->display_lock);
+    GPtrArray * batch = priv->display_batch;
+    priv->display_batch = g_ptr_array_new();
+    g_mutex_unlock(&priv->display_lock);
+
+    if(COwnableObject__has_owner(COWNABLE_OBJECT(self)) && batch->len){
+        QueueEventEntry * entries = malloc(sizeof(QueueEventEntry) * batch->len);
+        guint i;
+        for(i=0;i<batch->len;i++){
+            entries[i].scope = g_ptr_array_index(batch, i);
+            entries[i].callback = _display_onvif_device;
+            entries[i].user_data = g_ptr_array_index(batch, i);
+            entries[i].cleanup_cb = NULL;
+        }
+
+        //Thumbnails and initial authentication must not delay user initiated work
+        //A pending display already loads the same details
+        QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+        options.priority = QUEUEEVENT_PRIORITY_BACKGROUND;
+        options.flags = QUEUEEVENT_FLAG_STRAND;
+        options.coalesce = EVENTQUEUE_COALESCE_KEEP_FIRST;
+        EventQueue__insert_many(priv->queue, &options, entries, batch->len);
+        free(entries);
+    }
+
+    g_ptr_array_foreach(batch, (GFunc) g_object_unref, NULL);
+    g_ptr_array_free(batch, TRUE);
+    g_object_unref(self);
+    return FALSE;
+}
+
+//Loading a large store or a discovery burst publishes all the devices with a single insert
 static void OnvifApp__display_device(OnvifApp * self, OnvifMgrDeviceRow * device){
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
-    EventQueue__insert(priv->queue, device, _display_onvif_device,device, NULL);
+
+    g_mutex_lock(&priv->display_lock);
+    if(!priv->display_batch->len){
+        g_object_ref(self);
+        gui_dispatch(G_SOURCE_FUNC(OnvifApp__flush_display_batch),self);
+    }
+    g_ptr_array_add(priv->display_batch, g_object_ref(device));
+    g_mutex_unlock(&priv->display_lock);
+}
+
+//Events on a device strand run one at a time in insertion order, so handlers never race on the same device
+static void OnvifApp__insert_device_event(OnvifApp * self, QueueEventPriority priority, QueueEventCoalesce coalesce, OnvifMgrDeviceRow * device, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
+    QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+    options.priority = priority;
+    options.flags = QUEUEEVENT_FLAG_STRAND;
+    options.coalesce = coalesce;
+    EventQueue__insert_with_options(priv->queue, &options, device, callback, user_data, cleanup_cb);
+}
+
+/*
+ * Only the latest candidate of each heuristic is pre-connected. Moving on cancels the previous one.
+ * It runs on the device strand, so it never races the display or profile events of the device,
+ * and removing the device cancels it with the rest of its scope.
+ * The player bounds how many pre-connected sessions exist at once.
+ */
+static void OnvifApp__preconnect_device(OnvifApp * self, GtkListBoxRow * row, int delay, QueueEvent ** pending, void (*callback)(QueueEvent * qevt, void * user_data)){
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
+    if(*pending){
+        if(!QueueEvent__is_finished(*pending)){
+            QueueEvent__try_cancel(*pending);
+        }
+        EventQueue__release_event(priv->queue, *pending);
+        *pending = NULL;
+    }
+    if(!ONVIFMGR_IS_DEVICEROW(row)){
+        return;
+    }
+    OnvifMgrDeviceRow * device = ONVIFMGR_DEVICEROW(row);
+    if(!OnvifMgrDeviceRow__is_initialized(device) || OnvifMgrDeviceRow__is_selected(device)){
+        return;
+    }
+
+    QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+    options.priority = QUEUEEVENT_PRIORITY_BACKGROUND;
+    options.flags = QUEUEEVENT_FLAG_STRAND;
+    options.coalesce = EVENTQUEUE_COALESCE_LAST_WINS;
+    options.delay = delay;
+    options.timeout = ONVIF_APP_PRECONNECT_TIMEOUT;
+    options.hold = TRUE;
+    g_object_ref(device);
+    *pending = EventQueue__insert_with_options(priv->queue, &options, device, callback, device, _preconnect_stream_cleanup);
 }
 
 static void OnvifApp__add_device(OnvifApp * app, OnvifMgrDeviceRow * omgr_device){
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (app);
     g_signal_connect (G_OBJECT (omgr_device), "profile-clicked", G_CALLBACK (OnvifApp__profile_picker_cb), NULL);
+    g_signal_connect (G_OBJECT (omgr_device), "destroy", G_CALLBACK (OnvifApp__device_destroy_cb), app);
 
     gtk_list_box_insert (GTK_LIST_BOX (priv->listbox), GTK_WIDGET(omgr_device), -1);
     gtk_widget_show_all (GTK_WIDGET(omgr_device));
@@ -833,6 +1064,10 @@ GtkWidget * OnvifApp__create_browser_ui(OnvifApp * app){
     gtk_container_add(GTK_CONTAINER(widget),priv->listbox);
     gtk_grid_attach (GTK_GRID (grid), widget, 0, 2, 1, 1);
     g_signal_connect (priv->listbox, "row-selected", G_CALLBACK (OnvifApp__row_selected_cb), app);
+    //Hovered rows are pre-connected
+    gtk_widget_add_events (priv->listbox, GDK_POINTER_MOTION_MASK | GDK_LEAVE_NOTIFY_MASK);
+    g_signal_connect (priv->listbox, "motion-notify-event", G_CALLBACK (OnvifApp__listbox_motion_cb), app);
+    g_signal_connect (priv->listbox, "leave-notify-event", G_CALLBACK (OnvifApp__listbox_leave_cb), app);
     gui_widget_set_css(widget, "* { padding-bottom: 3px; padding-top: 3px; padding-right: 3px; }"); 
 
     widget = gtk_button_new ();
@@ -964,6 +1199,7 @@ void OnvifApp__create_ui (OnvifApp * app) {
     }
 
     priv->window = main_window;
+    gui_dispatch_attach(main_window);
     gtk_widget_show_all (main_window);
 }
 
@@ -971,6 +1207,15 @@ void OnvifApp__dispose(GObject * obj){
     OnvifApp * self = ONVIFMGR_APP(obj);
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
 
+    if(priv->preconnect_hovered){
+        EventQueue__release_event(priv->queue, priv->preconnect_hovered);
+        priv->preconnect_hovered = NULL;
+    }
+    if(priv->preconnect_next){
+        EventQueue__release_event(priv->queue, priv->preconnect_next);
+        priv->preconnect_next = NULL;
+    }
+
     //Destroying the queue will hang until all threads are stopped
     if(priv->queue){
         g_object_unref(priv->queue);
@@ -993,6 +1238,13 @@ void OnvifApp__dispose(GObject * obj){
         g_object_unref(priv->player);
         priv->player = NULL;
     }
+
+    //A pending flush holds a reference, so the batch is empty here
+    if(priv->display_batch){
+        g_ptr_array_free(priv->display_batch, TRUE);
+        priv->display_batch = NULL;
+        g_mutex_clear(&priv->display_lock);
+    }
     
     //Using idle destruction to allow pending idles to execute
     if(priv->window){
@@ -1070,10 +1322,15 @@ OnvifApp__init (OnvifApp *self)
     OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
 
     priv->device = NULL;
+    priv->hovered_row = NULL;
     priv->owned = 1;
     priv->task_label = NULL;
     priv->queue = EventQueue__new();
-    g_signal_connect (G_OBJECT(priv->queue), "pool-changed", G_CALLBACK (OnvifApp__eq_dispatch_cb), self);
+    priv->display_batch = g_ptr_array_new();
+    g_mutex_init(&priv->display_lock);
+    priv->preconnect_hovered = NULL;
+    priv->preconnect_next = NULL;
+    g_signal_connect (G_OBJECT(priv->queue), "pool-stats", G_CALLBACK (OnvifApp__eq_stats_cb), self);
 
     //TODO register listener
     priv->details = OnvifDetails__create(self);
@@ -1097,17 +1354,18 @@ OnvifApp__init (OnvifApp *self)
     //TODO Below can be initialized in parallel while showing a loading for faster windows startup
     //More could be more here slowing down app startup like reading the settings file
 
-    //Defaults 8 paralell event threads.
-    //TODO support configuration to modify this
+    //The pool grows on demand between the configured limits
     C_TRAIL("Starting EventQueue thread pool...");
-    EventQueue__start(priv->queue);
-    EventQueue__start(priv->queue);
-    EventQueue__start(priv->queue);
-    EventQueue__start(priv->queue);
-    EventQueue__start(priv->queue);
-    EventQueue__start(priv->queue);
-    EventQueue__start(priv->queue);
-    EventQueue__start(priv->queue);
+    EventQueue__set_pool_limits(priv->queue,
+                                AppSettingsQueue__get_min_threads(AppSettings__get_queue(priv->settings)),
+                                AppSettingsQueue__get_max_threads(AppSettings__get_queue(priv->settings)));
+    //Replace workers stuck on a half-open camera connection, and abort the stuck call where it's cancellable
+    EventQueue__set_watchdog(priv->queue, 60000, TRUE);
+    //Local CPU bound work keeps its own workers, however many cameras are unreachable
+    EventQueue__add_pool(priv->queue, EVENTQUEUE_POOL_CPU_NAME, 1, g_get_num_processors());
+    OnvifApp__apply_thread_sched(self);
+    //Log queue wait and callback run time percentiles every minute
+    EventQueue__set_metrics_interval(priv->queue, 60000);
 
     OnvifMgrEncryptedStore__capture_passphrase(priv->store);
 }
@@ -1153,6 +1411,23 @@ EventQueue * OnvifApp__get_EventQueue(OnvifApp* self){
     return priv->queue;
 }
 
+void OnvifApp__apply_thread_sched(OnvifApp * self){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (ONVIFMGR_IS_APP (self));
+    OnvifAppPrivate *priv = OnvifApp__get_instance_private (self);
+    AppSettingsQueue * settings = AppSettings__get_queue(priv->settings);
+    ThreadSched sched;
+    int pool;
+
+    AppSettingsQueue__get_worker_sched(settings, &sched);
+    for(pool=0;pool<EventQueue__get_pool_count(priv->queue);pool++){
+        EventQueue__set_thread_sched(EventQueue__get_pool(priv->queue, pool), &sched);
+    }
+
+    AppSettingsQueue__get_player_sched(settings, &sched);
+    GstRtspPlayer__set_thread_sched(priv->player, &sched);
+}
+
 AppSettingsCredentials * OnvifApp__get_credentials(OnvifApp * self){
     g_return_val_if_fail (self != NULL, NULL);
     g_return_val_if_fail (ONVIFMGR_IS_APP (self), NULL);
@@ -30,6 +30,8 @@ OnvifApp * OnvifApp__new (void);
 void OnvifApp__destroy(OnvifApp* self);
 void OnvifApp__show_msg_dialog(OnvifApp * self, OnvifMgrMsgDialog * msg_dialog);
 EventQueue * OnvifApp__get_EventQueue(OnvifApp * self);
+//Applies the thread scheduling settings to every queue pool and to the player
+void OnvifApp__apply_thread_sched(OnvifApp * self);
 
 // Forward declaration for credentials
 typedef struct _AppSettingsCredentials AppSettingsCredentials;
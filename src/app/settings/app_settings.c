@@ -1,6 +1,7 @@
 #include "app_settings.h"
 #include "app_settings_discovery.h"
 #include "app_settings_credentials.h"
+#include "app_settings_queue.h"
 #include "clogger.h"
 #include <pwd.h>
 #include <errno.h>
@@ -13,6 +14,7 @@ void set_settings_state(AppSettings * settings, int state){
     AppSettingsStream__set_state(settings->stream, state);
     AppSettingsDiscovery__set_state(settings->discovery, state);
     AppSettingsCredentials__set_state(settings->credentials, state);
+    AppSettingsQueue__set_state(settings->queue, state);
     //More settings to add here
 }
 
@@ -31,7 +33,8 @@ void priv_AppSettings_state_changed(void * data){
     //More settings to add here
     if(AppSettingsStream__get_state(self->stream) ||
         AppSettingsDiscovery__get_state(self->discovery) ||
-        AppSettingsCredentials__get_state(self->credentials)){
+        AppSettingsCredentials__get_state(self->credentials) ||
+        AppSettingsQueue__get_state(self->queue)){
         set_button_state(self,TRUE);
     } else {
         set_button_state(self,FALSE);
@@ -41,7 +44,8 @@ void priv_AppSettings_state_changed(void * data){
 void priv_AppSettings_state_changed_cb(GtkWidget * widget, AppSettings * self){
     if(AppSettingsStream__get_state(self->stream) ||
         AppSettingsDiscovery__get_state(self->discovery) ||
-        AppSettingsCredentials__get_state(self->credentials)){
+        AppSettingsCredentials__get_state(self->credentials) ||
+        AppSettingsQueue__get_state(self->queue)){
         set_button_state(self,TRUE);
     } else {
         set_button_state(self,FALSE);
@@ -116,6 +120,7 @@ struct extract_data_from_gui_data{
     char * stream_data;
     char * discovery_data;
     char * credentials_data;
+    char * queue_data;
     P_COND_TYPE cond;
     P_MUTEX_TYPE lock;
     int done;
@@ -126,6 +131,7 @@ gboolean idle_extract_data_from_gui(void * user_data){
     data->stream_data = AppSettingsStream__save(data->app_settings->stream);
     data->discovery_data = AppSettingsDiscovery__save(data->app_settings->discovery);
     data->credentials_data = AppSettingsCredentials__save(data->app_settings->credentials);
+    data->queue_data = AppSettingsQueue__save(data->app_settings->queue);
     data->done = 1;
     P_COND_BROADCAST(data->cond);
     return FALSE;
@@ -155,9 +161,16 @@ void _save_settings(QueueEvent * qevt, void * user_data){
         fprintf(fptr,"%s\n\n",data.stream_data);
         fprintf(fptr,"%s\n\n",data.discovery_data);
         fprintf(fptr,"%s\n\n",data.credentials_data);
+        fprintf(fptr,"%s\n\n",data.queue_data);
         //More settings to add here
         
         fclose(fptr);
+
+        //Pool limits and thread scheduling apply without restart
+        EventQueue__set_pool_limits(OnvifApp__get_EventQueue(self->app),
+                                    AppSettingsQueue__get_min_threads(self->queue),
+                                    AppSettingsQueue__get_max_threads(self->queue));
+        OnvifApp__apply_thread_sched(self->app);
     } else {
         C_ERROR("Failed to write to settings file!\n");
     }
@@ -179,6 +192,7 @@ void AppSettings__reset_settings(AppSettings * self){
     AppSettingsStream__reset(self->stream);
     AppSettingsDiscovery__reset(self->discovery);
     AppSettingsCredentials__reset(self->credentials);
+    AppSettingsQueue__reset(self->queue);
     //More settings to add here
 }
 
@@ -216,6 +230,7 @@ void AppSettings__create_ui(AppSettings * self){
     add_panel(notebook, "Discovery", AppSettingsDiscovery__get_widget(self->discovery));
     add_panel(notebook, "Credentials", AppSettingsCredentials__get_widget(self->credentials));
     add_panel(notebook, "Stream", GTK_WIDGET(self->stream));
+    add_panel(notebook, "Performance", AppSettingsQueue__get_widget(self->queue));
 
     //More settings to add here
 
@@ -307,6 +322,9 @@ void AppSettings__load_settings(AppSettings * self){
                     } else if(strcmp(AppSettingsCredentials__get_category(self->credentials),cat) == 0){
                         category = APPSETTING_CREDENTIALS_TYPE;
                         C_INFO("[%s]",AppSettingsCredentials__get_category(self->credentials));
+                    } else if(strcmp(AppSettingsQueue__get_category(self->queue),cat) == 0){
+                        category = APPSETTING_QUEUE_TYPE;
+                        C_INFO("[%s]",AppSettingsQueue__get_category(self->queue));
                     }//More settings to add here
 
                     continue;
@@ -351,6 +369,11 @@ void AppSettings__load_settings(AppSettings * self){
                                 C_ERROR("Unknown credentials property %s=%s",key,val);
                             }
                             break;
+                        case APPSETTING_QUEUE_TYPE:
+                            if(!AppSettingsQueue__set_property(self->queue,key,val)){
+                                C_ERROR("Unknown queue property %s=%s",key,val);
+                            }
+                            break;
                         default:
                             //TODO Warning
                             break;
@@ -379,6 +402,7 @@ AppSettings * AppSettings__create(OnvifApp * app){
     g_signal_connect(self->stream,"settings-changed",G_CALLBACK(priv_AppSettings_state_changed_cb),self);
     self->discovery = AppSettingsDiscovery__create(priv_AppSettings_state_changed,self);
     self->credentials = AppSettingsCredentials__create(priv_AppSettings_state_changed,self);
+    self->queue = AppSettingsQueue__create(priv_AppSettings_state_changed,self);
     AppSettings__load_settings(self);
     AppSettings__create_ui(self);
     AppSettings__reset_settings(self);
@@ -390,6 +414,7 @@ void AppSettings__destroy(AppSettings* self){
     if(self){
         AppSettingsDiscovery__destroy(self->discovery);
         AppSettingsCredentials__destroy(self->credentials);
+        AppSettingsQueue__destroy(self->queue);
         free(self);
     }
 }
@@ -404,4 +429,8 @@ GtkWidget * AppSettings__get_widget(AppSettings * self){
 
 AppSettingsCredentials * AppSettings__get_credentials(AppSettings * self){
     return self->credentials;
+}
+
+AppSettingsQueue * AppSettings__get_queue(AppSettings * self){
+    return self->queue;
 }
\ No newline at end of file
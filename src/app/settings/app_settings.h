@@ -7,6 +7,7 @@
 #include "app_settings_stream.h"
 #include "app_settings_discovery.h"
 #include "app_settings_credentials.h"
+#include "app_settings_queue.h"
 
 typedef struct _AppSettings AppSettings;
 typedef enum _AppSettingsType {
@@ -14,6 +15,7 @@ typedef enum _AppSettingsType {
     APPSETTING_STREAM_TYPE = 0,
     APPSETTING_DISCOVERY_TYPE = 1,
     APPSETTING_CREDENTIALS_TYPE = 2,
+    APPSETTING_QUEUE_TYPE = 3,
 } AppSettingsType;
 
 struct _AppSettings {
@@ -28,6 +30,7 @@ struct _AppSettings {
     AppSettingsStream * stream;
     AppSettingsDiscovery * discovery;
     AppSettingsCredentials * credentials;
+    AppSettingsQueue * queue;
 
     OnvifApp * app;
 };
@@ -40,4 +43,7 @@ GtkWidget * AppSettings__get_widget(AppSettings * self);
 // Credentials access
 AppSettingsCredentials * AppSettings__get_credentials(AppSettings * self);
 
+// Worker pool limits
+AppSettingsQueue * AppSettings__get_queue(AppSettings * self);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,333 @@
+#include "app_settings_queue.h"
+#include "../../queue/event_queue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "clogger.h"
+
+#define APPSETTINGS_QUEUE_CAT "queue"
+#define APPSETTINGS_QUEUE_MIN_LIMIT 1
+#define APPSETTINGS_QUEUE_MAX_LIMIT 64
+#define APPSETTINGS_QUEUE_MAX_NICE 19
+
+static void AppSettingsQueue__dispatch_state_changed(AppSettingsQueue * self){
+    if(self->state_changed_callback){
+        self->state_changed_callback(self->state_changed_user_data);
+    }
+}
+
+static gboolean AppSettingsQueue__scale_change_value (GtkRange* scale, GtkScrollType* scroll, gdouble value, AppSettingsQueue * self){
+    double roundedValue = round(value);
+    int signal = -1;
+    if(scale == GTK_RANGE(self->min_scale)){
+        signal = self->min_signal;
+    } else if(scale == GTK_RANGE(self->max_scale)){
+        signal = self->max_signal;
+    }
+
+    if(signal > -1){
+        g_signal_handler_block(scale,signal);
+        g_signal_emit_by_name(scale, "change-value", scroll, roundedValue,self);
+        g_signal_handler_unblock(scale,signal);
+    }
+
+    //The pool can't be smaller than its minimum
+    int min = gtk_range_get_value (GTK_RANGE(self->min_scale));
+    int max = gtk_range_get_value (GTK_RANGE(self->max_scale));
+    if(min > max){
+        if(scale == GTK_RANGE(self->min_scale)){
+            gtk_range_set_value(GTK_RANGE(self->max_scale),min);
+        } else {
+            gtk_range_set_value(GTK_RANGE(self->min_scale),max);
+        }
+    }
+
+    AppSettingsQueue__dispatch_state_changed(self);
+    return TRUE;
+}
+
+static void AppSettingsQueue__sched_changed (GtkWidget * widget, AppSettingsQueue * self){
+    AppSettingsQueue__dispatch_state_changed(self);
+}
+
+//Unparsable lists count as a change, so they are reported on save
+static int AppSettingsQueue__cpus_changed (GtkWidget * entry, ThreadSched * current){
+    ThreadSched sched = *current;
+    if(!ThreadSched__parse_cpus(&sched, gtk_entry_get_text(GTK_ENTRY(entry)))){
+        return 1;
+    }
+    return !ThreadSched__equals(&sched, current);
+}
+
+static void AppSettingsQueue__set_cpus_text (GtkWidget * entry, ThreadSched * sched){
+    char cpus[THREAD_SCHED_CPUS_LENGTH];
+    ThreadSched__format_cpus(sched, cpus, sizeof(cpus));
+    gtk_entry_set_text(GTK_ENTRY(entry), cpus);
+}
+
+static void AppSettingsQueue__save_cpus (GtkWidget * entry, ThreadSched * sched){
+    const char * text = gtk_entry_get_text(GTK_ENTRY(entry));
+    if(!ThreadSched__parse_cpus(sched, text)){
+        C_WARN("Invalid cpu list '%s'. Keeping the previous cores.",text);
+        AppSettingsQueue__set_cpus_text(entry, sched);
+    }
+}
+
+int AppSettingsQueue__get_state (AppSettingsQueue * self){
+    int v = gtk_range_get_value (GTK_RANGE(self->min_scale));
+    if(v != self->min_threads){
+        return 1;
+    }
+
+    v = gtk_range_get_value (GTK_RANGE(self->max_scale));
+    if(v != self->max_threads){
+        return 1;
+    }
+
+    v = gtk_range_get_value (GTK_RANGE(self->nice_scale));
+    if(v != self->worker_sched.nice){
+        return 1;
+    }
+
+    v = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(self->idle_check));
+    if(v != self->worker_sched.idle){
+        return 1;
+    }
+
+    if(AppSettingsQueue__cpus_changed(self->worker_cpus_entry, &self->worker_sched) ||
+            AppSettingsQueue__cpus_changed(self->player_cpus_entry, &self->player_sched)){
+        return 1;
+    }
+    return 0;
+}
+
+void AppSettingsQueue__set_state(AppSettingsQueue * self,int state){
+    if(GTK_IS_WIDGET(self->min_scale))
+        gtk_widget_set_sensitive(self->min_scale,state);
+    if(GTK_IS_WIDGET(self->max_scale))
+        gtk_widget_set_sensitive(self->max_scale,state);
+    if(GTK_IS_WIDGET(self->nice_scale))
+        gtk_widget_set_sensitive(self->nice_scale,state);
+    if(GTK_IS_WIDGET(self->idle_check))
+        gtk_widget_set_sensitive(self->idle_check,state);
+    if(GTK_IS_WIDGET(self->worker_cpus_entry))
+        gtk_widget_set_sensitive(self->worker_cpus_entry,state);
+    if(GTK_IS_WIDGET(self->player_cpus_entry))
+        gtk_widget_set_sensitive(self->player_cpus_entry,state);
+}
+
+static void AppSettingsQueue__add_marks(GtkWidget * scale){
+    int marks[] = { 1, 8, 16, 24, 32, 40, 48, 56, 64 };
+    int count = sizeof(marks)/sizeof(marks[0]);
+    char label[4];
+    int i;
+    for(i=0;i<count;i++){
+        sprintf(label,"%d",marks[i]);
+        gtk_scale_add_mark (GTK_SCALE(scale),marks[i],GTK_POS_BOTTOM,label);
+    }
+}
+
+static void AppSettingsQueue__add_title(GtkWidget * grid, char * title, char * description, int row){
+    char markup[128];
+    GtkWidget * label = gtk_label_new("");
+    snprintf(markup, sizeof(markup), "<span size=\"large\" ><b>%s</b></span>", title);
+    gtk_label_set_markup(GTK_LABEL(label),markup);
+    gtk_label_set_xalign(GTK_LABEL(label),0);
+    g_object_set (label, "margin-top", 20, NULL);
+    gtk_grid_attach (GTK_GRID (grid), label, 0, row, 1, 1);
+
+    label = gtk_label_new(description);
+    gtk_widget_set_hexpand (label, TRUE);
+    gtk_label_set_xalign(GTK_LABEL(label),0);
+    g_object_set (label, "margin", 10, NULL);
+    gtk_grid_attach (GTK_GRID (grid), label, 0, row+1, 1, 1);
+}
+
+static GtkWidget * AppSettingsQueue__create_cpus_entry(AppSettingsQueue * self, GtkWidget * grid, ThreadSched * sched, int row){
+    GtkWidget * entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(entry), "All cores");
+    AppSettingsQueue__set_cpus_text(entry, sched);
+    g_signal_connect (G_OBJECT (entry), "changed", G_CALLBACK (AppSettingsQueue__sched_changed), self);
+    gtk_grid_attach (GTK_GRID (grid), entry, 0, row, 1, 1);
+    return entry;
+}
+
+GtkWidget * AppSettingsQueue__create_ui(AppSettingsQueue * self){
+    GtkWidget * label;
+    GtkWidget * widget = gtk_grid_new(); //Widget filling up queue page
+
+    g_object_set (widget, "margin", 20, NULL);
+    gtk_widget_set_hexpand (widget, TRUE);
+
+    label = gtk_label_new("");
+    gtk_label_set_markup(GTK_LABEL(label),"<span size=\"large\" ><b>Minimum worker threads</b></span>");
+    gtk_widget_set_hexpand (label, TRUE);
+    gtk_label_set_xalign(GTK_LABEL(label),0);
+    gtk_grid_attach (GTK_GRID (widget), label, 0, 0, 1, 1);
+
+    label = gtk_label_new("Defines how many background threads are always kept alive.\nLower this value on devices with few CPU cores.");
+    gtk_widget_set_hexpand (label, TRUE);
+    gtk_label_set_xalign(GTK_LABEL(label),0);
+    g_object_set (label, "margin", 10, NULL);
+    gtk_grid_attach (GTK_GRID (widget), label, 0, 1, 1, 1);
+
+    self->min_scale = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL,APPSETTINGS_QUEUE_MIN_LIMIT,APPSETTINGS_QUEUE_MAX_LIMIT,1);
+    gtk_widget_set_hexpand (self->min_scale, TRUE);
+    gtk_scale_set_draw_value(GTK_SCALE(self->min_scale),TRUE);
+    gtk_scale_set_digits(GTK_SCALE(self->min_scale),0);
+    gtk_range_set_value(GTK_RANGE(self->min_scale),self->min_threads);
+    AppSettingsQueue__add_marks(self->min_scale);
+    g_object_set (self->min_scale, "margin-bottom", 20, NULL);
+    gtk_grid_attach (GTK_GRID (widget), self->min_scale, 0, 2, 1, 1);
+
+    label = gtk_label_new("");
+    gtk_label_set_markup(GTK_LABEL(label),"<span size=\"large\" ><b>Maximum worker threads</b></span>");
+    gtk_label_set_xalign(GTK_LABEL(label),0);
+    gtk_grid_attach (GTK_GRID (widget), label, 0, 3, 1, 1);
+
+    label = gtk_label_new("Defines how many background threads can be started when tasks are waiting.\nIncreasing this value is useful for sites with many cameras.");
+    gtk_widget_set_hexpand (label, TRUE);
+    gtk_label_set_xalign(GTK_LABEL(label),0);
+    g_object_set (label, "margin", 10, NULL);
+    gtk_grid_attach (GTK_GRID (widget), label, 0, 4, 1, 1);
+
+    self->max_scale = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL,APPSETTINGS_QUEUE_MIN_LIMIT,APPSETTINGS_QUEUE_MAX_LIMIT,1);
+    gtk_widget_set_hexpand (self->max_scale, TRUE);
+    gtk_scale_set_draw_value(GTK_SCALE(self->max_scale),TRUE);
+    gtk_scale_set_digits(GTK_SCALE(self->max_scale),0);
+    gtk_range_set_value(GTK_RANGE(self->max_scale),self->max_threads);
+    AppSettingsQueue__add_marks(self->max_scale);
+    gtk_grid_attach (GTK_GRID (widget), self->max_scale, 0, 5, 1, 1);
+
+    AppSettingsQueue__add_title(widget, "Worker thread priority", 
+        "Nice value added to background threads, so the stream and the interface stay responsive.\nIdle scheduling only runs them on otherwise idle cores.", 6);
+
+    self->nice_scale = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL,0,APPSETTINGS_QUEUE_MAX_NICE,1);
+    gtk_widget_set_hexpand (self->nice_scale, TRUE);
+    gtk_scale_set_draw_value(GTK_SCALE(self->nice_scale),TRUE);
+    gtk_scale_set_digits(GTK_SCALE(self->nice_scale),0);
+    gtk_range_set_round_digits(GTK_RANGE(self->nice_scale),0);
+    gtk_range_set_value(GTK_RANGE(self->nice_scale),self->worker_sched.nice);
+    gtk_grid_attach (GTK_GRID (widget), self->nice_scale, 0, 8, 1, 1);
+
+    self->idle_check = gtk_check_button_new_with_label("Idle scheduling (SCHED_IDLE)");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(self->idle_check),self->worker_sched.idle);
+    gtk_grid_attach (GTK_GRID (widget), self->idle_check, 0, 9, 1, 1);
+
+    AppSettingsQueue__add_title(widget, "Worker thread cores", 
+        "Cores background threads run on, e.g. \"0-2\". Prefix with '^' to exclude cores instead, e.g. \"^3\".", 10);
+    self->worker_cpus_entry = AppSettingsQueue__create_cpus_entry(self, widget, &self->worker_sched, 12);
+
+    AppSettingsQueue__add_title(widget, "Stream thread cores", 
+        "Cores the stream decoding threads run on, using the same format.\nKeep them apart from the worker cores on devices with few CPU cores.", 13);
+    self->player_cpus_entry = AppSettingsQueue__create_cpus_entry(self, widget, &self->player_sched, 15);
+
+    g_signal_connect (G_OBJECT (self->nice_scale), "value-changed", G_CALLBACK (AppSettingsQueue__sched_changed), self);
+    g_signal_connect (G_OBJECT (self->idle_check), "toggled", G_CALLBACK (AppSettingsQueue__sched_changed), self);
+    self->min_signal = g_signal_connect (G_OBJECT (self->min_scale), "change-value", G_CALLBACK (AppSettingsQueue__scale_change_value), self);
+    self->max_signal = g_signal_connect (G_OBJECT (self->max_scale), "change-value", G_CALLBACK (AppSettingsQueue__scale_change_value), self);
+
+    return widget;
+}
+
+static char queue_settings_str[100 + 2*THREAD_SCHED_CPUS_LENGTH];
+char * AppSettingsQueue__save(AppSettingsQueue * self){
+    char worker_cpus[THREAD_SCHED_CPUS_LENGTH];
+    char player_cpus[THREAD_SCHED_CPUS_LENGTH];
+    self->min_threads = gtk_range_get_value (GTK_RANGE(self->min_scale));
+    self->max_threads = gtk_range_get_value (GTK_RANGE(self->max_scale));
+    self->worker_sched.nice = gtk_range_get_value (GTK_RANGE(self->nice_scale));
+    self->worker_sched.idle = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(self->idle_check));
+    AppSettingsQueue__save_cpus(self->worker_cpus_entry, &self->worker_sched);
+    AppSettingsQueue__save_cpus(self->player_cpus_entry, &self->player_sched);
+    ThreadSched__format_cpus(&self->worker_sched, worker_cpus, sizeof(worker_cpus));
+    ThreadSched__format_cpus(&self->player_sched, player_cpus, sizeof(player_cpus));
+    sprintf(queue_settings_str, "[%s]\nmin_threads=%i\nmax_threads=%i\nworker_nice=%i\nworker_idle=%i\nworker_cpus=%s\nplayer_cpus=%s",
+            APPSETTINGS_QUEUE_CAT, self->min_threads, self->max_threads, 
+            self->worker_sched.nice, self->worker_sched.idle, worker_cpus, player_cpus);
+    return queue_settings_str;
+}
+
+void AppSettingsQueue__init(AppSettingsQueue * self, void (*state_changed_callback)(void * ),void * state_changed_user_data){
+    self->min_threads = EVENTQUEUE_DEFAULT_MIN_THREADS;
+    self->max_threads = EVENTQUEUE_DEFAULT_MAX_THREADS;
+    self->min_scale = NULL;
+    self->max_scale = NULL;
+    self->worker_sched = (ThreadSched) THREAD_SCHED_INIT;
+    self->player_sched = (ThreadSched) THREAD_SCHED_INIT;
+    self->nice_scale = NULL;
+    self->idle_check = NULL;
+    self->worker_cpus_entry = NULL;
+    self->player_cpus_entry = NULL;
+    self->state_changed_callback = state_changed_callback;
+    self->state_changed_user_data = state_changed_user_data;
+    self->widget = AppSettingsQueue__create_ui(self);
+}
+
+AppSettingsQueue * AppSettingsQueue__create(void (*state_changed_callback)(void * ),void * state_changed_user_data){
+    AppSettingsQueue * self = malloc(sizeof(AppSettingsQueue));
+    AppSettingsQueue__init(self,state_changed_callback, state_changed_user_data);
+    return self;
+}
+
+void AppSettingsQueue__destroy(AppSettingsQueue * self){
+    free(self);
+}
+
+GtkWidget * AppSettingsQueue__get_widget(AppSettingsQueue * self){
+    return self->widget;
+}
+
+void AppSettingsQueue__reset(AppSettingsQueue * self){
+    gtk_range_set_value(GTK_RANGE(self->min_scale),self->min_threads);
+    gtk_range_set_value(GTK_RANGE(self->max_scale),self->max_threads);
+    gtk_range_set_value(GTK_RANGE(self->nice_scale),self->worker_sched.nice);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(self->idle_check),self->worker_sched.idle);
+    AppSettingsQueue__set_cpus_text(self->worker_cpus_entry, &self->worker_sched);
+    AppSettingsQueue__set_cpus_text(self->player_cpus_entry, &self->player_sched);
+    AppSettingsQueue__dispatch_state_changed(self);
+}
+
+char * AppSettingsQueue__get_category(AppSettingsQueue * self){
+    return APPSETTINGS_QUEUE_CAT;
+}
+
+int AppSettingsQueue__set_property(AppSettingsQueue * self, char * key, char * value){
+    int valid = 0;
+    if(!strcmp(key,"min_threads")){
+        self->min_threads = CLAMP(atoi(value),APPSETTINGS_QUEUE_MIN_LIMIT,APPSETTINGS_QUEUE_MAX_LIMIT);
+        valid = 1;
+    } else if(!strcmp(key,"max_threads")){
+        self->max_threads = CLAMP(atoi(value),APPSETTINGS_QUEUE_MIN_LIMIT,APPSETTINGS_QUEUE_MAX_LIMIT);
+        valid = 1;
+    } else if(!strcmp(key,"worker_nice")){
+        self->worker_sched.nice = CLAMP(atoi(value),0,APPSETTINGS_QUEUE_MAX_NICE);
+        valid = 1;
+    } else if(!strcmp(key,"worker_idle")){
+        self->worker_sched.idle = atoi(value) != 0;
+        valid = 1;
+    } else if(!strcmp(key,"worker_cpus")){
+        valid = ThreadSched__parse_cpus(&self->worker_sched, value);
+    } else if(!strcmp(key,"player_cpus")){
+        valid = ThreadSched__parse_cpus(&self->player_sched, value);
+    }
+    
+    return valid;
+}
+
+int AppSettingsQueue__get_min_threads(AppSettingsQueue * self){
+    return self->min_threads;
+}
+
+int AppSettingsQueue__get_max_threads(AppSettingsQueue * self){
+    return (self->max_threads < self->min_threads) ? self->min_threads : self->max_threads;
+}
+
+void AppSettingsQueue__get_worker_sched(AppSettingsQueue * self, ThreadSched * sched){
+    *sched = self->worker_sched;
+}
+
+void AppSettingsQueue__get_player_sched(AppSettingsQueue * self, ThreadSched * sched){
+    *sched = self->player_sched;
+}
@@ -0,0 +1,47 @@
+#ifndef ONVIF_APP_SETTINGS_QUEUE_H_ 
+#define ONVIF_APP_SETTINGS_QUEUE_H_
+
+#include <gtk/gtk.h>
+#include "../../utils/thread_sched.h"
+
+typedef struct _AppSettingsQueue AppSettingsQueue;
+
+struct _AppSettingsQueue {
+    GtkWidget * widget;
+    GtkWidget * min_scale;
+    GtkWidget * max_scale;
+
+    int min_threads;
+    int min_signal;
+
+    int max_threads;
+    int max_signal;
+
+    //Worker nice value, SCHED_IDLE and cores. The player only keeps its own cores.
+    ThreadSched worker_sched;
+    ThreadSched player_sched;
+    GtkWidget * nice_scale;
+    GtkWidget * idle_check;
+    GtkWidget * worker_cpus_entry;
+    GtkWidget * player_cpus_entry;
+
+    void (*state_changed_callback)(void * );
+    void * state_changed_user_data;
+};
+
+AppSettingsQueue * AppSettingsQueue__create(void (*state_changed_callback)(void * ),void * state_changed_user_data);
+int AppSettingsQueue__get_state(AppSettingsQueue * settings);
+void AppSettingsQueue__set_state(AppSettingsQueue * self,int state);
+char * AppSettingsQueue__save(AppSettingsQueue *self);
+void AppSettingsQueue__reset(AppSettingsQueue * settings);
+char * AppSettingsQueue__get_category(AppSettingsQueue * self);
+int AppSettingsQueue__set_property(AppSettingsQueue * self, char * key, char * value);
+GtkWidget * AppSettingsQueue__get_widget(AppSettingsQueue * dialog);
+void AppSettingsQueue__destroy(AppSettingsQueue * self);
+
+int AppSettingsQueue__get_min_threads(AppSettingsQueue * self);
+int AppSettingsQueue__get_max_threads(AppSettingsQueue * self);
+void AppSettingsQueue__get_worker_sched(AppSettingsQueue * self, ThreadSched * sched);
+void AppSettingsQueue__get_player_sched(AppSettingsQueue * self, ThreadSched * sched);
+
+#endif
@@ -15,16 +15,8 @@ typedef struct {
 G_DEFINE_TYPE_WITH_PRIVATE(OnvifTaskManager, OnvifTaskManager_, GTK_TYPE_BOX)
 static GParamSpec *obj_properties[N_PROPERTIES] = { NULL, };
 
-void OnvifTaskManager__eq_added_cb(EventQueue * queue, QueueEvent * evt, OnvifTaskManager * self){
-    C_DEBUG("Task Manager : Event Added");
-}
-
-void OnvifTaskManager__eq_finished_cb(EventQueue * queue, QueueEvent * evt, OnvifTaskManager * self){
-    C_DEBUG("Task Manager : Event finished");
-}
-
-void OnvifTaskManager__eq_started_cb(EventQueue * queue, QueueEvent * evt, OnvifTaskManager * self){
-    C_DEBUG("Task Manager : Event Started");
+void OnvifTaskManager__eq_stats_cb(EventQueue * queue, int running, int pending, int threads, int delayed, OnvifTaskManager * self){
+    C_DEBUG("Task Manager : %d running, %d pending, %d delayed on %d threads",running,pending,delayed,threads);
 }
 
 static void
@@ -45,9 +37,8 @@ OnvifTaskManager__set_property (GObject      *object,
     switch (prop_id){
         case PROP_QUEUE:
             priv->queue = g_value_get_object (value);
-            g_signal_connect (G_OBJECT(priv->queue), "evt-added", G_CALLBACK (OnvifTaskManager__eq_added_cb), self);
-            g_signal_connect (G_OBJECT(priv->queue), "evt-started", G_CALLBACK (OnvifTaskManager__eq_started_cb), self);
-            g_signal_connect (G_OBJECT(priv->queue), "evt-finished", G_CALLBACK (OnvifTaskManager__eq_finished_cb), self);
+            //Per event signals are emitted on the worker threads. Counters are enough here.
+            g_signal_connect (G_OBJECT(priv->queue), "pool-stats", G_CALLBACK (OnvifTaskManager__eq_stats_cb), self);
             break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -1,52 +1,432 @@
 #include "../queue/event_queue.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <argp.h>
 #include "clogger.h"
 
-void evt_callback(QueueEvent * qevt, void * user_data){
-    char * data = (char *) user_data;
+/*
+ * EventQueue benchmark harness.
+ * Every result is printed on stdout as one JSON object per line, so runs can be diffed or plotted.
+ * Logs are disabled by default to keep them out of the measurements.
+ */
 
-    C_DEBUG("Background Task data : %s\n",data);
+static struct argp_option options[] = {
+    { "loglevel",       'l',    "INT",     0,  "Set the log level. (Default: -1)", 1},
+    { "events",         'e',    "INT",     0,  "Events inserted per throughput run. (Default: 100000)", 1},
+    { "producers",      'p',    "INT",     0,  "Highest producer count, doubled from 1. (Default: 64)", 1},
+    { "workers",        'w',    "INT",     0,  "Worker threads servicing the queue. (Default: 4)", 1},
+    { "pending",        'n',    "INT",     0,  "Pending events cancelled by scope. (Default: 10000)", 1},
+    { "threads",        't',    "INT",     0,  "Threads started and stopped. (Default: 16)", 1},
+    { "ring",           'r',    "INT",     0,  "Ready ring capacity compared with the mutex lanes, 0 to skip. (Default: 4096)", 1},
+    { 0 }
+};
 
+struct arguments {
+    int log_level;
+    int events;
+    int producers;
+    int workers;
+    int pending;
+    int threads;
+    int ring;
+};
+
+static error_t
+parse_opt(int key, char *arg, struct argp_state *state) {
+    struct arguments *arguments = state->input;
+    switch (key) {
+    case 'l': arguments->log_level = atoi(arg); break;
+    case 'e': arguments->events = atoi(arg); break;
+    case 'p': arguments->producers = atoi(arg); break;
+    case 'w': arguments->workers = atoi(arg); break;
+    case 'n': arguments->pending = atoi(arg); break;
+    case 't': arguments->threads = atoi(arg); break;
+    case 'r': arguments->ring = atoi(arg); break;
+    case ARGP_KEY_ARG: return 0;
+    default: return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static char doc[] = "EventQueue benchmark";
+
+static struct argp argp = { options, parse_opt, NULL, doc, 0, 0, 0 };
+
+typedef struct {
+    gint64 inserted;
+    gint64 dispatched;
+} BenchSample;
+
+typedef struct {
+    EventQueue * queue;
+    BenchSample * samples;
+    int count;
+    gint * go;
+} BenchProducer;
+
+static gint bench_done;
+static int bench_total;
+static GMutex bench_lock;
+static GCond bench_cond;
+
+static void
+bench_callback(QueueEvent * qevt, void * user_data){
+    BenchSample * sample = user_data;
+    sample->dispatched = g_get_monotonic_time();
+    if(g_atomic_int_add(&bench_done, 1) + 1 == bench_total){
+        g_mutex_lock(&bench_lock);
+        g_cond_signal(&bench_cond);
+        g_mutex_unlock(&bench_lock);
+    }
+}
+
+static void
+bench_noop_callback(QueueEvent * qevt, void * user_data){
+
+}
+
+static void
+bench_blocking_callback(QueueEvent * qevt, void * user_data){
+    g_usleep(GPOINTER_TO_INT(user_data));
+}
+
+static gint bench_refused;
+
+//Runs once per event, whether it was dispatched, dropped or refused
+static void
+bench_overflow_cleanup(QueueEvent * qevt, int cancelled, void * user_data){
+    if(cancelled){
+        g_atomic_int_inc(&bench_refused);
+    }
+    if(g_atomic_int_add(&bench_done, 1) + 1 == bench_total){
+        g_mutex_lock(&bench_lock);
+        g_cond_signal(&bench_cond);
+        g_mutex_unlock(&bench_lock);
+    }
+}
+
+static void
+bench_pool_changed_cb(EventQueue * queue, QueueEventType type, int running, int pending, int threadcount, QueueEvent * evt, int lane, void * user_data){
+
+}
+
+static void
+bench_wait_done(void){
+    g_mutex_lock(&bench_lock);
+    while(g_atomic_int_get(&bench_done) < bench_total){
+        g_cond_wait(&bench_cond, &bench_lock);
+    }
+    g_mutex_unlock(&bench_lock);
+}
+
+static gpointer
+bench_producer(gpointer data){
+    BenchProducer * producer = data;
+    int i;
+    while(!g_atomic_int_get(producer->go)){
+        g_thread_yield();
+    }
+    for(i=0;i<producer->count;i++){
+        producer->samples[i].inserted = g_get_monotonic_time();
+        EventQueue__insert_plain(producer->queue, NULL, bench_callback, &producer->samples[i], NULL);
+    }
+    return NULL;
+}
+
+static int
+bench_compare_gint64(const void * a, const void * b){
+    gint64 va = *(const gint64 *) a;
+    gint64 vb = *(const gint64 *) b;
+    return (va > vb) - (va < vb);
+}
+
+static gint64
+bench_percentile(gint64 * sorted, int count, double percentile){
+    int index = (int) (count * percentile / 100.0);
+    if(index >= count){
+        index = count - 1;
+    }
+    return sorted[index];
+}
+
+//Wait until the worker count settles on the expected value
+static gint64
+bench_wait_threads(EventQueue * queue, int expected){
+    gint64 start = g_get_monotonic_time();
+    while(EventQueue__get_thread_count(queue) != expected){
+        g_usleep(50);
+    }
+    return g_get_monotonic_time() - start;
+}
+
+static EventQueue *
+bench_queue_new(int workers, int ring){
+    EventQueue * queue = EventQueue__new();
+    if(ring){
+        EventQueue__set_ready_ring(queue, ring);
+    }
+    EventQueue__set_pool_limits(queue, workers, workers);
+    bench_wait_threads(queue, workers);
+    return queue;
+}
+
+static void
+bench_queue_destroy(EventQueue * queue){
+    //Workers exit on their own before dispose joins them
+    EventQueue__set_pool_limits(queue, 0, 0);
+    bench_wait_threads(queue, 0);
+    g_object_unref(queue);
+}
+
+//Insert to pop throughput and latency with concurrent producers. Returns the events dispatched per second.
+static double
+bench_throughput(struct arguments * args, int producers, int pool_changed, int ring){
+    EventQueue * queue = bench_queue_new(args->workers, ring);
+    if(pool_changed){
+        g_signal_connect (G_OBJECT(queue), "pool-changed", G_CALLBACK (bench_pool_changed_cb), NULL);
+    }
+
+    int per_producer = args->events / producers;
+    if(!per_producer){
+        bench_queue_destroy(queue);
+        return 0;
+    }
+    bench_total = per_producer * producers;
+    g_atomic_int_set(&bench_done, 0);
+
+    BenchSample * samples = g_new0(BenchSample, bench_total);
+    BenchProducer * states = g_new0(BenchProducer, producers);
+    GThread ** threads = g_new0(GThread *, producers);
+    gint go = 0;
+    int i;
+    for(i=0;i<producers;i++){
+        states[i].queue = queue;
+        states[i].samples = &samples[i * per_producer];
+        states[i].count = per_producer;
+        states[i].go = &go;
+        threads[i] = g_thread_new("bench-producer", bench_producer, &states[i]);
+    }
+
+    gint64 start = g_get_monotonic_time();
+    g_atomic_int_set(&go, 1);
+    for(i=0;i<producers;i++){
+        g_thread_join(threads[i]);
+    }
+    gint64 inserted = g_get_monotonic_time();
+    bench_wait_done();
+    gint64 end = g_get_monotonic_time();
+    double rate = bench_total * (double) G_TIME_SPAN_SECOND / (end - start);
+
+    gint64 * latencies = g_new(gint64, bench_total);
+    for(i=0;i<bench_total;i++){
+        latencies[i] = samples[i].dispatched - samples[i].inserted;
+    }
+    qsort(latencies, bench_total, sizeof(gint64), bench_compare_gint64);
+
+    printf("{\"bench\":\"throughput\",\"producers\":%d,\"workers\":%d,\"ring\":%d,\"pool_changed\":%s,\"events\":%d,"
+        "\"insert_us\":%" G_GINT64_FORMAT ",\"total_us\":%" G_GINT64_FORMAT ",\"events_per_sec\":%.0f,"
+        "\"latency_us\":{\"p50\":%" G_GINT64_FORMAT ",\"p95\":%" G_GINT64_FORMAT ",\"p99\":%" G_GINT64_FORMAT ",\"max\":%" G_GINT64_FORMAT "}}\n",
+        producers, args->workers, ring, pool_changed ? "true" : "false", bench_total,
+        inserted - start, end - start, rate,
+        bench_percentile(latencies, bench_total, 50), bench_percentile(latencies, bench_total, 95),
+        bench_percentile(latencies, bench_total, 99), latencies[bench_total - 1]);
+    fflush(stdout);
+
+    g_free(latencies);
+    g_free(threads);
+    g_free(states);
+    bench_queue_destroy(queue);
+    g_free(samples);
+    return rate;
 }
 
-void evt_cleanup_callback(QueueEvent * qevt, int cancelled, void * user_data){
+//Latency of short events while blocking ones saturate the default pool, either sharing its workers or in their own pool
+static void
+bench_bulkhead(struct arguments * args, int isolated){
+    EventQueue * queue = bench_queue_new(args->workers, 0);
+    QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+    if(isolated){
+        options.pool = EventQueue__add_pool(queue, EVENTQUEUE_POOL_CPU_NAME, args->workers, args->workers);
+        bench_wait_threads(EventQueue__get_pool(queue, options.pool), args->workers);
+    }
+
+    int blocking = args->workers * 4;
+    int i;
+    for(i=0;i<blocking;i++){
+        EventQueue__insert_plain(queue, NULL, bench_blocking_callback, GINT_TO_POINTER(50000), NULL);
+    }
+
+    bench_total = 1000;
+    g_atomic_int_set(&bench_done, 0);
+    BenchSample * samples = g_new0(BenchSample, bench_total);
+    for(i=0;i<bench_total;i++){
+        samples[i].inserted = g_get_monotonic_time();
+        EventQueue__insert_plain_with_options(queue, &options, NULL, bench_callback, &samples[i], NULL);
+    }
+    bench_wait_done();
+
+    gint64 * latencies = g_new(gint64, bench_total);
+    for(i=0;i<bench_total;i++){
+        latencies[i] = samples[i].dispatched - samples[i].inserted;
+    }
+    qsort(latencies, bench_total, sizeof(gint64), bench_compare_gint64);
+
+    printf("{\"bench\":\"bulkhead\",\"isolated\":%s,\"workers\":%d,\"blocking\":%d,\"events\":%d,"
+        "\"latency_us\":{\"p50\":%" G_GINT64_FORMAT ",\"p95\":%" G_GINT64_FORMAT ",\"p99\":%" G_GINT64_FORMAT ",\"max\":%" G_GINT64_FORMAT "}}\n",
+        isolated ? "true" : "false", args->workers, blocking, bench_total,
+        bench_percentile(latencies, bench_total, 50), bench_percentile(latencies, bench_total, 95),
+        bench_percentile(latencies, bench_total, 99), latencies[bench_total - 1]);
+    fflush(stdout);
+
+    g_free(latencies);
+    bench_queue_destroy(queue);
+    g_free(samples);
+}
+
+//Producer throughput and losses of a single producer flooding a bounded queue
+static void
+bench_overflow(struct arguments * args, QueueEventOverflow policy){
+    static const char * names[EVENTQUEUE_OVERFLOW_COUNT] = { "block", "reject", "drop_oldest", "drop_newest" };
+    int capacity = 256;
+    EventQueue * queue = bench_queue_new(args->workers, 0);
+    EventQueue__set_capacity(queue, capacity, policy);
+
+    bench_total = args->events;
+    g_atomic_int_set(&bench_done, 0);
+    g_atomic_int_set(&bench_refused, 0);
+    int i;
+    gint64 start = g_get_monotonic_time();
+    for(i=0;i<bench_total;i++){
+        EventQueue__insert_plain(queue, NULL, bench_noop_callback, NULL, bench_overflow_cleanup);
+    }
+    gint64 inserted = g_get_monotonic_time();
+    bench_wait_done();
+
+    printf("{\"bench\":\"overflow\",\"policy\":\"%s\",\"capacity\":%d,\"workers\":%d,\"events\":%d,\"insert_us\":%" G_GINT64_FORMAT ",\"refused\":%d,\"overflows\":%d}\n",
+        names[policy], capacity, args->workers, bench_total, inserted - start,
+        g_atomic_int_get(&bench_refused), EventQueue__get_overflow_count(queue, policy));
+    fflush(stdout);
+
+    bench_queue_destroy(queue);
+}
+
+//Cost of cancelling pending events, either all scopes at once or a single scope among many
+static void
+bench_cancel_scopes(struct arguments * args, int scope_count){
+    EventQueue * queue = EventQueue__new(); //No worker, so every event stays pending
+    void ** scopes = g_new(void *, scope_count);
+    int i;
+    for(i=0;i<scope_count;i++){
+        scopes[i] = GINT_TO_POINTER(i + 1);
+    }
+
+    for(i=0;i<args->pending;i++){
+        EventQueue__insert_plain(queue, scopes[i % scope_count], bench_noop_callback, NULL, NULL);
+    }
+    gint64 start = g_get_monotonic_time();
+    EventQueue__cancel_scopes(queue, scopes, 1);
+    gint64 single = g_get_monotonic_time() - start;
+    int remaining = EventQueue__get_pending_count(queue);
+
+    start = g_get_monotonic_time();
+    EventQueue__cancel_scopes(queue, scopes, scope_count);
+    gint64 all = g_get_monotonic_time() - start;
+
+    printf("{\"bench\":\"cancel_scopes\",\"pending\":%d,\"scopes\":%d,\"single_scope_us\":%" G_GINT64_FORMAT ",\"remaining_scopes_us\":%" G_GINT64_FORMAT ",\"remaining_events\":%d}\n",
+        args->pending, scope_count, single, all, remaining);
+    fflush(stdout);
 
+    g_free(scopes);
+    g_object_unref(queue);
 }
 
-void eventqueue_dispatch_cb(EventQueue * queue, QueueEventType type, int running, int pending, int threadcount, QueueEvent * evt, void * self){
-    char str[100];
-    memset(&str,'\0',sizeof(str));
-    C_DEBUG("Event %s [%d/%d]",g_enum_to_nick(QUEUE_TYPE_EVENTTYPE,type), running + pending, threadcount);
+//Time until started workers are running and until stopped workers have exited
+static void
+bench_threads(struct arguments * args){
+    EventQueue * queue = EventQueue__new();
+    int i;
+    gint64 start = g_get_monotonic_time();
+    for(i=0;i<args->threads;i++){
+        EventQueue__start(queue);
+    }
+    bench_wait_threads(queue, args->threads);
+    gint64 started = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    EventQueue__stop(queue, args->threads);
+    bench_wait_threads(queue, 0);
+    gint64 stopped = g_get_monotonic_time() - start;
+
+    printf("{\"bench\":\"threads\",\"threads\":%d,\"start_us\":%" G_GINT64_FORMAT ",\"stop_us\":%" G_GINT64_FORMAT ",\"start_per_thread_us\":%" G_GINT64_FORMAT ",\"stop_per_thread_us\":%" G_GINT64_FORMAT "}\n",
+        args->threads, started, stopped, started / args->threads, stopped / args->threads);
+    fflush(stdout);
+
+    g_object_unref(queue);
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+    struct arguments arguments;
+    arguments.log_level = C_OFF_E;
+    arguments.events = 100000;
+    arguments.producers = 64;
+    arguments.workers = 4;
+    arguments.pending = 10000;
+    arguments.threads = 16;
+    arguments.ring = 4096;
+    argp_parse(&argp, argc, argv, 0, 0, &arguments);
+
+    if(arguments.events < 1 || arguments.producers < 1 || arguments.workers < 1 || arguments.pending < 1 || arguments.threads < 1 || arguments.ring < 0){
+        fprintf(stderr, "Counts must be positive\n");
+        return 1;
+    }
+
+    c_log_set_level(arguments.log_level);
     c_log_set_thread_color(ANSI_COLOR_DRK_GREEN, P_THREAD_ID);
-    EventQueue * queue = EventQueue__new();
-    g_signal_connect (G_OBJECT(queue), "pool-changed", G_CALLBACK (eventqueue_dispatch_cb), NULL);
-
-    char * scope1 = "1";
-    char * scope2 = "2";
-
-    EventQueue__insert_plain(queue,scope1,evt_callback,"Data 1", evt_cleanup_callback);
-    EventQueue__insert_plain(queue,scope1,evt_callback,"Data 2", evt_cleanup_callback);
-    EventQueue__insert_plain(queue,scope1,evt_callback,"Data 3", evt_cleanup_callback);
-    EventQueue__insert_plain(queue,scope2,evt_callback,"Data 4", evt_cleanup_callback);
-    EventQueue__insert_plain(queue,scope2,evt_callback,"Data 5", evt_cleanup_callback);
-    EventQueue__insert_plain(queue,scope2,evt_callback,"Data 6", evt_cleanup_callback);
-
-
-    EventQueue__start(queue);
-    EventQueue__start(queue);
-    EventQueue__start(queue);
-    EventQueue__start(queue);
-    while(1){
-        sleep(3);
-        // EventQueue__insert(queue,evt);
-        // snprintf(numstr, 12, "Data %d", index++);
-        // printf("buff %s\n",numstr);
-        EventQueue__insert_plain(queue,NULL,evt_callback,"Data 6", evt_cleanup_callback);
-    }
-}
\ No newline at end of file
+    g_mutex_init(&bench_lock);
+    g_cond_init(&bench_cond);
+
+    //Mutex lanes first, then the lock-free ready rings under the same fan-out, summarized side by side
+    int producers;
+    GArray * mutex_rates = g_array_new(FALSE, FALSE, sizeof(double));
+    for(producers=1;producers<=arguments.producers;producers*=2){
+        double rate = bench_throughput(&arguments, producers, FALSE, 0);
+        g_array_append_val(mutex_rates, rate);
+    }
+    if(arguments.ring){
+        guint run = 0;
+        for(producers=1;producers<=arguments.producers;producers*=2, run++){
+            double rate = bench_throughput(&arguments, producers, FALSE, arguments.ring);
+            double mutex_rate = g_array_index(mutex_rates, double, run);
+            printf("{\"bench\":\"ring_vs_mutex\",\"producers\":%d,\"workers\":%d,\"ring\":%d,\"mutex_events_per_sec\":%.0f,\"ring_events_per_sec\":%.0f,\"speedup\":%.2f}\n",
+                producers, arguments.workers, arguments.ring, mutex_rate, rate, (mutex_rate > 0) ? rate / mutex_rate : 0);
+            fflush(stdout);
+        }
+    }
+    g_array_free(mutex_rates, TRUE);
+
+    //Per event signal overhead, on a single producer
+    bench_throughput(&arguments, 1, TRUE, 0);
+
+    //Short events behind a saturated pool, then in a separate one
+    bench_bulkhead(&arguments, FALSE);
+    bench_bulkhead(&arguments, TRUE);
+
+    QueueEventOverflow policy;
+    for(policy=0;policy<EVENTQUEUE_OVERFLOW_COUNT;policy++){
+        bench_overflow(&arguments, policy);
+    }
+
+    int scopes;
+    for(scopes=1;scopes<=arguments.pending;scopes*=10){
+        bench_cancel_scopes(&arguments, scopes);
+    }
+
+    bench_threads(&arguments);
+
+    g_cond_clear(&bench_cond);
+    g_mutex_clear(&bench_lock);
+    return 0;
+}
@@ -34,6 +34,17 @@ struct _GstRtspPlayerSession {
     char * host_fallback;
     int enable_backchannel;
     void * user_data;
+    //Monotonic time of the last play attempt, to report the switch time
+    gint64 play_time;
+
+    //Pre-connected ahead of a likely play, paused once SETUP is done. Guarded by preconnect_lock.
+    int speculative;
+    gint64 preconnect_time;
+    int profile; //Stream profile the url was resolved for, checked before the session is played
+    //Pads and backchannel stream received while speculative, bound once played
+    GList * pending_pads;
+    GstCaps * back_caps;
+    guint back_idx;
 };
 
 typedef struct {
@@ -46,6 +57,12 @@ typedef struct {
     //Reusable bins containing encoder and sink
     GstElement * video_bin;
     GstElement * audio_bin;
+    //Persistent pipeline rendering the frames handed off by video_bin
+    GstElement * display_pipeline;
+    GstElement * display_src;
+    int display_started;
+    //A frame of the current session was handed to the display
+    int displaying;
     GstElement *sink;  /* Video Sink */
     GstElement *snapsink;
     GstCaps * sinkcaps; /* reference to extract native stream dimension */
@@ -63,6 +80,23 @@ typedef struct {
     GstRtspViewMode view_mode;
 
     P_MUTEX_TYPE player_lock;
+
+    //Scheduling of the loop and streaming threads. Taken alone, since streaming threads read it as they start.
+    ThreadSched sched;
+    GMutex sched_lock;
+
+    //Pre-connected sessions, oldest first. Taken after player_lock, and never held across a state change.
+    GList * preconnects;
+    GMutex preconnect_lock;
+
+    //Persistent JPEG encoder fed with the frames handed off by video_bin
+    GstElement * snapshot_pipeline;
+    GstElement * snapshot_src;
+    //Requests waiting for the next frame, and the request lists of the frames being encoded, oldest first.
+    //Taken alone, and never held across a state change or a callback.
+    GList * snapshot_requests;
+    GQueue * snapshot_batches;
+    GMutex snapshot_lock;
 } GstRtspPlayerPrivate;
 
 typedef struct {
@@ -97,6 +131,13 @@ G_DEFINE_TYPE_WITH_PRIVATE(GstRtspPlayer, GstRtspPlayer_, G_TYPE_OBJECT)
 
 static gboolean 
 GstRtspPlayerSession__message_handler (GstBus * bus, GstMessage * message, GstRtspPlayerSession * session);
+static GstBusSyncReply
+GstRtspPlayerSession__sync_handler (GstBus * bus, GstMessage * message, GstRtspPlayerSession * session);
+static gboolean
+GstRtspPlayerPrivate__display_message_handler (GstBus * bus, GstMessage * message, GstRtspPlayerPrivate * priv);
+static GstBusSyncReply
+GstRtspPlayerPrivate__sync_handler (GstBus * bus, GstMessage * message, GstRtspPlayerPrivate * priv);
+gboolean GstRtspPlayerPrivate__idle_update_canvas(GstRtspPlayerPrivate * priv);
 
 static gboolean _player_signal_and_wait(GstSignalWaitData * data){
     g_signal_emit_valist (data->player, data->signalid, 0, data->args);
@@ -164,6 +205,15 @@ static GstRtspPlayerSession * GstRtspPlayerSession__create(GstRtspPlayer * playe
     }
 
     session->enable_backchannel = 1;
+    session->pipeline = NULL;
+    session->src = NULL;
+    session->play_time = 0;
+    session->speculative = 0;
+    session->preconnect_time = 0;
+    session->profile = 0;
+    session->pending_pads = NULL;
+    session->back_caps = NULL;
+    session->back_idx = 0;
     session->retry = 0;
     session->dynamic_elements = NULL;
     session->fallback = RTSP_FALLBACK_NONE;
@@ -185,6 +235,14 @@ static void GstRtspPlayerSession__destroy(GstRtspPlayerSession * session){
             gst_object_unref (session->pipeline);
             session->pipeline = NULL;
         }
+        if(session->pending_pads){
+            g_list_free_full(session->pending_pads, gst_object_unref);
+            session->pending_pads = NULL;
+        }
+        if(session->back_caps){
+            gst_caps_unref(session->back_caps);
+            session->back_caps = NULL;
+        }
         if(session->port_fallback){
             free(session->port_fallback);
             session->port_fallback = NULL;
@@ -298,21 +356,16 @@ void GstRtspPlayer__caps_changed_cb (GstElement * overlay, GstCaps * caps, gint
     GstRtspPlayerPrivate__apply_view_mode(priv);
 }
 
+/*
+ * The display branch runs in its own pipeline, started once and kept PLAYING until dispose.
+ * Camera pipelines go to NULL on every switch, which would otherwise recreate the GL context each time.
+ */
 static GstElement*
-GstRtspPlayerPrivate__create_video_pad(GstRtspPlayerPrivate * priv){
-    GstElement *vdecoder, *videoconvert, *overlay_comp, *video_bin;
-    GstPad *pad, *ghostpad;
+GstRtspPlayerPrivate__create_display_pipeline(GstRtspPlayerPrivate * priv){
+    GstElement *display_pipeline, *videoconvert, *overlay_comp;
 
-    video_bin = gst_bin_new("video_bin");
-    vdecoder = gst_element_factory_make ("decodebin", "video_decodebin");
-    if (!vdecoder) {
-        C_WARN("decodebin not available, trying decodebin3");
-        vdecoder = gst_element_factory_make ("decodebin3", "video_decodebin");
-    }
-    if (!vdecoder) {
-        C_WARN("Neither decodebin nor decodebin3 available, trying uridecodebin");
-        vdecoder = gst_element_factory_make ("uridecodebin", "video_decodebin");
-    }
+    display_pipeline = gst_pipeline_new ("display-pipeline");
+    priv->display_src = gst_element_factory_make ("appsrc", "display_src");
     videoconvert = gst_element_factory_make ("videoconvert", "videoconverter");
     overlay_comp = gst_element_factory_make ("overlaycomposition", NULL);
     priv->sink = gst_element_factory_make ("glsinkbin", "glsinkbin");
@@ -324,7 +377,8 @@ GstRtspPlayerPrivate__create_video_pad(GstRtspPlayerPrivate * priv){
         //Temporarely disabled for performance
         g_object_set (G_OBJECT (priv->snapsink), "enable-last-sample", FALSE, NULL);
 
-        // gst_base_sink_set_sync(GST_BASE_SINK_CAST(priv->snapsink),FALSE);
+        //Frames are already paced by the camera pipeline
+        gst_base_sink_set_sync(GST_BASE_SINK_CAST(priv->snapsink),FALSE);
         gst_base_sink_set_qos_enabled(GST_BASE_SINK_CAST(priv->snapsink),FALSE);
     } else {
         C_WARN ("Could not create gtkglsink, falling back to gtksink.\n");
@@ -345,39 +399,32 @@ GstRtspPlayerPrivate__create_video_pad(GstRtspPlayerPrivate * priv){
     gtk_widget_set_no_show_all(priv->canvas, TRUE);
     gtk_container_add (GTK_CONTAINER (priv->canvas_handle), GTK_WIDGET(priv->canvas));
 
-    if (!video_bin ||
-            !vdecoder ||
+    if (!display_pipeline ||
+            !priv->display_src ||
             !videoconvert ||
             !overlay_comp ||
             !priv->sink) {
-        C_ERROR ("One of the video elements wasn't created... Exiting\n");
+        C_ERROR ("One of the display elements wasn't created... Exiting\n");
         return NULL;
     }
 
+    //Caps are set by each pushed sample, so a new camera renegotiates the existing branch
+    g_object_set (G_OBJECT (priv->display_src), "is-live", TRUE, NULL);
+    g_object_set (G_OBJECT (priv->display_src), "format", GST_FORMAT_TIME, NULL);
+
     // Add Elements to the Bin
-    gst_bin_add_many (GST_BIN (video_bin),
-        vdecoder,
+    gst_bin_add_many (GST_BIN (display_pipeline),
+        priv->display_src,
         videoconvert,
         overlay_comp,
         priv->sink, NULL);
 
     // Link confirmation
-    if (!gst_element_link_many (videoconvert,
+    if (!gst_element_link_many (priv->display_src,
+            videoconvert,
             overlay_comp,
             priv->sink, NULL)){
-        C_WARN ("Linking video part (A)-2 Fail...");
-        return NULL;
-    }
-
-    // Dynamic Pad Creation
-    if(! g_signal_connect (vdecoder, "pad-added", G_CALLBACK (on_decoder_pad_added),videoconvert)){
-        C_WARN ("Linking (A)-1 part with part (A)-2 Fail...");
-    }
-
-    pad = gst_element_get_static_pad (vdecoder, "sink");
-    if (!pad) {
-        // TODO gst_object_unref
-        C_ERROR("unable to get decoder static sink pad");
+        C_WARN ("Linking display part Fail...");
         return NULL;
     }
 
@@ -395,6 +442,313 @@ GstRtspPlayerPrivate__create_video_pad(GstRtspPlayerPrivate * priv){
         return NULL;
     }
 
+    /* set up bus */
+    GstBus *bus = gst_element_get_bus (display_pipeline);
+    GSource *source = gst_bus_create_watch (bus);
+    if (!source) {
+        g_critical ("Creating bus watch failed");
+        return NULL;
+    }
+    g_source_set_callback (source, G_SOURCE_FUNC(GstRtspPlayerPrivate__display_message_handler), priv, NULL);
+    g_source_attach (source, priv->player_context);
+    g_source_unref (source);
+    gst_bus_set_sync_handler (bus, (GstBusSyncHandler) GstRtspPlayerPrivate__sync_handler, priv, NULL);
+    gst_object_unref (bus);
+
+    return display_pipeline;
+}
+
+typedef struct {
+    GstSnapshotCallback callback;
+    void * user_data;
+} GstSnapshotRequest;
+
+//Maps the encoded buffer instead of copying it
+static GstSnapshot *
+GstSnapshot__new(GstBuffer * buffer){
+    GstSnapshot * snapshot = malloc(sizeof(GstSnapshot));
+    if (!gst_buffer_map (buffer, &snapshot->map, GST_MAP_READ)) {
+        C_ERROR("GstRtspPlayer Failed to map snapshot data");
+        free(snapshot);
+        return NULL;
+    }
+    snapshot->buffer = gst_buffer_ref(buffer);
+    snapshot->data = snapshot->map.data;
+    snapshot->size = snapshot->map.size;
+    return snapshot;
+}
+
+//Completes each request with its own snapshot of sample, or with NULL when sample is NULL
+static void
+GstRtspPlayerPrivate__complete_snapshots(GstRtspPlayerPrivate * priv, GList * requests, GstSample * sample){
+    GList * node_itr = requests;
+    while (node_itr != NULL){
+        GstSnapshotRequest * request = (GstSnapshotRequest *) node_itr->data;
+        GstSnapshot * snapshot = NULL;
+        if(sample){
+            snapshot = GstSnapshot__new(gst_sample_get_buffer(sample));
+        }
+        request->callback(priv->owner, snapshot, request->user_data);
+        free(request);
+        node_itr = g_list_next(node_itr);
+    }
+    g_list_free(requests);
+}
+
+//Fails the frames being encoded, along with their requests
+static void
+GstRtspPlayerPrivate__fail_snapshot_batches(GstRtspPlayerPrivate * priv){
+    GList * requests;
+    g_mutex_lock(&priv->snapshot_lock);
+    GQueue * batches = priv->snapshot_batches;
+    priv->snapshot_batches = g_queue_new();
+    g_mutex_unlock(&priv->snapshot_lock);
+
+    while((requests = g_queue_pop_head(batches))){
+        GstRtspPlayerPrivate__complete_snapshots(priv, requests, NULL);
+    }
+    g_queue_free(batches);
+}
+
+//Requests waiting for a frame fail once the stream stops, since it won't produce any
+static void
+GstRtspPlayerPrivate__fail_snapshot_requests(GstRtspPlayerPrivate * priv){
+    g_mutex_lock(&priv->snapshot_lock);
+    GList * requests = priv->snapshot_requests;
+    priv->snapshot_requests = NULL;
+    g_mutex_unlock(&priv->snapshot_lock);
+    GstRtspPlayerPrivate__complete_snapshots(priv, requests, NULL);
+}
+
+//Called under player_lock wherever playback gives up, so no snapshot request is left waiting
+static void
+GstRtspPlayerPrivate__clear_playing(GstRtspPlayerPrivate * priv){
+    priv->playing = 0;
+    GstRtspPlayerPrivate__fail_snapshot_requests(priv);
+}
+
+/*
+ * Hands the decoded frame to the snapshot encoder when a snapshot is requested.
+ * The sample is shared, not copied. Only the queueing is done on the streaming thread.
+ */
+static void
+GstRtspPlayerPrivate__snapshot_frame(GstRtspPlayerPrivate * priv, GstSample * sample){
+    GstFlowReturn ret = GST_FLOW_OK;
+    if(!g_atomic_pointer_get(&priv->snapshot_requests)){
+        return;
+    }
+
+    g_mutex_lock(&priv->snapshot_lock);
+    GList * requests = priv->snapshot_requests;
+    priv->snapshot_requests = NULL;
+    if(requests){
+        g_queue_push_tail(priv->snapshot_batches, requests);
+        //appsrc only queues the sample, so the encoder never runs under the lock
+        g_signal_emit_by_name (priv->snapshot_src, "push-sample", sample, &ret);
+        if(ret != GST_FLOW_OK){
+            g_queue_pop_tail(priv->snapshot_batches);
+        }
+    }
+    g_mutex_unlock(&priv->snapshot_lock);
+
+    if(requests && ret != GST_FLOW_OK){
+        C_ERROR("Snapshot encoder refused frame : %s",gst_flow_get_name(ret));
+        GstRtspPlayerPrivate__complete_snapshots(priv, requests, NULL);
+    }
+}
+
+//Called on the encoder streaming thread. Frames come out in the order they were pushed.
+static GstFlowReturn
+GstRtspPlayerPrivate__snapshot_encoded (GstElement * appsink, GstRtspPlayerPrivate * priv){
+    GstSample *sample = NULL;
+
+    g_signal_emit_by_name (appsink, "pull-sample", &sample);
+    if (!sample)
+        return GST_FLOW_OK;
+
+    g_mutex_lock(&priv->snapshot_lock);
+    GList * requests = g_queue_pop_head(priv->snapshot_batches);
+    g_mutex_unlock(&priv->snapshot_lock);
+
+    GstRtspPlayerPrivate__complete_snapshots(priv, requests, sample);
+    gst_sample_unref (sample);
+    return GST_FLOW_OK;
+}
+
+static gboolean
+GstRtspPlayerPrivate__snapshot_message_handler (GstBus * bus, GstMessage * message, GstRtspPlayerPrivate * priv){
+    GError *err = NULL;
+    gchar *dbg_info = NULL;
+    if(GST_MESSAGE_TYPE(message) != GST_MESSAGE_ERROR){
+        return TRUE;
+    }
+
+    gst_message_parse_error (message, &err, &dbg_info);
+    C_ERROR ("Snapshot encoder error from element %s: %s", GST_OBJECT_NAME (message->src), err->message);
+    g_error_free (err);
+    g_free (dbg_info);
+
+    //Restarted with clean state, since a failed encoder doesn't produce anything anymore
+    gst_element_set_state (priv->snapshot_pipeline, GST_STATE_NULL);
+    GstRtspPlayerPrivate__fail_snapshot_batches(priv);
+    gst_element_set_state (priv->snapshot_pipeline, GST_STATE_PLAYING);
+    return TRUE;
+}
+
+/*
+ * Encoder reused by every snapshot. It runs on its own streaming thread,
+ * so neither the camera pipeline nor player_lock wait for the encoding.
+ */
+static GstElement*
+GstRtspPlayerPrivate__create_snapshot_pipeline(GstRtspPlayerPrivate * priv){
+    GstElement *snapshot_pipeline, *videoconvert, *videoscale, *capsfilter, *encoder, *sink;
+
+    snapshot_pipeline = gst_pipeline_new ("snapshot-pipeline");
+    priv->snapshot_src = gst_element_factory_make ("appsrc", "snapshot_src");
+    videoconvert = gst_element_factory_make ("videoconvert", NULL);
+    videoscale = gst_element_factory_make ("videoscale", NULL);
+    capsfilter = gst_element_factory_make ("capsfilter", NULL);
+    encoder = gst_element_factory_make ("jpegenc", NULL);
+    sink = gst_element_factory_make ("appsink", "snapshot_sink");
+
+    if (!snapshot_pipeline ||
+            !priv->snapshot_src ||
+            !videoconvert ||
+            !videoscale ||
+            !capsfilter ||
+            !encoder ||
+            !sink) {
+        C_ERROR ("One of the snapshot elements wasn't created...\n");
+        return NULL;
+    }
+
+    GstCaps * caps = gst_caps_from_string ("video/x-raw,width=" G_STRINGIFY(GST_RTSP_PLAYER_SNAPSHOT_WIDTH) ",height=" G_STRINGIFY(GST_RTSP_PLAYER_SNAPSHOT_HEIGHT));
+    g_object_set (G_OBJECT (capsfilter), "caps", caps, NULL);
+    gst_caps_unref (caps);
+    //Live, so the encoder never waits for a preroll frame
+    g_object_set (G_OBJECT (priv->snapshot_src), "is-live", TRUE, "format", GST_FORMAT_TIME, NULL);
+    g_object_set (G_OBJECT (sink), "emit-signals", TRUE, "sync", FALSE, NULL);
+    g_signal_connect (sink, "new-sample", G_CALLBACK (GstRtspPlayerPrivate__snapshot_encoded), priv);
+
+    gst_bin_add_many (GST_BIN (snapshot_pipeline),
+        priv->snapshot_src,
+        videoconvert,
+        videoscale,
+        capsfilter,
+        encoder,
+        sink, NULL);
+
+    if (!gst_element_link_many (priv->snapshot_src,
+            videoconvert,
+            videoscale,
+            capsfilter,
+            encoder,
+            sink, NULL)){
+        C_WARN ("Linking snapshot part Fail...");
+        return NULL;
+    }
+
+    GstBus *bus = gst_element_get_bus (snapshot_pipeline);
+    GSource *source = gst_bus_create_watch (bus);
+    if (!source) {
+        g_critical ("Creating bus watch failed");
+        return NULL;
+    }
+    g_source_set_callback (source, G_SOURCE_FUNC(GstRtspPlayerPrivate__snapshot_message_handler), priv, NULL);
+    g_source_attach (source, priv->player_context);
+    g_source_unref (source);
+    gst_bus_set_sync_handler (bus, (GstBusSyncHandler) GstRtspPlayerPrivate__sync_handler, priv, NULL);
+    gst_object_unref (bus);
+
+    if(gst_element_set_state (snapshot_pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE){
+        C_ERROR ("Unable to set the snapshot pipeline to the playing state.");
+    }
+
+    return snapshot_pipeline;
+}
+
+/*
+ * Hands decoded frames over to the display pipeline.
+ * Called from the camera streaming thread, which is stopped before the session changes.
+ */
+static GstFlowReturn
+GstRtspPlayerPrivate__handoff_sample (GstElement * appsink, GstRtspPlayerPrivate * priv){
+    GstSample *sample = NULL;
+    GstFlowReturn ret = GST_FLOW_OK;
+
+    g_signal_emit_by_name (appsink, "pull-sample", &sample);
+    if (!sample)
+        return GST_FLOW_OK;
+
+    g_signal_emit_by_name (priv->display_src, "push-sample", sample, &ret);
+    GstRtspPlayerPrivate__snapshot_frame(priv, sample);
+    //Action signal callbacks don't take ownership of the sample
+    gst_sample_unref (sample);
+    if(ret != GST_FLOW_OK){
+        C_TRACE("Display pipeline refused frame : %s",gst_flow_get_name(ret));
+    }
+
+    if(!priv->displaying){
+        //Shown on the first frame, so the previous camera's last frame never flashes back
+        priv->displaying = 1;
+        C_INFO("%s First frame displayed after %" G_GINT64_FORMAT " ms",priv->session->location,
+                (g_get_monotonic_time() - priv->session->play_time) / 1000);
+        g_main_context_invoke(g_main_context_default(),G_SOURCE_FUNC(GstRtspPlayerPrivate__idle_update_canvas),priv);
+    }
+
+    //Display failures are reported on the display bus, without stopping the camera stream
+    return GST_FLOW_OK;
+}
+
+static GstElement*
+GstRtspPlayerPrivate__create_video_pad(GstRtspPlayerPrivate * priv){
+    GstElement *vdecoder, *handoff, *video_bin;
+    GstPad *pad, *ghostpad;
+
+    video_bin = gst_bin_new("video_bin");
+    vdecoder = gst_element_factory_make ("decodebin", "video_decodebin");
+    if (!vdecoder) {
+        C_WARN("decodebin not available, trying decodebin3");
+        vdecoder = gst_element_factory_make ("decodebin3", "video_decodebin");
+    }
+    if (!vdecoder) {
+        C_WARN("Neither decodebin nor decodebin3 available, trying uridecodebin");
+        vdecoder = gst_element_factory_make ("uridecodebin", "video_decodebin");
+    }
+    handoff = gst_element_factory_make ("appsink", "video_handoff");
+
+    if (!video_bin ||
+            !vdecoder ||
+            !handoff) {
+        C_ERROR ("One of the video elements wasn't created... Exiting\n");
+        return NULL;
+    }
+
+    //Synced against the camera pipeline clock. Late frames are dropped instead of queued behind the display.
+    g_object_set (G_OBJECT (handoff), "emit-signals", TRUE, "sync", TRUE, "drop", TRUE, "max-buffers", 1, NULL);
+    //Frames cross into the display pipeline, so hardware decoders must download to system memory
+    GstCaps * raw_caps = gst_caps_from_string ("video/x-raw");
+    g_object_set (G_OBJECT (handoff), "caps", raw_caps, NULL);
+    gst_caps_unref (raw_caps);
+    g_signal_connect (handoff, "new-sample", G_CALLBACK (GstRtspPlayerPrivate__handoff_sample), priv);
+
+    // Add Elements to the Bin
+    gst_bin_add_many (GST_BIN (video_bin),
+        vdecoder,
+        handoff, NULL);
+
+    // Dynamic Pad Creation
+    if(! g_signal_connect (vdecoder, "pad-added", G_CALLBACK (on_decoder_pad_added),handoff)){
+        C_WARN ("Linking (A)-1 part with part (A)-2 Fail...");
+    }
+
+    pad = gst_element_get_static_pad (vdecoder, "sink");
+    if (!pad) {
+        // TODO gst_object_unref
+        C_ERROR("unable to get decoder static sink pad");
+        return NULL;
+    }
+
     ghostpad = gst_ghost_pad_new ("bin_sink", pad);
     gst_element_add_pad (video_bin, ghostpad);
     gst_object_unref (pad);
@@ -478,6 +832,16 @@ gboolean GstRtspPlayerSession__idle_attach_video_pad(void * user_data){
     struct create_video_data * data = (struct create_video_data *) user_data;
     GstPad *sink_pad;
     GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (data->session->player);
+
+    //Started once with the first stream, so that the canvas is realized. Switching cameras leaves it PLAYING.
+    if(!priv->display_started){
+        if(gst_element_set_state (priv->display_pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE){
+            C_ERROR ("%s Unable to set the display pipeline to the playing state.", data->session->location);
+        } else {
+            priv->display_started = 1;
+        }
+    }
+
     gst_bin_add_many (GST_BIN (data->session->pipeline), priv->video_bin, NULL);
 
     C_TRACE("%s GstRtspPlayerSession__idle_attach_video_pad", data->session->location);
@@ -500,9 +864,7 @@ exit:
 }
 
 static void
-GstRtspPlayerSession__on_rtsp_pad_added (GstElement *element, GstPad *new_pad, GstRtspPlayerSession * session){
-    C_DEBUG ("%s Received new pad '%s' from '%s'", session->location, GST_PAD_NAME (new_pad), GST_ELEMENT_NAME (element));
-    
+GstRtspPlayerSession__attach_pad (GstRtspPlayerSession * session, GstElement *element, GstPad *new_pad){
     GstPadLinkReturn pad_ret;
     GstPad *sink_pad = NULL;
     GstCaps *new_pad_caps = NULL;
@@ -568,6 +930,45 @@ exit:
         gst_object_unref (sink_pad);
 }
 
+static void
+GstRtspPlayerSession__on_rtsp_pad_added (GstElement *element, GstPad *new_pad, GstRtspPlayerSession * session){
+    C_DEBUG ("%s Received new pad '%s' from '%s'", session->location, GST_PAD_NAME (new_pad), GST_ELEMENT_NAME (element));
+
+    //The reusable bins belong to the playing session. Pads of a speculative session wait until it's played.
+    if(session->speculative){
+        GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (session->player);
+        g_mutex_lock(&priv->preconnect_lock);
+        if(session->speculative){
+            session->pending_pads = g_list_append(session->pending_pads, gst_object_ref(new_pad));
+            g_mutex_unlock(&priv->preconnect_lock);
+            return;
+        }
+        g_mutex_unlock(&priv->preconnect_lock);
+    }
+
+    GstRtspPlayerSession__attach_pad(session, element, new_pad);
+}
+
+//The backchannel is shared with the playing stream, so a speculative session only records its stream
+static gboolean
+GstRtspPlayerSession__select_stream (GstElement * rtspsrc, guint idx, GstCaps * caps, GstRtspPlayerSession * session){
+    GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (session->player);
+    g_mutex_lock(&priv->preconnect_lock);
+    if(session->speculative){
+        if(gst_structure_has_field (gst_caps_get_structure (caps, 0), "a-sendonly")){
+            if(session->back_caps){
+                gst_caps_unref(session->back_caps);
+            }
+            session->back_caps = gst_caps_ref(caps);
+            session->back_idx = idx;
+        }
+        g_mutex_unlock(&priv->preconnect_lock);
+        return TRUE;
+    }
+    g_mutex_unlock(&priv->preconnect_lock);
+    return RtspBackchannel__find(rtspsrc, idx, caps, priv->backchannel);
+}
+
 static GstRtspPlayerSession *
 GstRtspPlayerSession__setup_pipeline (GstRtspPlayerSession * session)
 {
@@ -596,7 +997,7 @@ GstRtspPlayerSession__setup_pipeline (GstRtspPlayerSession * session)
     }
 
     GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (session->player);
-    if(!g_signal_connect (session->src, "select-stream", G_CALLBACK (RtspBackchannel__find),priv->backchannel)){
+    if(!g_signal_connect (session->src, "select-stream", G_CALLBACK (GstRtspPlayerSession__select_stream),session)){
         C_ERROR ("%s Fail to connect select-stream signal...", session->location);
     }
 
@@ -628,18 +1029,23 @@ GstRtspPlayerSession__setup_pipeline (GstRtspPlayerSession * session)
     }
 
     g_source_unref (source);
+    //Streaming threads announce themselves synchronously, from the thread itself
+    gst_bus_set_sync_handler (bus, (GstBusSyncHandler) GstRtspPlayerSession__sync_handler, session, NULL);
     gst_object_unref (bus);
 
     return session;
 }
 
-gboolean GstRtspPlayerPrivate__idle_hide(GtkWidget * widget){
-    gtk_widget_hide(widget);
-    return FALSE;
-}
-
-gboolean GstRtspPlayerPrivate__idle_show(GtkWidget * widget){
-    gtk_widget_show(widget);
+//Reads displaying when dispatched, so a hide queued late by a state change can't override the first frame
+gboolean GstRtspPlayerPrivate__idle_update_canvas(GstRtspPlayerPrivate * priv){
+    if(!GTK_IS_WIDGET(priv->canvas)){
+        return FALSE;
+    }
+    if(priv->displaying){
+        gtk_widget_show(priv->canvas);
+    } else {
+        gtk_widget_hide(priv->canvas);
+    }
     return FALSE;
 }
 
@@ -651,10 +1057,6 @@ gboolean GstRtspPlayerPrivate__stop_unlocked(GstRtspPlayerPrivate * priv){
         return FALSE;
     }
 
-    //New pipeline causes previous pipe to stop dispatching state change.
-    //Force hide the previous stream
-    g_main_context_invoke(g_main_context_default(),G_SOURCE_FUNC(GstRtspPlayerPrivate__idle_hide),priv->canvas);
-
     //Pause backchannel
     if(!RtspBackchannel__pause(priv->backchannel)){
         C_WARN("Failed to pause backchannel.");
@@ -668,6 +1070,13 @@ gboolean GstRtspPlayerPrivate__stop_unlocked(GstRtspPlayerPrivate * priv){
         }
     }
 
+    GstRtspPlayerPrivate__fail_snapshot_requests(priv);
+
+    //New pipeline causes previous pipe to stop dispatching state change.
+    //Force hide the previous stream once its streaming threads are stopped, so no late frame shows it again
+    priv->displaying = 0;
+    g_main_context_invoke(g_main_context_default(),G_SOURCE_FUNC(GstRtspPlayerPrivate__idle_update_canvas),priv);
+
     //Destroy old pipeline
     if(GST_IS_ELEMENT(priv->session->pipeline)){
         gst_object_unref (priv->session->pipeline);
@@ -684,7 +1093,7 @@ gboolean GstRtspPlayerPrivate__stop_unlocked(GstRtspPlayerPrivate * priv){
 void GstRtspPlayerPrivate__stop(GstRtspPlayerPrivate * priv){
     C_DEBUG("GstRtspPlayerPrivate__stop\n");
     P_MUTEX_LOCK(priv->player_lock);
-    priv->playing = 0;
+    GstRtspPlayerPrivate__clear_playing(priv);
 
     if(GstRtspPlayerPrivate__stop_unlocked(priv))
         player_signal_and_wait (priv->owner, signals[STOPPED]);
@@ -701,6 +1110,35 @@ void GstRtspPlayer__stop(GstRtspPlayer* self){
     GstRtspPlayerPrivate__stop(priv);
 }
 
+static void GstRtspPlayerSession__set_location(GstRtspPlayerSession * session){
+    if(session->user)
+        g_object_set (G_OBJECT (session->src), "user-id", session->user, NULL);
+    if(session->pass)
+        g_object_set (G_OBJECT (session->src), "user-pw", session->pass, NULL);
+    if(session->location)
+        g_object_set (G_OBJECT (session->src), "location", session->location, NULL);
+}
+
+//Binds what a speculative session received before it was played
+static void GstRtspPlayerSession__bind_preconnected(GstRtspPlayerSession * session){
+    GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (session->player);
+    GList * pads = session->pending_pads;
+    session->pending_pads = NULL;
+
+    if(session->back_caps){
+        RtspBackchannel__find(session->src, session->back_idx, session->back_caps, priv->backchannel);
+        gst_caps_unref(session->back_caps);
+        session->back_caps = NULL;
+    }
+
+    GList * node_itr = pads;
+    while (node_itr != NULL){
+        GstRtspPlayerSession__attach_pad(session, session->src, GST_PAD(node_itr->data));
+        node_itr = g_list_next(node_itr);
+    }
+    g_list_free_full(pads, gst_object_unref);
+}
+
 void GstRtspPlayerSession__play(GstRtspPlayerSession * session){
     GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (session->player);
     P_MUTEX_LOCK(priv->player_lock);
@@ -709,17 +1147,18 @@ void GstRtspPlayerSession__play(GstRtspPlayerSession * session){
         GstRtspPlayerSession__destroy(priv->session);
         priv->session = session;
     }
-    GstRtspPlayerSession__setup_pipeline(session);
 
-    if(session->user)
-        g_object_set (G_OBJECT (session->src), "user-id", session->user, NULL);
-    if(session->pass)
-        g_object_set (G_OBJECT (session->src), "user-pw", session->pass, NULL);
-    if(session->location)
-        g_object_set (G_OBJECT (session->src), "location", session->location, NULL);
+    //A stopped session's pipeline is released, so only a pre-connected session still has one
+    if(GST_IS_ELEMENT(session->pipeline)){
+        GstRtspPlayerSession__bind_preconnected(session);
+    } else {
+        GstRtspPlayerSession__setup_pipeline(session);
+        GstRtspPlayerSession__set_location(session);
+    }
 
     C_DEBUG("%s RtspPlayer__play retry[%i] - playing[%i]",session->location,session->retry,priv->playing);
     priv->playing = 1;
+    session->play_time = g_get_monotonic_time();
 
     GstStateChangeReturn ret;
     ret = gst_element_set_state (session->pipeline, GST_STATE_PLAYING);
@@ -739,6 +1178,203 @@ void GstRtspPlayer__play(GstRtspPlayer* self, char *url, char * user, char * pas
     GstRtspPlayerSession__play(session);
 }
 
+static gboolean
+GstRtspPlayerSession__idle_discard(GstRtspPlayerSession * session){
+    C_DEBUG("%s Discarding pre-connected session", session->location);
+    if(GST_IS_ELEMENT(session->pipeline)){
+        GstBus *bus = gst_element_get_bus (session->pipeline);
+        //Sends TEARDOWN
+        gst_element_set_state (session->pipeline, GST_STATE_NULL);
+        //Drops pending messages, so the bus watch never dispatches the destroyed session
+        gst_bus_set_flushing (bus, TRUE);
+        gst_object_unref (bus);
+    }
+    GstRtspPlayerSession__destroy(session);
+    return FALSE;
+}
+
+/*
+ * Discarded sessions are destroyed on the player loop, which dispatches their bus messages.
+ * The sessions must already be out of priv->preconnects.
+ */
+static void
+GstRtspPlayerPrivate__discard_preconnects(GstRtspPlayerPrivate * priv, GList * sessions){
+    GList * node_itr = sessions;
+    while (node_itr != NULL){
+        g_main_context_invoke(priv->player_context,G_SOURCE_FUNC(GstRtspPlayerSession__idle_discard),node_itr->data);
+        node_itr = g_list_next(node_itr);
+    }
+    g_list_free(sessions);
+}
+
+static void
+GstRtspPlayerPrivate__discard_preconnect(GstRtspPlayerPrivate * priv, GstRtspPlayerSession * session){
+    GList * discarded = NULL;
+    g_mutex_lock(&priv->preconnect_lock);
+    GList * node = g_list_find(priv->preconnects, session);
+    if(node){
+        priv->preconnects = g_list_remove_link(priv->preconnects, node);
+        discarded = node;
+    }
+    g_mutex_unlock(&priv->preconnect_lock);
+    GstRtspPlayerPrivate__discard_preconnects(priv, discarded);
+}
+
+//Servers drop sessions left without keep-alive, so pre-connections expire well before that
+static void
+GstRtspPlayerPrivate__prune_preconnects(GstRtspPlayerPrivate * priv){
+    GList * expired = NULL;
+    gint64 now = g_get_monotonic_time();
+    g_mutex_lock(&priv->preconnect_lock);
+    GList * node_itr = priv->preconnects;
+    while (node_itr != NULL){
+        GList * next = g_list_next(node_itr);
+        GstRtspPlayerSession * session = (GstRtspPlayerSession *) node_itr->data;
+        if(now - session->preconnect_time >= (gint64) GST_RTSP_PLAYER_PRECONNECT_TTL * 1000){
+            priv->preconnects = g_list_remove_link(priv->preconnects, node_itr);
+            expired = g_list_concat(expired, node_itr);
+        }
+        node_itr = next;
+    }
+    g_mutex_unlock(&priv->preconnect_lock);
+    GstRtspPlayerPrivate__discard_preconnects(priv, expired);
+}
+
+static gboolean
+GstRtspPlayerPrivate__timeout_prune(GstRtspPlayerPrivate * priv){
+    GstRtspPlayerPrivate__prune_preconnects(priv);
+    return FALSE;
+}
+
+static GstRtspPlayerSession *
+GstRtspPlayerPrivate__find_preconnect(GstRtspPlayerPrivate * priv, void * user_data){
+    GList * node_itr = priv->preconnects;
+    while (node_itr != NULL){
+        GstRtspPlayerSession * session = (GstRtspPlayerSession *) node_itr->data;
+        if(session->user_data == user_data){
+            return session;
+        }
+        node_itr = g_list_next(node_itr);
+    }
+    return NULL;
+}
+
+void GstRtspPlayer__preconnect(GstRtspPlayer* self, char *url, char * user, char * pass, char * fallback_host, char * fallback_port, int profile, void * user_data){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (GST_IS_RTSPPLAYER (self));
+    g_return_if_fail (url != NULL);
+
+    GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (self);
+    GList * discarded = NULL;
+    GstRtspPlayerPrivate__prune_preconnects(priv);
+
+    g_mutex_lock(&priv->preconnect_lock);
+    GstRtspPlayerSession * existing = GstRtspPlayerPrivate__find_preconnect(priv, user_data);
+    int connected = existing && existing->profile == profile && !strcmp(existing->location_set, url);
+    g_mutex_unlock(&priv->preconnect_lock);
+    if(connected){
+        return;
+    }
+
+    GstRtspPlayerSession * session = GstRtspPlayerSession__create(self, url, user, pass, fallback_host, fallback_port, user_data);
+    session->speculative = 1;
+    session->preconnect_time = g_get_monotonic_time();
+    session->profile = profile;
+    if(!GstRtspPlayerSession__setup_pipeline(session)){
+        GstRtspPlayerSession__destroy(session);
+        return;
+    }
+    GstRtspPlayerSession__set_location(session);
+
+    //rtspsrc sends OPTIONS, DESCRIBE and SETUP going to PAUSED, and PLAY going to PLAYING
+    C_DEBUG("%s Pre-connecting", session->location);
+    if(gst_element_set_state (session->pipeline, GST_STATE_PAUSED) == GST_STATE_CHANGE_FAILURE){
+        C_WARN("%s Unable to pre-connect.", session->location);
+        g_main_context_invoke(priv->player_context,G_SOURCE_FUNC(GstRtspPlayerSession__idle_discard),session);
+        return;
+    }
+
+    //Replaces a previous connection to the same stream, and evicts the oldest beyond the limit
+    g_mutex_lock(&priv->preconnect_lock);
+    existing = GstRtspPlayerPrivate__find_preconnect(priv, user_data);
+    if(existing){
+        priv->preconnects = g_list_remove(priv->preconnects, existing);
+        discarded = g_list_append(discarded, existing);
+    }
+    priv->preconnects = g_list_append(priv->preconnects, session);
+    while(g_list_length(priv->preconnects) > GST_RTSP_PLAYER_PRECONNECT_MAX){
+        GList * oldest = priv->preconnects;
+        priv->preconnects = g_list_remove_link(priv->preconnects, oldest);
+        discarded = g_list_concat(discarded, oldest);
+    }
+    g_mutex_unlock(&priv->preconnect_lock);
+    GstRtspPlayerPrivate__discard_preconnects(priv, discarded);
+
+    GSource * source = g_timeout_source_new (GST_RTSP_PLAYER_PRECONNECT_TTL);
+    g_source_set_callback (source, G_SOURCE_FUNC(GstRtspPlayerPrivate__timeout_prune), priv, NULL);
+    g_source_attach (source, priv->player_context);
+    g_source_unref (source);
+}
+
+gboolean GstRtspPlayer__is_preconnected(GstRtspPlayer* self, int profile, void * user_data){
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (GST_IS_RTSPPLAYER (self), FALSE);
+
+    GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (self);
+    GstRtspPlayerPrivate__prune_preconnects(priv);
+
+    g_mutex_lock(&priv->preconnect_lock);
+    GstRtspPlayerSession * session = GstRtspPlayerPrivate__find_preconnect(priv, user_data);
+    gboolean ret = session && session->profile == profile;
+    g_mutex_unlock(&priv->preconnect_lock);
+    return ret;
+}
+
+gboolean GstRtspPlayer__play_preconnected(GstRtspPlayer* self, int profile, void * user_data){
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (GST_IS_RTSPPLAYER (self), FALSE);
+
+    GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (self);
+    GstRtspPlayerPrivate__prune_preconnects(priv);
+
+    GList * stale = NULL;
+    g_mutex_lock(&priv->preconnect_lock);
+    GstRtspPlayerSession * session = GstRtspPlayerPrivate__find_preconnect(priv, user_data);
+    if(session){
+        priv->preconnects = g_list_remove(priv->preconnects, session);
+        //Resolved for a profile since replaced
+        if(session->profile != profile){
+            stale = g_list_append(stale, session);
+            session = NULL;
+        } else {
+            session->speculative = 0;
+        }
+    }
+    g_mutex_unlock(&priv->preconnect_lock);
+    GstRtspPlayerPrivate__discard_preconnects(priv, stale);
+
+    if(!session){
+        return FALSE;
+    }
+
+    C_INFO("%s Playing pre-connected session", session->location);
+    GstRtspPlayerSession__play(session);
+    return TRUE;
+}
+
+void GstRtspPlayer__discard_preconnected(GstRtspPlayer* self, void * user_data){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (GST_IS_RTSPPLAYER (self));
+
+    GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (self);
+    g_mutex_lock(&priv->preconnect_lock);
+    GstRtspPlayerSession * session = GstRtspPlayerPrivate__find_preconnect(priv, user_data);
+    g_mutex_unlock(&priv->preconnect_lock);
+    if(session){
+        GstRtspPlayerPrivate__discard_preconnect(priv, session);
+    }
+}
+
 /*
 Compared to play, retry is design to work after a stream failure.
 Stopping will essentially break the retry method and stop the loop.
@@ -885,7 +1521,7 @@ GstRtspPlayerSession__error_msg (GstRtspPlayerSession * session, GstBus *bus, Gs
         case GST_RESOURCE_ERROR_NOT_AUTHORIZED:
         case GST_RESOURCE_ERROR_NOT_FOUND:
             C_ERROR("%s Non-recoverable error encountered.", session->location);
-            priv->playing = 0;
+            GstRtspPlayerPrivate__clear_playing(priv);
             __attribute__ ((fallthrough));
         default:
             C_ERROR ("%s Error received from element %s: %s",session->location, GST_OBJECT_NAME (msg->src), err->message);
@@ -911,7 +1547,7 @@ GstRtspPlayerSession__error_msg (GstRtspPlayerSession * session, GstBus *bus, Gs
         return;
     } else if(priv->playing == 1) {
         C_TRACE("%s Player giving up. Too many retries...", session->location);
-        priv->playing = 0;
+        GstRtspPlayerPrivate__clear_playing(priv);
         GstRtspPlayerPrivate__stop_unlocked(priv);
         P_MUTEX_UNLOCK(priv->player_lock);
         //Error signal
@@ -976,9 +1612,10 @@ GstRtspPlayerSession__state_changed_msg (GstRtspPlayerSession * session, GstBus
     }
 
     if(GstRtspPlayerSession__is_video_bin(element) && new_state != GST_STATE_PLAYING && GTK_IS_WIDGET (priv->canvas)){
-        g_main_context_invoke(g_main_context_default(),G_SOURCE_FUNC(GstRtspPlayerPrivate__idle_hide),priv->canvas);
+        g_main_context_invoke(g_main_context_default(),G_SOURCE_FUNC(GstRtspPlayerPrivate__idle_update_canvas),priv);
     } else if(GstRtspPlayerSession__is_video_bin(element) && new_state == GST_STATE_PLAYING && GTK_IS_WIDGET (priv->canvas)){
-        g_main_context_invoke(g_main_context_default(),G_SOURCE_FUNC(GstRtspPlayerPrivate__idle_show),priv->canvas);
+        //The canvas is shown by the first handed off frame
+        C_INFO("%s Stream started after %" G_GINT64_FORMAT " ms", session->location, (g_get_monotonic_time() - session->play_time) / 1000);
 
         /*
         * Waiting for fix https://gitlab.freedesktop.org/gstreamer/gst-plugins-good/-/issues/245
@@ -997,12 +1634,51 @@ GstRtspPlayerSession__state_changed_msg (GstRtspPlayerSession * session, GstBus
 }
 
 
+//A failing speculative session is discarded, without the retry and fallback of the playing session
+static gboolean
+GstRtspPlayerSession__preconnect_msg (GstRtspPlayerSession * session, GstMessage * message){
+    GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (session->player);
+    GError *err = NULL;
+    gchar *dbg_info = NULL;
+
+    g_mutex_lock(&priv->preconnect_lock);
+    int speculative = session->speculative;
+    g_mutex_unlock(&priv->preconnect_lock);
+    if(!speculative){
+        return FALSE;
+    }
+
+    switch(GST_MESSAGE_TYPE(message)){
+        case GST_MESSAGE_ERROR:
+            gst_message_parse_error (message, &err, &dbg_info);
+            C_WARN ("%s Pre-connect failed : %s", session->location, err->message);
+            g_error_free (err);
+            g_free (dbg_info);
+            GstRtspPlayerPrivate__discard_preconnect(priv, session);
+            break;
+        case GST_MESSAGE_EOS:
+            GstRtspPlayerPrivate__discard_preconnect(priv, session);
+            break;
+        case GST_MESSAGE_ELEMENT:
+            if (strcmp (gst_structure_get_name (gst_message_get_structure (message)), "GstRTSPSrcTimeout") == 0){
+                GstRtspPlayerPrivate__discard_preconnect(priv, session);
+            }
+            break;
+        default:
+            break;
+    }
+    return TRUE;
+}
+
 static gboolean 
 GstRtspPlayerSession__message_handler (GstBus * bus, GstMessage * message, GstRtspPlayerSession * session)
 { 
     GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (session->player);
     const GstStructure *s;
     const gchar *name;
+    if(GstRtspPlayerSession__preconnect_msg(session, message)){
+        return TRUE;
+    }
     switch(GST_MESSAGE_TYPE(message)){
         case GST_MESSAGE_UNKNOWN:
             C_TRACE("%s msg : GST_MESSAGE_UNKNOWN\n", session->location);
@@ -1143,11 +1819,82 @@ GstRtspPlayerSession__message_handler (GstBus * bus, GstMessage * message, GstRt
     return TRUE;
 }
 
+static void
+GstRtspPlayerPrivate__apply_sched(GstRtspPlayerPrivate * priv){
+    ThreadSched sched;
+    g_mutex_lock(&priv->sched_lock);
+    sched = priv->sched;
+    g_mutex_unlock(&priv->sched_lock);
+    ThreadSched__apply(&sched);
+}
+
+/*
+ * Decoders may start their own threads from the streaming thread (e.g. libav slice threads),
+ * which inherit its scheduling.
+ */
+static GstBusSyncReply
+GstRtspPlayerPrivate__sync_handler (GstBus * bus, GstMessage * message, GstRtspPlayerPrivate * priv){
+    GstStreamStatusType type;
+    GstElement * owner;
+    char name[THREAD_SCHED_NAME_LENGTH];
+    if(GST_MESSAGE_TYPE(message) != GST_MESSAGE_STREAM_STATUS){
+        return GST_BUS_PASS;
+    }
+
+    gst_message_parse_stream_status (message, &type, &owner);
+    if(type == GST_STREAM_STATUS_TYPE_ENTER){
+        gchar * owner_name = gst_element_get_name (owner);
+        g_snprintf(name, sizeof(name), "gst-%s", owner_name);
+        g_free(owner_name);
+        ThreadSched__set_name(name);
+        GstRtspPlayerPrivate__apply_sched(priv);
+    }
+    return GST_BUS_PASS;
+}
+
+static GstBusSyncReply
+GstRtspPlayerSession__sync_handler (GstBus * bus, GstMessage * message, GstRtspPlayerSession * session){
+    GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (session->player);
+    return GstRtspPlayerPrivate__sync_handler(bus, message, priv);
+}
+
+//The display pipeline outlives sessions. Its failures are logged, the camera pipeline handles retries.
+static gboolean
+GstRtspPlayerPrivate__display_message_handler (GstBus * bus, GstMessage * message, GstRtspPlayerPrivate * priv){
+    GError *err = NULL;
+    gchar *dbg_info = NULL;
+    switch(GST_MESSAGE_TYPE(message)){
+        case GST_MESSAGE_ERROR:
+            gst_message_parse_error (message, &err, &dbg_info);
+            C_ERROR ("Display pipeline error from element %s: %s", GST_OBJECT_NAME (message->src), err->message);
+            C_ERROR ("Debugging info: %s", (dbg_info) ? dbg_info : "none");
+            g_error_free (err);
+            g_free (dbg_info);
+            break;
+        case GST_MESSAGE_WARNING:
+            gst_message_parse_warning (message, &err, &dbg_info);
+            C_WARN ("Display pipeline warning from element %s: %s", GST_OBJECT_NAME (message->src), err->message);
+            g_error_free (err);
+            g_free (dbg_info);
+            break;
+        default:
+            break;
+    }
+    return TRUE;
+}
+
+static gboolean
+GstRtspPlayerPrivate__idle_apply_sched(GstRtspPlayerPrivate * priv){
+    GstRtspPlayerPrivate__apply_sched(priv);
+    return FALSE;
+}
+
 void * init_gst_seprate_mainloop(void * event){
     struct GstInitData * data = (struct GstInitData*)event;
     //Keeping location pointer because data won't be value after cond broadcast
     GMainLoop ** loop = data->loop;
     c_log_set_thread_color(ANSI_COLOR_CYAN, P_THREAD_ID);
+    ThreadSched__set_name("gst-loop");
     *data->context = g_main_context_new ();
     *loop = g_main_loop_new (*data->context, FALSE);
 
@@ -1165,6 +1912,13 @@ GstRtspPlayer__init (GstRtspPlayer * self)
 {
     GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (self);
     priv->owner = self;
+    priv->sched = (ThreadSched) THREAD_SCHED_INIT;
+    g_mutex_init(&priv->sched_lock);
+    priv->preconnects = NULL;
+    g_mutex_init(&priv->preconnect_lock);
+    priv->snapshot_requests = NULL;
+    priv->snapshot_batches = g_queue_new();
+    g_mutex_init(&priv->snapshot_lock);
 
     struct GstInitData data;
     data.ready = 0;
@@ -1188,6 +1942,12 @@ GstRtspPlayer__init (GstRtspPlayer * self)
     priv->snapsink = NULL;
     priv->playing = 0;
     priv->sinkcaps = NULL;
+    priv->display_src = NULL;
+    priv->display_started = 0;
+    priv->displaying = 0;
+    priv->display_pipeline = GstRtspPlayerPrivate__create_display_pipeline(priv);
+    priv->snapshot_src = NULL;
+    priv->snapshot_pipeline = GstRtspPlayerPrivate__create_snapshot_pipeline(priv);
     priv->video_bin = GstRtspPlayerPrivate__create_video_pad(priv);
     g_object_ref(priv->video_bin);
     priv->audio_bin = GstRtspPlayerPrivate__create_audio_pad();
@@ -1240,71 +2000,111 @@ void GstRtspPlayer__set_view_mode(GstRtspPlayer * self, GstRtspViewMode mode){
     }
 }
 
-GstSnapshot * GstRtspPlayer__get_snapshot(GstRtspPlayer* self){
-    g_return_val_if_fail (self != NULL,NULL);
-    g_return_val_if_fail (GST_IS_RTSPPLAYER (self),NULL);
+void GstRtspPlayer__set_thread_sched(GstRtspPlayer * self, const ThreadSched * sched){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (GST_IS_RTSPPLAYER (self));
+    g_return_if_fail (sched != NULL);
 
-    GstSnapshot * snap = NULL;
     GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (self);
+    g_mutex_lock(&priv->sched_lock);
+    priv->sched = *sched;
+    g_mutex_unlock(&priv->sched_lock);
 
-    if(!priv->session){
+    //Streaming threads pick it up as they start with the next stream
+    if(priv->player_context){
+        g_main_context_invoke(priv->player_context,G_SOURCE_FUNC(GstRtspPlayerPrivate__idle_apply_sched),priv);
+    }
+}
+
+void GstRtspPlayer__request_snapshot(GstRtspPlayer* self, GstSnapshotCallback callback, void * user_data){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (GST_IS_RTSPPLAYER (self));
+    g_return_if_fail (callback != NULL);
+
+    GstRtspPlayerPrivate *priv = GstRtspPlayer__get_instance_private (self);
+    GstSnapshotRequest * request = malloc(sizeof(GstSnapshotRequest));
+    request->callback = callback;
+    request->user_data = user_data;
+
+    //Stopping sets playing before failing the pending requests under snapshot_lock, so none is left behind
+    g_mutex_lock(&priv->snapshot_lock);
+    int accepted = priv->playing && priv->snapshot_pipeline;
+    if(accepted){
+        priv->snapshot_requests = g_list_append(priv->snapshot_requests, request);
+    }
+    g_mutex_unlock(&priv->snapshot_lock);
+
+    if(!accepted){
         C_TRACE("Nothing to snapshot");
-        goto exit;
+        GstRtspPlayerPrivate__complete_snapshots(priv, g_list_append(NULL, request), NULL);
     }
-    C_TRACE("%s GstRtspPlayer__get_snapshot",priv->session->location);
-    P_MUTEX_LOCK(priv->player_lock);
-    GstState state = GST_STATE_NULL;
-    GstStateChangeReturn ret_1 = gst_element_get_state (priv->sink,&state, NULL, GST_CLOCK_TIME_NONE);
-    if(ret_1 == GST_STATE_CHANGE_SUCCESS && state == GST_STATE_PLAYING){
-        GstSample * last_sample = gst_base_sink_get_last_sample(GST_BASE_SINK_CAST(priv->snapsink));
-        last_sample = gst_base_sink_get_last_sample(GST_BASE_SINK_CAST(priv->snapsink));
-        GstSample * png_sample = NULL;
-
-        if(last_sample){
-            C_WARN("%s Extracted sample.",priv->session->location);
-            GError * error = NULL;
-            GstCaps * out_caps = gst_caps_from_string ("image/jpeg,width=640,height=480");
-            png_sample = gst_video_convert_sample(last_sample, out_caps, GST_CLOCK_TIME_NONE, &error);
-            if(error){
-                if(error->message){
-                    C_ERROR("%s GstRtspPlayer encountered an error extracting snapshot. [%d] %s",priv->session->location , error->code, error->message);
-                } else {
-                    C_ERROR("%s GstRtspPlayer encountered an error extracting snapshot. [%d]",priv->session->location , error->code);
-                }
-            }
-        }
+}
 
-        if(png_sample){
-            GstBuffer * buffer = gst_sample_get_buffer(png_sample);
-            GstMapInfo map_info;
-            memset (&map_info, 0, sizeof (map_info));
+//Shared by the waiting caller and the request, since the request may complete after the wait timed out
+typedef struct {
+    gint refcount;
+    int done;
+    GstSnapshot * snapshot;
+    GMutex lock;
+    GCond cond;
+} GstSnapshotWait;
 
-            if (gst_buffer_map (buffer, &map_info, GST_MAP_READ)) {
-                snap = malloc(sizeof(GstSnapshot));
-                snap->size = map_info.size;
-                snap->data = malloc(snap->size);
-                memcpy (snap->data, map_info.data, snap->size);
-            } else {
-                C_ERROR("%s GstRtspPlayer Failed to extract snapshot sample data",priv->session->location);
-            }
-        }
+static void
+GstSnapshotWait__unref(GstSnapshotWait * wait){
+    if(!g_atomic_int_dec_and_test(&wait->refcount)){
+        return;
+    }
+    GstSnapshot__destroy(wait->snapshot);
+    g_mutex_clear(&wait->lock);
+    g_cond_clear(&wait->cond);
+    free(wait);
+}
 
-        if(last_sample)
-            gst_sample_unref(last_sample);
-        if(png_sample)
-            gst_sample_unref(png_sample);
-    } else {
-        C_ERROR("%s GstRtspPlayer not playing. No snapshot extracted %d - %d",priv->session->location,ret_1,state);
+static void
+GstSnapshotWait__completed(GstRtspPlayer * player, GstSnapshot * snapshot, GstSnapshotWait * wait){
+    g_mutex_lock(&wait->lock);
+    wait->snapshot = snapshot;
+    wait->done = 1;
+    g_cond_broadcast(&wait->cond);
+    g_mutex_unlock(&wait->lock);
+    GstSnapshotWait__unref(wait);
+}
+
+GstSnapshot * GstRtspPlayer__get_snapshot(GstRtspPlayer* self){
+    g_return_val_if_fail (self != NULL,NULL);
+    g_return_val_if_fail (GST_IS_RTSPPLAYER (self),NULL);
+
+    GstSnapshot * snap = NULL;
+    GstSnapshotWait * wait = malloc(sizeof(GstSnapshotWait));
+    wait->refcount = 2;
+    wait->done = 0;
+    wait->snapshot = NULL;
+    g_mutex_init(&wait->lock);
+    g_cond_init(&wait->cond);
+
+    GstRtspPlayer__request_snapshot(self, (GstSnapshotCallback) GstSnapshotWait__completed, wait);
+
+    gint64 end_time = g_get_monotonic_time () + GST_RTSP_PLAYER_SNAPSHOT_TIMEOUT * G_TIME_SPAN_MILLISECOND;
+    g_mutex_lock(&wait->lock);
+    while(!wait->done){
+        if(!g_cond_wait_until(&wait->cond, &wait->lock, end_time)){
+            C_ERROR("GstRtspPlayer no frame to snapshot within %d ms",GST_RTSP_PLAYER_SNAPSHOT_TIMEOUT);
+            break;
+        }
     }
-    P_MUTEX_UNLOCK(priv->player_lock);
-exit:
+    //Taken over, otherwise released with the wait by the late completion
+    snap = wait->snapshot;
+    wait->snapshot = NULL;
+    g_mutex_unlock(&wait->lock);
+    GstSnapshotWait__unref(wait);
     return snap;
 }
 
 void GstSnapshot__destroy(GstSnapshot * snapshot){
     if(!snapshot) return;
 
-    free(snapshot->data);
+    gst_buffer_unmap(snapshot->buffer, &snapshot->map);
+    gst_buffer_unref(snapshot->buffer);
     free(snapshot);   
 }
 
@@ -1322,7 +2122,23 @@ GstRtspPlayer__dispose (GObject *gobject)
         P_THREAD_JOIN(priv->thread_loop);
     }
 
+    //The loop is finished, so no bus message is dispatched to the sessions anymore
+    while(priv->preconnects){
+        GstRtspPlayerSession * preconnect = (GstRtspPlayerSession *) priv->preconnects->data;
+        priv->preconnects = g_list_delete_link(priv->preconnects, priv->preconnects);
+        GstRtspPlayerSession__idle_discard(preconnect);
+    }
+
     if(priv->player_context){
+        //Discards invoked after the loop quit would leak their session. The stream bus is flushed first, so its messages aren't dispatched.
+        if(priv->session && GST_IS_ELEMENT(priv->session->pipeline)){
+            GstBus *bus = gst_element_get_bus (priv->session->pipeline);
+            gst_bus_set_flushing (bus, TRUE);
+            gst_object_unref (bus);
+        }
+        while(g_main_context_pending(priv->player_context)){
+            g_main_context_iteration(priv->player_context, FALSE);
+        }
         g_main_context_unref(priv->player_context);
         priv->player_context = NULL;
     }
@@ -1335,6 +2151,8 @@ GstRtspPlayer__dispose (GObject *gobject)
     RtspBackchannel__destroy(priv->backchannel);
     
     P_MUTEX_CLEANUP(priv->player_lock);
+    g_mutex_clear(&priv->sched_lock);
+    g_mutex_clear(&priv->preconnect_lock);
     //A bug seems to have been introduced where the widget is destroyed while cleaning up gtkglsink and not removed from gtk hierarchy.
     //Removing the widget before destroying gtkglsink seems to be a viable retrocompatible solution without causing leaks in other version
 
@@ -1353,6 +2171,24 @@ GstRtspPlayer__dispose (GObject *gobject)
         priv->canvas = NULL;
     }
     
+    //The encoder is stopped first, so no snapshot completes meanwhile
+    if(priv->snapshot_pipeline){
+        gst_element_set_state (priv->snapshot_pipeline, GST_STATE_NULL);
+        gst_object_unref (priv->snapshot_pipeline);
+        priv->snapshot_pipeline = NULL;
+    }
+    GstRtspPlayerPrivate__fail_snapshot_requests(priv);
+    GstRtspPlayerPrivate__fail_snapshot_batches(priv);
+    g_queue_free(priv->snapshot_batches);
+    priv->snapshot_batches = NULL;
+    g_mutex_clear(&priv->snapshot_lock);
+
+    if(priv->display_pipeline){
+        gst_element_set_state (priv->display_pipeline, GST_STATE_NULL);
+        gst_object_unref (priv->display_pipeline);
+        priv->display_pipeline = NULL;
+    }
+
     if(priv->video_bin){
         g_object_unref(priv->video_bin);
         priv->video_bin = NULL;
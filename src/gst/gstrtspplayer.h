@@ -3,6 +3,7 @@
 
 #include <gtk/gtk.h>
 #include "portable_thread.h"
+#include "../utils/thread_sched.h"
 PUSH_WARNING_IGNORE(-1,-Wpedantic)
 #include <gst/gst.h>
 POP_WARNING_IGNORE(NULL)
@@ -21,13 +22,25 @@ typedef enum {
   GST_RTSP_PLAYER_VIEW_MODE_NATIVE
 } GstRtspViewMode;
 
+#define GST_RTSP_PLAYER_PRECONNECT_MAX 2 //Speculative sessions kept at once. The oldest is evicted.
+#define GST_RTSP_PLAYER_PRECONNECT_TTL 30000 //Milliseconds a speculative session waits to be played
+
+#define GST_RTSP_PLAYER_SNAPSHOT_WIDTH 640
+#define GST_RTSP_PLAYER_SNAPSHOT_HEIGHT 480
+#define GST_RTSP_PLAYER_SNAPSHOT_TIMEOUT 5000 //Milliseconds GstRtspPlayer__get_snapshot waits for a frame
+
+//JPEG image. data maps the encoded buffer until GstSnapshot__destroy.
 typedef struct {
   guint8* data;
   gsize size;
+  GstBuffer * buffer;
+  GstMapInfo map;
 } GstSnapshot;
 
 void GstSnapshot__destroy(GstSnapshot * snapshot);
 
+typedef void (*GstSnapshotCallback) (GstRtspPlayer * player, GstSnapshot * snapshot, void * user_data);
+
 struct _GstRtspPlayer
 {
   GObject parent_instance;
@@ -42,10 +55,29 @@ struct _GstRtspPlayerClass
 GstRtspPlayer * GstRtspPlayer__new ();
 void GstRtspPlayer__play(GstRtspPlayer* self, char *url, char * user, char * pass, char * fallback_host, char * fallback_port, void * user_data);
 void GstRtspPlayer__stop(GstRtspPlayer* self);
+/*
+ * Connects ahead of a likely play, up to RTSP SETUP, and keeps the session paused without streaming.
+ * user_data identifies the stream, as passed to GstRtspPlayer__play. profile is the stream profile the url was resolved for.
+ */
+void GstRtspPlayer__preconnect(GstRtspPlayer* self, char *url, char * user, char * pass, char * fallback_host, char * fallback_port, int profile, void * user_data);
+//Whether user_data has a live pre-connected session of that profile, so a new GstRtspPlayer__preconnect can be skipped
+gboolean GstRtspPlayer__is_preconnected(GstRtspPlayer* self, int profile, void * user_data);
+//Plays the pre-connected session of user_data. FALSE when there is none, or only one of another profile, which is discarded.
+gboolean GstRtspPlayer__play_preconnected(GstRtspPlayer* self, int profile, void * user_data);
+void GstRtspPlayer__discard_preconnected(GstRtspPlayer* self, void * user_data);
 GtkWidget * GstRtspPlayer__createCanvas(GstRtspPlayer *self);
 gboolean GstRtspPlayer__is_mic_mute(GstRtspPlayer* self);
 void GstRtspPlayer__mic_mute(GstRtspPlayer* self, gboolean mute);
 void GstRtspPlayer__set_view_mode(GstRtspPlayer * self, GstRtspViewMode mode);
+//Applied to the player loop thread, and to the streaming threads of the next streams, named "gst-<element>"
+void GstRtspPlayer__set_thread_sched(GstRtspPlayer * self, const ThreadSched * sched);
+/*
+ * Encodes the next decoded frame, and passes it to callback from the encoder thread. The callback owns the snapshot.
+ * The snapshot is NULL when nothing is playing, or when the stream stops before producing a frame, in which case
+ * the callback runs on the requesting or stopping thread.
+ */
+void GstRtspPlayer__request_snapshot(GstRtspPlayer* self, GstSnapshotCallback callback, void * user_data);
+//Blocking variant, waiting up to GST_RTSP_PLAYER_SNAPSHOT_TIMEOUT. Not to be called from a player streaming thread.
 GstSnapshot * GstRtspPlayer__get_snapshot(GstRtspPlayer* self);
 GstRtspPlayerSession * GstRtspPlayer__get_session (GstRtspPlayer * self);
 
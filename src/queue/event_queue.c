@@ -3,13 +3,46 @@
 #include <stdio.h>
 #include <unistd.h>
 #include "event_queue.h"
+#include "queue_event_list.h"
+#include "queue_metrics.h"
+#include "queue_ring.h"
 #include "clogger.h"
 #include <string.h>
 
+#ifdef __linux__
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#define EVENTQUEUE_HAS_FUTEX 1
+#endif
+
+//Build time opt-in for the stuck worker stack dump, which claims a realtime signal of the process
+#ifndef EVENTQUEUE_WATCHDOG_STACKS
+#define EVENTQUEUE_WATCHDOG_STACKS 0
+#endif
+
+#if EVENTQUEUE_WATCHDOG_STACKS && defined(__linux__) && defined(__GLIBC__)
+#include <execinfo.h>
+#include <signal.h>
+#include <pthread.h>
+#define EVENTQUEUE_HAS_BACKTRACE 1
+//Signal asking a stuck worker to print its own stack
+#ifndef EVENTQUEUE_WATCHDOG_SIGNAL
+#define EVENTQUEUE_WATCHDOG_SIGNAL (SIGRTMIN + 2)
+#endif
+#endif
+
+//Build time default for EventQueue__set_ready_ring. 0 keeps the mutex protected lanes only.
+#ifndef EVENTQUEUE_READY_RING_CAPACITY
+#define EVENTQUEUE_READY_RING_CAPACITY 0
+#endif
+
 #define GLIST_FOREACH(item, list) for(GList *__glist = list; __glist && (item = __glist->data, TRUE); __glist = __glist->next)
 
 enum {
     POOL_CHANGED,
+    POOL_STATS,
     EVT_ADDED,
     EVT_STARTED,
     EVT_FINISHED,
@@ -17,13 +50,165 @@ enum {
     LAST_SIGNAL
 };
 
+//Pending and running events sharing the same scope pointer
+typedef struct {
+    QueueEventList events; //Must remain the first member
+    //Strand events waiting for the one in flight, by priority then insertion order. They are linked through their ready node.
+    QueueEventList strand_waiting;
+    int strand_busy;
+    QueueEvent * strand_holder; //Ready or running strand event, linked under this scope
+} EventQueueScope;
+
+static const char * EventQueue__overflow_names[EVENTQUEUE_OVERFLOW_COUNT] = { "blocked", "rejected", "dropped oldest", "dropped newest" };
+
+//Consecutive dispatches a non-empty lane can be passed over before it is served ahead of higher lanes
+static const int EventQueue__starvation_limits[QUEUEEVENT_PRIORITY_COUNT] = { 0, 4, 8, 16 };
+
+/*
+ * Worker local deque. The owner pops from the tail, idle peers steal from the head.
+ * Slots are owned by the queue and only released on dispose,
+ * so a peer can safely lock a deque while its owner thread exits.
+ */
+typedef struct {
+    QueueEventList list; //Must remain the first member
+    P_MUTEX_TYPE lock;
+    gint count;
+    int in_use;
+    EventQueue * queue;
+} EventQueueDeque;
+
+#define EVENTQUEUE_MAX_DEQUES 256
+#define EVENTQUEUE_MAX_FREE_EVENTS 1024
+
+static _Thread_local EventQueueDeque * local_deque = NULL;
+static _Thread_local gint local_sched_seq = 0; //Scheduling generation applied by the current worker
+
+/*
+ * Dependent event inserted with EventQueue__insert_after, shared by its links to every antecedent.
+ * Each antecedent reports once, and the last report frees the join.
+ * Joins are registered with the owning queue, so antecedents and dependents can live in different pools.
+ */
+typedef struct {
+    QueueEvent * evt;
+    EventQueue * queue; //Pool holding the dependent event
+    QueueEventJoin mode;
+    gint remaining; //Antecedents left to dispatch (all) or to cancel (any)
+    gint resolved; //Set once the event was unblocked or cancelled
+    gint refs;
+} EventQueueJoin;
+
+//Capacity of the queue or of a lane, 0 for unbounded
+typedef struct {
+    gint capacity;
+    gint policy; //QueueEventOverflow
+} EventQueueBound;
+
+/*
+ * Lock order : scope_lock -> timer_lock -> pool_lock -> deque lock.
+ * The scope lock is held while an event is linked, so an indexed event is
+ * always either in a lane, in a deque or flagged as running.
+ */
 typedef struct {
-    GList * events;
-    GList * running_events;
+    QueueEventList lanes[QUEUEEVENT_PRIORITY_COUNT];
+    gint lane_skips[QUEUEEVENT_PRIORITY_COUNT];
+    gint lane_counts[QUEUEEVENT_PRIORITY_COUNT]; //Ready events of a lane, ringed or not
+    gint lane_overflow[QUEUEEVENT_PRIORITY_COUNT]; //Part of lane_counts held by the mutex protected lanes
+    GHashTable * scopes; //scope pointer -> EventQueueScope
     GList * threads;
 
-    P_COND_TYPE sleep_cond;
+    EventQueueDeque * deques[EVENTQUEUE_MAX_DEQUES];
+    gint deque_count;
+    gint steal_seed;
+
+    /*
+     * Optional lock-free ready rings, one per lane, in front of the lanes.
+     * A ringed node is tagged with its ring and holds a reference until a worker pops its cell,
+     * so a record removed by a cancellation can't be recycled while a stale cell points to it.
+     * The lanes take the overflow when a ring is full.
+     */
+    QueueRing * rings[QUEUEEVENT_PRIORITY_COUNT];
+    int ring_capacity;
+    gint park_seq; //Futex word bumped to wake workers parked while the rings are enabled
+
+    //Counters are only modified under their respective lock, but can be read lock-free
+    gint pending_count; //Lanes and deques
+    gint running_count;
+    gint thread_count;
+    gint starting_count; //Started, but not yet running
+    gint idle_count;
+
+    //Elastic pool. The monitor grows the pool, idle workers shrink it.
+    gint min_threads;
+    gint max_threads;
+    gint64 grow_threshold; //Microseconds
+    gint64 idle_timeout; //Microseconds
+    GThread * monitor;
+    int monitor_running;
+    GMutex monitor_lock;
+    GCond monitor_cond;
+    GList * retired; //P_THREAD_TYPE of exited workers waiting to be joined
+
+    //Stuck worker watchdog, run by the monitor
+    gint watchdog_threshold; //Milliseconds, 0 when disabled
+    gint watchdog_cancel;
+    GHashTable * stalled; //Replaced QueueThread still running, under threads_lock
+    gint stalled_count;
+    int stalled_capped; //Monitor only. Set once the cap was reported, until a stalled worker returns.
+
+    //Delayed and periodic events, ordered by due time. Serviced by a single timer thread.
+    GPtrArray * timers; //Binary min-heap of QueueEvent
+    gint delayed_count;
+    GPtrArray * deadlines; //Binary min-heap of running QueueEvent with a timeout
+    GThread * timer_thread;
+    int timer_running;
+    GMutex timer_lock;
+    GCond timer_cond;
+
+    //Coalesced counters published on the main context
+    gint stats_interval; //Milliseconds
+    gint stats_scheduled;
+    gint disposing;
+
+    //Wait and run time histograms, per callback and per scope
+    QueueMetrics * metrics;
+    QueueEvent * metrics_dump; //Periodic log dump, held until replaced
+
+    //Finished records kept for reuse, linked through their ready node
+    QueueEventList free_events;
+    P_MUTEX_TYPE free_lock;
+
+    //Dependent events waiting on their antecedents, linked through their ready node under scope_lock
+    QueueEventList blocked;
+    GHashTable * dependents; //antecedent QueueEvent, referenced while it is a key -> GPtrArray of EventQueueJoin
+    gint dependents_count;
+    P_MUTEX_TYPE deps_lock; //Taken alone
+
+    //Named pools. Each one is a child queue, and index 0 is the queue itself.
+    EventQueue * pools[EVENTQUEUE_MAX_POOLS];
+    char * pool_names[EVENTQUEUE_MAX_POOLS];
+    gint pool_count; //Published after the pool slot is set
+    EventQueue * parent; //Owning queue of a named pool, not referenced
+
+    //Worker scheduling, under threads_lock. Workers compare sched_seq with the generation they applied.
+    ThreadSched sched;
+    gint sched_seq;
+    gint thread_serial; //Numbering of worker names
+
+    //Backpressure. Producers blocked by a full queue wait on room_cond, signalled by workers as they pop.
+    EventQueueBound bound;
+    EventQueueBound lane_bounds[QUEUEEVENT_PRIORITY_COUNT];
+    gint overflow_counts[EVENTQUEUE_OVERFLOW_COUNT];
+    QueueEventRejectCallback reject_cb;
+    void * reject_data;
+    gint room_waiters;
+    GMutex room_lock; //Taken alone
+    GCond room_cond;
+
+    //GLib primitives, since idle workers need a timed wait
+    GCond sleep_cond;
+    GMutex sleep_lock;
     P_MUTEX_TYPE pool_lock;
+    P_MUTEX_TYPE scope_lock;
     P_MUTEX_TYPE threads_lock;
     P_MUTEX_TYPE signal_lock;
 } EventQueuePrivate;
@@ -32,6 +217,27 @@ static guint signals[LAST_SIGNAL] = { 0 };
 
 G_DEFINE_TYPE_WITH_PRIVATE(EventQueue, EventQueue_, G_TYPE_OBJECT)
 
+//Queue owning the pool, which emits the signals and tracks the dependencies of every pool
+static EventQueue *
+EventQueue__root(EventQueue * self){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    return (priv->parent) ? priv->parent : self;
+}
+
+//Pool an event is inserted into. Unknown pools fall back to the default pool.
+static EventQueue *
+EventQueue__route(EventQueue * self, const QueueEventOptions * options){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    if(options->pool == EVENTQUEUE_POOL_DEFAULT || priv->parent){
+        return self;
+    }
+    if(options->pool < 0 || options->pool >= g_atomic_int_get(&priv->pool_count)){
+        C_WARN("Unknown EventQueue pool [%d]. Using the default pool.",options->pool);
+        return self;
+    }
+    return priv->pools[options->pool];
+}
+
 GType
 QueueEventType__get_type (void){
         static gsize g_define_type_id__volatile = 0;
@@ -44,6 +250,8 @@ QueueEventType__get_type (void){
                         { EVENTQUEUE_ADDED,         "EVENTQUEUE_ADDED",         "Added"},
                         { EVENTQUEUE_STARTED,       "EVENTQUEUE_STARTED",       "Started"},
                         { EVENTQUEUE_FINISHED,      "EVENTQUEUE_FINISHED",      "Finished"},
+                        { EVENTQUEUE_GROWN,         "EVENTQUEUE_GROWN",         "Grown"},
+                        { EVENTQUEUE_SHRUNK,        "EVENTQUEUE_SHRUNK",        "Shrunk"},
                         { 0,                        NULL,                       NULL}
                 };
                 GType g_define_type_id = g_enum_register_static(g_intern_static_string("QueueEventType"), values);
@@ -53,232 +261,1707 @@ QueueEventType__get_type (void){
         return g_define_type_id__volatile;
 }
 
-static void 
-EventQueue__emit_signal_prelocked(EventQueue * self, QueueEvent * evt, QueueEventType type){
-    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
-    int runcount = 0;
-    int pendingcount = 0;
-    int threadcount = 0;
-    if(priv->running_events) runcount = g_list_length(priv->running_events);
-    if(priv->events) pendingcount = g_list_length(priv->events);
-    if(priv->threads) threadcount = g_list_length(priv->threads);
-    P_MUTEX_UNLOCK(priv->pool_lock);
+static void
+EventQueue__scope_link_prelocked(EventQueuePrivate * priv, QueueEvent * evt){
+    void * scope = QueueEvent__get_scope(evt);
+    EventQueueScope * entry = g_hash_table_lookup(priv->scopes, scope);
+    if(!entry){
+        entry = g_new0(EventQueueScope, 1);
+        QueueEventList__init(&entry->events);
+        QueueEventList__init(&entry->strand_waiting);
+        entry->strand_busy = 0;
+        entry->strand_holder = NULL;
+        g_hash_table_insert(priv->scopes, scope, entry);
+    }
+    QueueEventList__push_tail(&entry->events, QueueEvent__get_scope_node(evt));
+}
 
-    switch(type){
-        case EVENTQUEUE_DISPATCHED:
-            g_signal_emit (self, signals[EVT_FINISHED], 0, evt);
-            break;
-        case EVENTQUEUE_CANCELLED:
-            g_signal_emit (self, signals[EVT_CANCELLED], 0, evt);
-            return;
-        case EVENTQUEUE_DISPATCHING:
-            g_signal_emit (self, signals[EVT_STARTED], 0, evt);
-            break;
-        case EVENTQUEUE_ADDED:
-            g_signal_emit (self, signals[EVT_ADDED], 0, evt);
-            break;
-        case EVENTQUEUE_STARTED:
-        case EVENTQUEUE_FINISHED:
-        default:
-            break;
+static void
+EventQueue__scope_unlink_prelocked(EventQueuePrivate * priv, QueueEvent * evt){
+    QueueEventNode * node = QueueEvent__get_scope_node(evt);
+    EventQueueScope * entry = (EventQueueScope *) node->list; //events is the first member
+    if(!entry){
+        return;
     }
+    QueueEventList__remove(&entry->events, node);
+    if(entry->events.length == 0){
+        g_hash_table_remove(priv->scopes, QueueEvent__get_scope(evt));
+    }
+}
 
-    g_signal_emit (self, signals[POOL_CHANGED], 0, type, runcount, pendingcount, threadcount, evt);
+static void
+EventQueue__push_ready_prelocked(EventQueuePrivate * priv, QueueEvent * evt){
+    QueueEventPriority lane = QueueEvent__get_priority(evt);
+    QueueEventList__push_tail(&priv->lanes[lane], QueueEvent__get_node(evt));
+    g_atomic_int_inc(&priv->lane_counts[lane]);
+    g_atomic_int_inc(&priv->lane_overflow[lane]);
+    g_atomic_int_inc(&priv->pending_count);
 }
 
-static void 
-EventQueue__emit_signal(EventQueue * self, QueueEvent * evt, QueueEventType type){
-    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
-    P_MUTEX_LOCK(priv->pool_lock);
-    EventQueue__emit_signal_prelocked(self, evt, type);
+/*
+ * Lock-free fast path to the ready lanes. Counters are raised first, so they never go negative
+ * when a worker pops the cell right away. Returns FALSE when the rings are disabled or full.
+ */
+static int
+EventQueue__ring_push(EventQueuePrivate * priv, QueueEvent * evt){
+    QueueEventPriority lane = QueueEvent__get_priority(evt);
+    QueueRing * ring = priv->rings[lane];
+    if(!ring){
+        return FALSE;
+    }
+    QueueEventNode * node = QueueEvent__get_node(evt);
+    g_object_ref(evt);
+    g_atomic_int_inc(&priv->lane_counts[lane]);
+    g_atomic_int_inc(&priv->pending_count);
+    g_atomic_pointer_set(&node->list, ring);
+    if(!QueueRing__push(ring, node, node->queued_time)){
+        g_atomic_pointer_set(&node->list, NULL);
+        g_atomic_int_add(&priv->lane_counts[lane], -1);
+        g_atomic_int_add(&priv->pending_count, -1);
+        g_object_unref(evt);
+        return FALSE;
+    }
+    return TRUE;
+}
 
+static EventQueueScope *
+EventQueue__scope_entry(QueueEvent * evt){
+    return (EventQueueScope *) QueueEvent__get_scope_node(evt)->list;
 }
 
-static void 
-EventQueue__stop_all_threads(EventQueue* self){
-    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
-    P_MUTEX_LOCK(priv->threads_lock);
-    GList * childs = priv->threads;
-    QueueThread * thread;
-    int tlen = g_list_length(priv->threads);
-    P_THREAD_TYPE pthread_killed[tlen];
-    int index = 0;
-    for(;childs && (thread = childs->data, TRUE); childs = childs->next){
-        QueueThread__terminate(thread);
-        P_THREAD_TYPE pthread = QueueThread__get_thread(thread);
-        pthread_killed[index++] = pthread;
+/*
+ * Queue a strand event behind the waiters of the same or a higher priority.
+ * A holder taken back before its dispatch goes first among its priority, since it was queued earlier.
+ */
+static void
+EventQueue__strand_wait_prelocked(EventQueueScope * entry, QueueEvent * evt, int first){
+    QueueEventPriority priority = QueueEvent__get_priority(evt);
+    QueueEventNode * pos = entry->strand_waiting.tail;
+    while(pos && (QueueEvent__get_priority(pos->evt) > priority || (first && QueueEvent__get_priority(pos->evt) == priority))){
+        pos = pos->prev;
     }
-    if(priv->threads){
-        g_list_free(priv->threads);
-        priv->threads = NULL;
+    QueueEventList__insert_after(&entry->strand_waiting, pos, QueueEvent__get_node(evt));
+}
+
+static int EventQueue__remove_ready(EventQueuePrivate * priv, QueueEvent * evt);
+
+/*
+ * Hand a linked event over to the workers. A strand event waits behind the one in flight for its scope,
+ * unless that one wasn't dispatched yet and has a lower priority, in which case they trade places.
+ * Strand events skip the ready rings, so a holder taken back never leaves a stale cell behind.
+ * Follow-up work spawned by a running event stays on its worker when local is set.
+ * Returns TRUE if the event became ready. The caller holds scope_lock.
+ */
+static int
+EventQueue__make_ready_prelocked(EventQueuePrivate * priv, QueueEvent * evt, int local){
+    QueueEventNode * node = QueueEvent__get_node(evt);
+    int strand = QueueEvent__get_flags(evt) & QUEUEEVENT_FLAG_STRAND;
+    if(strand){
+        EventQueueScope * entry = EventQueue__scope_entry(evt);
+        if(entry->strand_busy){
+            QueueEvent * holder = entry->strand_holder;
+            if(!holder || QueueEvent__get_priority(holder) <= QueueEvent__get_priority(evt)
+                || !EventQueue__remove_ready(priv, holder)){
+                EventQueue__strand_wait_prelocked(entry, evt, FALSE);
+                return FALSE;
+            }
+            EventQueue__strand_wait_prelocked(entry, holder, TRUE);
+        }
+        entry->strand_busy = 1;
+        entry->strand_holder = evt;
     }
-    P_MUTEX_UNLOCK(priv->threads_lock);
-    P_COND_BROADCAST(priv->sleep_cond); //Notify sleeping thread
 
-    //Thread resource clean up
-    for(index=0;index<tlen;index++){
-        P_THREAD_JOIN(pthread_killed[index]);
+    if(local && local_deque){
+        P_MUTEX_LOCK(local_deque->lock);
+        QueueEventList__push_tail(&local_deque->list, node);
+        g_atomic_int_inc(&local_deque->count);
+        g_atomic_int_inc(&priv->pending_count);
+        P_MUTEX_UNLOCK(local_deque->lock);
+    } else if(strand || !EventQueue__ring_push(priv, evt)){
+        P_MUTEX_LOCK(priv->pool_lock);
+        EventQueue__push_ready_prelocked(priv, evt);
+        P_MUTEX_UNLOCK(priv->pool_lock);
     }
+    return TRUE;
 }
 
-static void 
-EventQueue__dispose(GObject * obj){
-    EventQueue * queue = QUEUE_EVENTQUEUE(obj);
-    EventQueuePrivate *priv = EventQueue__get_instance_private (queue);
+//The strand event in flight for this scope is done. Returns TRUE if the next one became ready.
+static int
+EventQueue__strand_release_prelocked(EventQueuePrivate * priv, EventQueueScope * entry){
+    entry->strand_busy = 0;
+    entry->strand_holder = NULL;
+    QueueEventNode * next = QueueEventList__pop_head(&entry->strand_waiting);
+    if(!next){
+        return FALSE;
+    }
+    next->queued_time = g_get_monotonic_time();
+    return EventQueue__make_ready_prelocked(priv, next->evt, FALSE);
+}
 
-    //Thread cleanup
-    EventQueue__stop_all_threads(queue);
+#ifdef EVENTQUEUE_HAS_FUTEX
+//Returns FALSE once the timeout elapsed. A negative timeout waits until woken.
+static int
+EventQueue__park(gint * word, gint expected, gint64 timeout){
+    struct timespec ts;
+    struct timespec * tsp = NULL;
+    if(timeout >= 0){
+        ts.tv_sec = timeout / G_USEC_PER_SEC;
+        ts.tv_nsec = (timeout % G_USEC_PER_SEC) * 1000;
+        tsp = &ts;
+    }
+    if(syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, tsp, NULL, 0) == -1 && errno == ETIMEDOUT){
+        return FALSE;
+    }
+    return TRUE;
+}
 
-    if(priv->events){
-        //TODO Cancel pending event for clean up
-        g_list_free(priv->events);
-        priv->events = NULL;
+static void
+EventQueue__unpark(gint * word, int count){
+    g_atomic_int_inc(word);
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+#endif
+
+//Only takes the sleep lock when a worker is actually waiting
+static void
+EventQueue__wake_workers(EventQueuePrivate * priv, int count){
+    if(!g_atomic_int_get(&priv->idle_count)){
+        return;
+    }
+#ifdef EVENTQUEUE_HAS_FUTEX
+    if(priv->ring_capacity){
+        EventQueue__unpark(&priv->park_seq, count);
+        return;
+    }
+#endif
+    g_mutex_lock(&priv->sleep_lock);
+    if(count >= g_atomic_int_get(&priv->idle_count)){
+        g_cond_broadcast(&priv->sleep_cond);
+    } else {
+        int i;
+        for(i=0;i<count;i++){
+            g_cond_signal(&priv->sleep_cond);
+        }
     }
+    g_mutex_unlock(&priv->sleep_lock);
+}
 
-    if(priv->running_events){
-        //Nothing to cancel here, since threads are all dead
-        g_list_free(priv->running_events);
-        priv->running_events = NULL;
+//Wake every idle worker, however it is parked
+static void
+EventQueue__wake_all(EventQueuePrivate * priv){
+    g_mutex_lock(&priv->sleep_lock);
+    g_cond_broadcast(&priv->sleep_cond);
+    g_mutex_unlock(&priv->sleep_lock);
+#ifdef EVENTQUEUE_HAS_FUTEX
+    if(priv->ring_capacity){
+        EventQueue__unpark(&priv->park_seq, INT_MAX);
     }
+#endif
+}
 
-    P_COND_CLEANUP(priv->sleep_cond);
-    P_MUTEX_CLEANUP(priv->pool_lock);
-    P_MUTEX_CLEANUP(priv->threads_lock);
-    P_MUTEX_CLEANUP(priv->signal_lock);
+/*
+ * Binary min-heap on the due time. Each event keeps its heap position,
+ * so a cancelled timer is removed in O(log n). The caller holds timer_lock.
+ */
+static void
+EventQueue__timer_swap(GPtrArray * heap, guint a, guint b){
+    QueueEvent * tmp = g_ptr_array_index(heap, a);
+    heap->pdata[a] = heap->pdata[b];
+    heap->pdata[b] = tmp;
+    QueueEvent__get_node(heap->pdata[a])->heap_index = a;
+    QueueEvent__get_node(heap->pdata[b])->heap_index = b;
+}
 
-    G_OBJECT_CLASS (EventQueue__parent_class)->dispose (obj);
+static gint64
+EventQueue__timer_due(GPtrArray * heap, guint index){
+    return QueueEvent__get_node(g_ptr_array_index(heap, index))->due_time;
 }
 
 static void
-EventQueue__class_init (EventQueueClass *klass)
-{
-    GObjectClass *object_class = G_OBJECT_CLASS (klass);
-    object_class->dispose = EventQueue__dispose;
-
-    GType params[5];
-    params[0] = QUEUE_TYPE_EVENTTYPE | G_SIGNAL_TYPE_STATIC_SCOPE;
-    params[1] = G_TYPE_INT | G_SIGNAL_TYPE_STATIC_SCOPE;
-    params[2] = G_TYPE_INT | G_SIGNAL_TYPE_STATIC_SCOPE;
-    params[3] = G_TYPE_INT | G_SIGNAL_TYPE_STATIC_SCOPE;
-    params[4] = QUEUE_TYPE_QUEUEEVENT | G_SIGNAL_TYPE_STATIC_SCOPE;
-    signals[POOL_CHANGED] =
-        g_signal_newv ("pool-changed",
-                        G_TYPE_FROM_CLASS (klass),
-                        G_SIGNAL_RUN_LAST | G_SIGNAL_NO_HOOKS,
-                        NULL /* closure */,
-                        NULL /* accumulator */,
-                        NULL /* accumulator data */,
-                        NULL /* C marshaller */,
-                        G_TYPE_NONE /* return_type */,
-                        5     /* n_params */,
-                        params  /* param_types */);
-    
-    params[0] = QUEUE_TYPE_QUEUEEVENT | G_SIGNAL_TYPE_STATIC_SCOPE;
-    signals[EVT_ADDED] =
-        g_signal_newv ("evt-added",
-                        G_TYPE_FROM_CLASS (klass),
-                        G_SIGNAL_RUN_LAST | G_SIGNAL_NO_HOOKS,
-                        NULL /* closure */,
-                        NULL /* accumulator */,
-                        NULL /* accumulator data */,
-                        NULL /* C marshaller */,
-                        G_TYPE_NONE /* return_type */,
-                        1     /* n_params */,
-                        params  /* param_types */);
+EventQueue__timer_sift_up(GPtrArray * heap, guint index){
+    while(index > 0){
+        guint parent = (index - 1) / 2;
+        if(EventQueue__timer_due(heap, parent) <= EventQueue__timer_due(heap, index)){
+            break;
+        }
+        EventQueue__timer_swap(heap, parent, index);
+        index = parent;
+    }
+}
 
-    signals[EVT_STARTED] =
-        g_signal_newv ("evt-started",
-                        G_TYPE_FROM_CLASS (klass),
-                        G_SIGNAL_RUN_LAST | G_SIGNAL_NO_HOOKS,
-                        NULL /* closure */,
-                        NULL /* accumulator */,
-                        NULL /* accumulator data */,
-                        NULL /* C marshaller */,
-                        G_TYPE_NONE /* return_type */,
-                        1     /* n_params */,
-                        params  /* param_types */);
+static void
+EventQueue__timer_sift_down(GPtrArray * heap, guint index){
+    while(1){
+        guint smallest = index;
+        guint left = index * 2 + 1;
+        guint right = left + 1;
+        if(left < heap->len && EventQueue__timer_due(heap, left) < EventQueue__timer_due(heap, smallest)){
+            smallest = left;
+        }
+        if(right < heap->len && EventQueue__timer_due(heap, right) < EventQueue__timer_due(heap, smallest)){
+            smallest = right;
+        }
+        if(smallest == index){
+            break;
+        }
+        EventQueue__timer_swap(heap, index, smallest);
+        index = smallest;
+    }
+}
 
-    signals[EVT_FINISHED] =
-        g_signal_newv ("evt-finished",
-                        G_TYPE_FROM_CLASS (klass),
-                        G_SIGNAL_RUN_LAST | G_SIGNAL_NO_HOOKS,
-                        NULL /* closure */,
-                        NULL /* accumulator */,
-                        NULL /* accumulator data */,
-                        NULL /* C marshaller */,
-                        G_TYPE_NONE /* return_type */,
-                        1     /* n_params */,
-                        params  /* param_types */);
+static void
+EventQueue__heap_remove(GPtrArray * heap, QueueEventNode * node){
+    guint index = node->heap_index;
+    guint last = heap->len - 1;
+    if(index != last){
+        EventQueue__timer_swap(heap, index, last);
+    }
+    g_ptr_array_remove_index(heap, last);
+    if(index < heap->len){
+        EventQueue__timer_sift_down(heap, index);
+        EventQueue__timer_sift_up(heap, index);
+    }
+    node->heap_index = -1;
+}
 
-    signals[EVT_CANCELLED] =
-        g_signal_newv ("evt-cancelled",
-                        G_TYPE_FROM_CLASS (klass),
-                        G_SIGNAL_RUN_LAST | G_SIGNAL_NO_HOOKS,
-                        NULL /* closure */,
-                        NULL /* accumulator */,
-                        NULL /* accumulator data */,
-                        NULL /* C marshaller */,
-                        G_TYPE_NONE /* return_type */,
-                        1     /* n_params */,
-                        params  /* param_types */);
-    
+static void
+EventQueue__timer_remove_prelocked(EventQueuePrivate * priv, QueueEventNode * node){
+    EventQueue__heap_remove(priv->timers, node);
+    g_atomic_pointer_set(&node->list, NULL);
+    g_atomic_int_add(&priv->delayed_count, -1);
 }
 
-static void 
-EventQueue__init(EventQueue* self) {
+static gpointer EventQueue__timer_thread(gpointer data);
+
+//Start the timer thread, or wake it up if the earliest due time changed
+static void
+EventQueue__timer_wake_prelocked(EventQueue * self, int earliest){
     EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    if(!priv->timer_thread){
+        priv->timer_running = 1;
+        priv->timer_thread = g_thread_new("eq-timer", EventQueue__timer_thread, self);
+    } else if(earliest){
+        g_cond_signal(&priv->timer_cond);
+    }
+}
 
-    priv->threads = NULL;
-    priv->events = NULL;
-    priv->running_events = NULL;
+//Caller holds scope_lock, so that a timer moved to a lane is never seen unlinked by a cancellation
+static void
+EventQueue__schedule_prelocked(EventQueue * self, QueueEvent * evt, gint64 due_time){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    QueueEventNode * node = QueueEvent__get_node(evt);
+    g_mutex_lock(&priv->timer_lock);
+    node->due_time = due_time;
+    node->heap_index = priv->timers->len;
+    g_ptr_array_add(priv->timers, evt);
+    g_atomic_pointer_set(&node->list, &priv->timers);
+    g_atomic_int_inc(&priv->delayed_count);
+    EventQueue__timer_sift_up(priv->timers, node->heap_index);
+    EventQueue__timer_wake_prelocked(self, node->heap_index == 0);
+    g_mutex_unlock(&priv->timer_lock);
+}
 
-    P_COND_SETUP(priv->sleep_cond);
-    P_MUTEX_SETUP(priv->pool_lock);
-    P_MUTEX_SETUP(priv->threads_lock);
-    P_MUTEX_SETUP(priv->signal_lock);
+/*
+ * Running events with a timeout are tracked in a second heap, through the same node.
+ * A running event is in no list, so its heap position and due time are free to reuse.
+ */
+static void
+EventQueue__arm_deadline(EventQueue * self, QueueEvent * evt, gint64 deadline){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    QueueEventNode * node = QueueEvent__get_node(evt);
+    g_mutex_lock(&priv->timer_lock);
+    node->due_time = deadline;
+    node->heap_index = priv->deadlines->len;
+    g_ptr_array_add(priv->deadlines, evt);
+    EventQueue__timer_sift_up(priv->deadlines, node->heap_index);
+    EventQueue__timer_wake_prelocked(self, node->heap_index == 0);
+    g_mutex_unlock(&priv->timer_lock);
 }
 
-EventQueue* 
-EventQueue__new() {
-    return g_object_new (QUEUE_TYPE_EVENTQUEUE, NULL);
+static void
+EventQueue__disarm_deadline(EventQueue * self, QueueEvent * evt){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    QueueEventNode * node = QueueEvent__get_node(evt);
+    g_mutex_lock(&priv->timer_lock);
+    if(node->heap_index >= 0){
+        EventQueue__heap_remove(priv->deadlines, node);
+    }
+    g_mutex_unlock(&priv->timer_lock);
 }
 
-int 
-EventQueue__get_thread_count(EventQueue * self){
-    g_return_val_if_fail (self != NULL,0);
-    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self),0);
+//Cancel running events past their deadline. Their token aborts cancellable I/O.
+static void
+EventQueue__expire_deadlines(EventQueue * self){
     EventQueuePrivate *priv = EventQueue__get_instance_private (self);
-    int ret;
-    P_MUTEX_LOCK(priv->threads_lock);
-    ret = g_list_length(priv->threads);
-    P_MUTEX_UNLOCK(priv->threads_lock);
-    return ret;
+    GList * expired = NULL;
+    gint64 now = g_get_monotonic_time();
+    g_mutex_lock(&priv->timer_lock);
+    while(priv->deadlines->len && EventQueue__timer_due(priv->deadlines, 0) <= now){
+        QueueEvent * evt = g_ptr_array_index(priv->deadlines, 0);
+        EventQueue__heap_remove(priv->deadlines, QueueEvent__get_node(evt));
+        //The worker can't release it before disarming, which needs this lock
+        expired = g_list_prepend(expired, g_object_ref(evt));
+    }
+    g_mutex_unlock(&priv->timer_lock);
+
+    QueueEvent * evt;
+    GLIST_FOREACH(evt, expired){
+        C_WARN("Event %p exceeded its deadline. Cancelling...", (void *) evt);
+        QueueEvent__expire(evt);
+        EventQueue__release_event(self, evt);
+    }
+    g_list_free(expired);
 }
 
-void 
-EventQueue__stop(EventQueue* self, int nthread){
-    g_return_if_fail (self != NULL);
-    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+//Move every due timer to its priority lane
+static void
+EventQueue__fire_timers(EventQueue * self){
     EventQueuePrivate *priv = EventQueue__get_instance_private (self);
-    P_MUTEX_LOCK(priv->threads_lock);
-    int cancelled_count = 0;
-    GList * childs = priv->threads;
-    QueueThread * thread;
-    for(;childs && (thread = childs->data, TRUE); childs = childs->next){
-        if(cancelled_count == nthread){
-            break;
-        }
-        if(!QueueThread__is_terminated(thread)){
-            QueueThread__terminate(thread);
-            cancelled_count++;
-        }
+    int fired = 0;
+    gint64 now = g_get_monotonic_time();
+    P_MUTEX_LOCK(priv->scope_lock);
+    g_mutex_lock(&priv->timer_lock);
+    while(priv->timers->len && EventQueue__timer_due(priv->timers, 0) <= now){
+        QueueEvent * evt = g_ptr_array_index(priv->timers, 0);
+        QueueEventNode * node = QueueEvent__get_node(evt);
+        EventQueue__timer_remove_prelocked(priv, node);
+        node->queued_time = now;
+        fired += EventQueue__make_ready_prelocked(priv, evt, FALSE);
+    }
+    g_mutex_unlock(&priv->timer_lock);
+    P_MUTEX_UNLOCK(priv->scope_lock);
+
+    if(fired){
+        EventQueue__wake_workers(priv, fired);
     }
-    P_COND_BROADCAST(priv->sleep_cond); //Notify thread if it's sleeping
-    P_MUTEX_UNLOCK(priv->threads_lock);
 }
 
-static void 
-EventQueue__evt_state_changed_cb(QueueEvent * queue, QueueEventState state, EventQueue * self){
+static gpointer
+EventQueue__timer_thread(gpointer data){
+    EventQueue * self = QUEUE_EVENTQUEUE(data);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+
+    g_mutex_lock(&priv->timer_lock);
+    while(priv->timer_running){
+        if(!priv->timers->len && !priv->deadlines->len){
+            g_cond_wait(&priv->timer_cond, &priv->timer_lock);
+            continue;
+        }
+        gint64 now = g_get_monotonic_time();
+        gint64 due = G_MAXINT64;
+        if(priv->timers->len){
+            due = EventQueue__timer_due(priv->timers, 0);
+        }
+        if(priv->deadlines->len && EventQueue__timer_due(priv->deadlines, 0) < due){
+            due = EventQueue__timer_due(priv->deadlines, 0);
+        }
+        if(due > now){
+            g_cond_wait_until(&priv->timer_cond, &priv->timer_lock, due);
+            continue;
+        }
+        //Firing needs the scope lock, which comes first in the lock order
+        g_mutex_unlock(&priv->timer_lock);
+        EventQueue__fire_timers(self);
+        EventQueue__expire_deadlines(self);
+        g_mutex_lock(&priv->timer_lock);
+    }
+    g_mutex_unlock(&priv->timer_lock);
+    return NULL;
+}
+
+/*
+ * Lanes are tagged by their address and deques by their first member,
+ * so the owning list of a pending node tells where to lock.
+ * A ringed node is claimed by clearing its tag, and its stale cell is skipped once popped.
+ * The node can move from a deque to a lane when its owner exits, hence the retry.
+ */
+static int
+EventQueue__remove_ready(EventQueuePrivate * priv, QueueEvent * evt){
+    QueueEventNode * node = QueueEvent__get_node(evt);
+    QueueEventPriority lane = QueueEvent__get_priority(evt);
+    void * list;
+    while((list = g_atomic_pointer_get(&node->list))){
+        if(list == &priv->timers){
+            g_mutex_lock(&priv->timer_lock);
+            if(node->list == &priv->timers){
+                EventQueue__timer_remove_prelocked(priv, node);
+                g_mutex_unlock(&priv->timer_lock);
+                return TRUE;
+            }
+            g_mutex_unlock(&priv->timer_lock);
+        } else if(list == priv->rings[lane]){
+            if(g_atomic_pointer_compare_and_exchange(&node->list, list, NULL)){
+                g_atomic_int_add(&priv->lane_counts[lane], -1);
+                g_atomic_int_add(&priv->pending_count, -1);
+                return TRUE;
+            }
+        } else if(list == &priv->lanes[lane]){
+            P_MUTEX_LOCK(priv->pool_lock);
+            if(QueueEventList__contains(&priv->lanes[lane], node)){
+                QueueEventList__remove(&priv->lanes[lane], node);
+                g_atomic_int_add(&priv->lane_counts[lane], -1);
+                g_atomic_int_add(&priv->lane_overflow[lane], -1);
+                g_atomic_int_add(&priv->pending_count, -1);
+                P_MUTEX_UNLOCK(priv->pool_lock);
+                return TRUE;
+            }
+            P_MUTEX_UNLOCK(priv->pool_lock);
+        } else {
+            EventQueueDeque * deque = (EventQueueDeque *) list;
+            P_MUTEX_LOCK(deque->lock);
+            if(QueueEventList__contains(&deque->list, node)){
+                QueueEventList__remove(&deque->list, node);
+                g_atomic_int_add(&deque->count, -1);
+                g_atomic_int_add(&priv->pending_count, -1);
+                P_MUTEX_UNLOCK(deque->lock);
+                return TRUE;
+            }
+            P_MUTEX_UNLOCK(deque->lock);
+        }
+    }
+    return FALSE;
+}
+
+//Head of a mutex protected lane, or NULL when it is empty. The caller holds pool_lock.
+static QueueEvent *
+EventQueue__pop_lane_prelocked(EventQueuePrivate * priv, int lane){
+    QueueEventNode * node = QueueEventList__pop_head(&priv->lanes[lane]);
+    if(!node){
+        return NULL;
+    }
+    g_atomic_int_add(&priv->lane_counts[lane], -1);
+    g_atomic_int_add(&priv->lane_overflow[lane], -1);
+    g_atomic_int_add(&priv->pending_count, -1);
+    //Flagged before the lock is released so that a concurrent cancellation sees it
+    g_atomic_int_set(&node->running, 1);
+    g_atomic_int_inc(&priv->running_count);
+    return node->evt;
+}
+
+/*
+ * Serve the highest non-empty lane, unless a lower lane was passed over
+ * more than its starvation limit, in which case that lane goes first.
+ */
+static QueueEvent *
+EventQueue__pop_ready_prelocked(EventQueuePrivate * priv){
+    int lane;
+    int selected = -1;
+    for(lane=0;lane<QUEUEEVENT_PRIORITY_COUNT;lane++){
+        if(!priv->lanes[lane].length){
+            continue;
+        }
+        if(selected < 0){
+            selected = lane;
+        } else if(g_atomic_int_get(&priv->lane_skips[lane]) >= EventQueue__starvation_limits[lane]){
+            selected = lane;
+            break;
+        }
+    }
+
+    if(selected < 0){
+        return NULL;
+    }
+
+    //Also updated by ring pops outside of the pool lock
+    for(lane=selected+1;lane<QUEUEEVENT_PRIORITY_COUNT;lane++){
+        if(priv->lanes[lane].length){
+            g_atomic_int_inc(&priv->lane_skips[lane]);
+        }
+    }
+    g_atomic_int_set(&priv->lane_skips[selected], 0);
+    return EventQueue__pop_lane_prelocked(priv, selected);
+}
+
+/*
+ * Take the node of a popped cell unless a cancellation removed it meanwhile.
+ * The running flag is raised before the claim, so a concurrent cancellation sees it.
+ */
+static QueueEvent *
+EventQueue__ring_claim(EventQueue * self, QueueEventNode * node, QueueEventPriority lane){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    QueueEvent * evt = node->evt;
+    g_atomic_int_set(&node->running, 1);
+    g_atomic_int_inc(&priv->running_count);
+    if(g_atomic_pointer_compare_and_exchange(&node->list, priv->rings[lane], NULL)){
+        g_atomic_int_add(&priv->lane_counts[lane], -1);
+        g_atomic_int_add(&priv->pending_count, -1);
+        g_object_unref(evt); //Cell reference. The queue still holds its own until dispatched.
+        return evt;
+    }
+    g_atomic_int_set(&node->running, 0);
+    g_atomic_int_add(&priv->running_count, -1);
+    EventQueue__release_event(self, evt);
+    return NULL;
+}
+
+static QueueEvent *
+EventQueue__ring_pop_lane(EventQueue * self, QueueEventPriority lane){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    QueueEventNode * node;
+    while((node = QueueRing__pop(priv->rings[lane]))){
+        QueueEvent * evt = EventQueue__ring_claim(self, node, lane);
+        if(evt){
+            return evt;
+        }
+    }
+    return NULL;
+}
+
+//Overflow head of a lane, if it was queued before the given time. 0 takes it regardless.
+static QueueEvent *
+EventQueue__pop_overflow(EventQueuePrivate * priv, int lane, gint64 before){
+    if(!g_atomic_int_get(&priv->lane_overflow[lane])){
+        return NULL;
+    }
+    QueueEvent * evt = NULL;
+    P_MUTEX_LOCK(priv->pool_lock);
+    QueueEventNode * head = priv->lanes[lane].head;
+    if(head && (!before || head->queued_time <= before)){
+        evt = EventQueue__pop_lane_prelocked(priv, lane);
+    }
+    P_MUTEX_UNLOCK(priv->pool_lock);
+    return evt;
+}
+
+/*
+ * Oldest ready event of a lane, from its ring or its overflow.
+ * The overflow holds events queued while the ring was full, which usually come before the ring cells.
+ */
+static QueueEvent *
+EventQueue__pop_any_lane(EventQueue * self, QueueEventPriority lane){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    QueueEvent * evt = NULL;
+    gint64 ringed = QueueRing__peek_time(priv->rings[lane]);
+    if(ringed){
+        evt = EventQueue__pop_overflow(priv, lane, ringed);
+    }
+    if(!evt){
+        evt = EventQueue__ring_pop_lane(self, lane);
+    }
+    if(!evt){
+        evt = EventQueue__pop_overflow(priv, lane, 0);
+    }
+    return evt;
+}
+
+/*
+ * Same lane selection as EventQueue__pop_ready_prelocked, on the lock-free counters,
+ * so an overflowed interactive event is never passed over for a ringed lower lane.
+ * Concurrent pops may skew the starvation counters slightly, which only shifts when a lane is promoted.
+ */
+static QueueEvent *
+EventQueue__pop_ring(EventQueue * self){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    int lane;
+    int selected = -1;
+    for(lane=0;lane<QUEUEEVENT_PRIORITY_COUNT;lane++){
+        if(!g_atomic_int_get(&priv->lane_counts[lane])){
+            continue;
+        }
+        if(selected < 0){
+            selected = lane;
+        } else if(g_atomic_int_get(&priv->lane_skips[lane]) >= EventQueue__starvation_limits[lane]){
+            selected = lane;
+            break;
+        }
+    }
+    if(selected < 0){
+        return NULL;
+    }
+
+    QueueEvent * evt = EventQueue__pop_any_lane(self, selected);
+    for(lane=0;!evt && lane<QUEUEEVENT_PRIORITY_COUNT;lane++){
+        if(lane != selected && g_atomic_int_get(&priv->lane_counts[lane])){
+            evt = EventQueue__pop_any_lane(self, lane);
+        }
+    }
+    if(!evt){
+        return NULL; //Taken by other workers meanwhile
+    }
+
+    selected = QueueEvent__get_priority(evt);
+    for(lane=selected+1;lane<QUEUEEVENT_PRIORITY_COUNT;lane++){
+        if(g_atomic_int_get(&priv->lane_counts[lane])){
+            g_atomic_int_inc(&priv->lane_skips[lane]);
+        }
+    }
+    g_atomic_int_set(&priv->lane_skips[selected], 0);
+    return evt;
+}
+
+static QueueEvent *
+EventQueue__pop_global(EventQueue * self){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    if(!g_atomic_int_get(&priv->pending_count)){
+        return NULL;
+    }
+    if(priv->ring_capacity){
+        return EventQueue__pop_ring(self);
+    }
+    P_MUTEX_LOCK(priv->pool_lock);
+    QueueEvent * evt = EventQueue__pop_ready_prelocked(priv);
+    P_MUTEX_UNLOCK(priv->pool_lock);
+    return evt;
+}
+
+static QueueEvent *
+EventQueue__pop_deque(EventQueuePrivate * priv, EventQueueDeque * deque, int owner){
+    if(!g_atomic_int_get(&deque->count)){
+        return NULL;
+    }
+    P_MUTEX_LOCK(deque->lock);
+    //The owner takes the most recent event while it is still hot in cache, thieves the oldest
+    QueueEventNode * node = (owner) ? QueueEventList__pop_tail(&deque->list) : QueueEventList__pop_head(&deque->list);
+    if(node){
+        g_atomic_int_add(&deque->count, -1);
+        g_atomic_int_add(&priv->pending_count, -1);
+        g_atomic_int_set(&node->running, 1);
+        g_atomic_int_inc(&priv->running_count);
+    }
+    P_MUTEX_UNLOCK(deque->lock);
+    return (node) ? node->evt : NULL;
+}
+
+static QueueEvent *
+EventQueue__steal(EventQueuePrivate * priv, EventQueueDeque * own){
+    int count = g_atomic_int_get(&priv->deque_count);
+    if(!count){
+        return NULL;
+    }
+    int start = ((guint) g_atomic_int_add(&priv->steal_seed, 1)) % count;
+    int i;
+    for(i=0;i<count;i++){
+        EventQueueDeque * victim = priv->deques[(start + i) % count];
+        if(victim == own){
+            continue;
+        }
+        QueueEvent * evt = EventQueue__pop_deque(priv, victim, FALSE);
+        if(evt){
+            return evt;
+        }
+    }
+    return NULL;
+}
+
+//Called on the worker thread when it starts
+static void
+EventQueue__acquire_deque(EventQueue * self){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    EventQueueDeque * deque = NULL;
+    int i;
+    P_MUTEX_LOCK(priv->threads_lock);
+    int count = g_atomic_int_get(&priv->deque_count);
+    for(i=0;i<count;i++){
+        if(!priv->deques[i]->in_use){
+            deque = priv->deques[i];
+            break;
+        }
+    }
+    if(!deque && count < EVENTQUEUE_MAX_DEQUES){
+        deque = g_new0(EventQueueDeque, 1);
+        QueueEventList__init(&deque->list);
+        P_MUTEX_SETUP(deque->lock);
+        deque->count = 0;
+        deque->queue = self;
+        priv->deques[count] = deque;
+        g_atomic_int_set(&priv->deque_count, count + 1); //Publish after the slot is initialized
+    }
+    if(deque){
+        deque->in_use = 1;
+    } else {
+        C_WARN("EventQueue worker started without local deque.");
+    }
+    P_MUTEX_UNLOCK(priv->threads_lock);
+    local_deque = deque;
+}
+
+//Called on the worker thread before it exits. Leftover events are handed back to the shared lanes.
+static void
+EventQueue__release_deque(EventQueue * self){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    EventQueueDeque * deque = local_deque;
+    QueueEventNode * node;
+    int moved = 0;
+    if(!deque){
+        return;
+    }
+    local_deque = NULL;
+
+    P_MUTEX_LOCK(priv->pool_lock);
+    P_MUTEX_LOCK(deque->lock);
+    while((node = QueueEventList__pop_head(&deque->list))){
+        QueueEventPriority lane = QueueEvent__get_priority(node->evt);
+        QueueEventList__push_tail(&priv->lanes[lane], node);
+        g_atomic_int_inc(&priv->lane_counts[lane]);
+        g_atomic_int_inc(&priv->lane_overflow[lane]);
+        g_atomic_int_add(&deque->count, -1);
+        moved++;
+    }
+    P_MUTEX_UNLOCK(deque->lock);
+    P_MUTEX_UNLOCK(priv->pool_lock);
+
+    P_MUTEX_LOCK(priv->threads_lock);
+    deque->in_use = 0;
+    P_MUTEX_UNLOCK(priv->threads_lock);
+
+    if(moved){
+        EventQueue__wake_workers(priv, moved);
+    }
+}
+
+static gboolean
+EventQueue__stats_dispatch(gpointer user_data){
+    EventQueue * self = QUEUE_EVENTQUEUE(user_data);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    //Cleared before sampling, so that a change made meanwhile schedules another update
+    g_atomic_int_set(&priv->stats_scheduled, 0);
+    //Totals across the pools
+    int running = 0;
+    int pending = 0;
+    int threads = 0;
+    int delayed = 0;
+    int pool;
+    int pool_count = g_atomic_int_get(&priv->pool_count);
+    for(pool=0;pool<pool_count;pool++){
+        EventQueuePrivate *pool_priv = EventQueue__get_instance_private (priv->pools[pool]);
+        running += g_atomic_int_get(&pool_priv->running_count);
+        pending += g_atomic_int_get(&pool_priv->pending_count);
+        threads += g_atomic_int_get(&pool_priv->thread_count);
+        delayed += g_atomic_int_get(&pool_priv->delayed_count);
+    }
+    g_signal_emit (self, signals[POOL_STATS], 0, running, pending, threads, delayed);
+    return G_SOURCE_REMOVE;
+}
+
+//At most one pool-stats update is scheduled per interval, however many changes happen meanwhile
+static void
+EventQueue__schedule_stats(EventQueue * self){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    if(g_atomic_int_get(&priv->stats_scheduled) || g_atomic_int_get(&priv->disposing)){
+        return;
+    }
+    if(!g_signal_has_handler_pending(self, signals[POOL_STATS], 0, TRUE)){
+        return;
+    }
+    if(g_atomic_int_compare_and_exchange(&priv->stats_scheduled, 0, 1)){
+        g_timeout_add_full(G_PRIORITY_DEFAULT_IDLE, g_atomic_int_get(&priv->stats_interval), EventQueue__stats_dispatch, g_object_ref(self), g_object_unref);
+    }
+}
+
+/*
+ * Per event signals and pool-changed are emitted synchronously on the calling thread,
+ * and only when a handler is connected. Consumers that only need counters should use pool-stats.
+ * Named pools emit through their owning queue, with the counters of the event's pool.
+ */
+static void 
+EventQueue__emit_signal(EventQueue * pool, QueueEvent * evt, QueueEventType type){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (pool);
+    EventQueue * self = EventQueue__root(pool);
+    int evt_signal = -1;
+
+    EventQueue__schedule_stats(self);
+
+    switch(type){
+        case EVENTQUEUE_DISPATCHED:
+            evt_signal = EVT_FINISHED;
+            break;
+        case EVENTQUEUE_CANCELLED:
+            evt_signal = EVT_CANCELLED;
+            break;
+        case EVENTQUEUE_DISPATCHING:
+            evt_signal = EVT_STARTED;
+            break;
+        case EVENTQUEUE_ADDED:
+            evt_signal = EVT_ADDED;
+            break;
+        case EVENTQUEUE_STARTED:
+        case EVENTQUEUE_FINISHED:
+        default:
+            break;
+    }
+
+    //A NULL event reports a batch through pool-changed. Its evt-added signals are emitted by the caller.
+    if(evt && evt_signal >= 0 && g_signal_has_handler_pending(self, signals[evt_signal], 0, TRUE)){
+        g_signal_emit (self, signals[evt_signal], 0, evt);
+    }
+
+    if(type == EVENTQUEUE_CANCELLED || !g_signal_has_handler_pending(self, signals[POOL_CHANGED], 0, TRUE)){
+        return;
+    }
+
+    int runcount = g_atomic_int_get(&priv->running_count);
+    int pendingcount = g_atomic_int_get(&priv->pending_count);
+    int threadcount = g_atomic_int_get(&priv->thread_count);
+    int lane = (evt) ? (int) QueueEvent__get_priority(evt) : -1;
+    g_signal_emit (self, signals[POOL_CHANGED], 0, type, runcount, pendingcount, threadcount, evt, lane);
+}
+
+void 
+EventQueue__set_stats_interval(EventQueue * self, int milliseconds){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    g_return_if_fail (milliseconds > 0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    g_atomic_int_set(&priv->stats_interval, milliseconds);
+}
+
+/*
+ * Put lock-free rings of the given capacity in front of the ready lanes, and park idle workers
+ * on a futex where available. Must be called before the queue is shared with other threads.
+ */
+void
+EventQueue__set_ready_ring(EventQueue * self, int capacity){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    g_return_if_fail (capacity > 0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    g_return_if_fail (!priv->ring_capacity);
+    g_return_if_fail (!g_atomic_int_get(&priv->thread_count) && !g_atomic_int_get(&priv->starting_count));
+    int lane;
+    for(lane=0;lane<QUEUEEVENT_PRIORITY_COUNT;lane++){
+        priv->rings[lane] = QueueRing__new(capacity);
+    }
+    priv->ring_capacity = QueueRing__get_capacity(priv->rings[0]);
+    C_INFO("EventQueue ready rings enabled. [%d events per lane]",priv->ring_capacity);
+}
+
+void
+EventQueue__set_capacity(EventQueue * self, int capacity, QueueEventOverflow policy){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    g_return_if_fail (capacity >= 0);
+    g_return_if_fail (policy >= 0 && policy < EVENTQUEUE_OVERFLOW_COUNT);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    g_atomic_int_set(&priv->bound.policy, policy);
+    g_atomic_int_set(&priv->bound.capacity, capacity);
+    C_INFO("EventQueue capacity [%d %s]",capacity,EventQueue__overflow_names[policy]);
+}
+
+void
+EventQueue__set_lane_capacity(EventQueue * self, QueueEventPriority lane, int capacity, QueueEventOverflow policy){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    g_return_if_fail (lane >= 0 && lane < QUEUEEVENT_PRIORITY_COUNT);
+    g_return_if_fail (capacity >= 0);
+    g_return_if_fail (policy >= 0 && policy < EVENTQUEUE_OVERFLOW_COUNT);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    g_atomic_int_set(&priv->lane_bounds[lane].policy, policy);
+    g_atomic_int_set(&priv->lane_bounds[lane].capacity, capacity);
+    C_INFO("EventQueue lane %d capacity [%d %s]",lane,capacity,EventQueue__overflow_names[policy]);
+}
+
+//Must be set before the queue is shared with other threads
+void
+EventQueue__set_reject_callback(EventQueue * self, QueueEventRejectCallback callback, void * reject_data){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    priv->reject_cb = callback;
+    priv->reject_data = reject_data;
+}
+
+int
+EventQueue__get_overflow_count(EventQueue * self, QueueEventOverflow policy){
+    g_return_val_if_fail (self != NULL, 0);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), 0);
+    g_return_val_if_fail (policy >= 0 && policy < EVENTQUEUE_OVERFLOW_COUNT, 0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    return g_atomic_int_get(&priv->overflow_counts[policy]);
+}
+
+/*
+ * Add a named pool with its own workers. Returns its id for QueueEventOptions.pool, or -1 on failure.
+ * Pools inherit the ready ring and stats interval of this queue. They are released with it.
+ */
+int
+EventQueue__add_pool(EventQueue * self, const char * name, int min_threads, int max_threads){
+    g_return_val_if_fail (self != NULL, -1);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), -1);
+    g_return_val_if_fail (name != NULL, -1);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    g_return_val_if_fail (priv->parent == NULL, -1);
+
+    P_MUTEX_LOCK(priv->threads_lock);
+    int id = priv->pool_count;
+    int pool;
+    for(pool=0;pool<priv->pool_count;pool++){
+        if(!strcmp(priv->pool_names[pool], name)){
+            id = -1;
+            break;
+        }
+    }
+    if(id < 0 || id >= EVENTQUEUE_MAX_POOLS){
+        P_MUTEX_UNLOCK(priv->threads_lock);
+        C_ERROR("Unable to add EventQueue pool '%s'",name);
+        return -1;
+    }
+
+    EventQueue * queue = EventQueue__new();
+    EventQueuePrivate *pool_priv = EventQueue__get_instance_private (queue);
+    pool_priv->parent = self;
+    g_free(pool_priv->pool_names[EVENTQUEUE_POOL_DEFAULT]);
+    pool_priv->pool_names[EVENTQUEUE_POOL_DEFAULT] = g_strdup(name);
+    pool_priv->stats_interval = g_atomic_int_get(&priv->stats_interval);
+    pool_priv->sched = priv->sched;
+    pool_priv->watchdog_threshold = g_atomic_int_get(&priv->watchdog_threshold);
+    pool_priv->watchdog_cancel = g_atomic_int_get(&priv->watchdog_cancel);
+    if(priv->ring_capacity && !pool_priv->ring_capacity){
+        EventQueue__set_ready_ring(queue, priv->ring_capacity);
+    }
+    priv->pools[id] = queue;
+    priv->pool_names[id] = g_strdup(name);
+    g_atomic_int_set(&priv->pool_count, id + 1);
+    P_MUTEX_UNLOCK(priv->threads_lock);
+
+    C_INFO("EventQueue pool '%s' added. [%d]",name,id);
+    EventQueue__set_pool_limits(queue, min_threads, max_threads);
+    return id;
+}
+
+int
+EventQueue__get_pool_id(EventQueue * self, const char * name){
+    g_return_val_if_fail (self != NULL, EVENTQUEUE_POOL_DEFAULT);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), EVENTQUEUE_POOL_DEFAULT);
+    g_return_val_if_fail (name != NULL, EVENTQUEUE_POOL_DEFAULT);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    int pool;
+    int pool_count = g_atomic_int_get(&priv->pool_count);
+    for(pool=0;pool<pool_count;pool++){
+        if(!strcmp(priv->pool_names[pool], name)){
+            return pool;
+        }
+    }
+    C_TRAIL("No EventQueue pool '%s'. Using the default pool.",name);
+    return EVENTQUEUE_POOL_DEFAULT;
+}
+
+EventQueue *
+EventQueue__get_pool(EventQueue * self, int pool){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), NULL);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    g_return_val_if_fail (pool >= 0 && pool < g_atomic_int_get(&priv->pool_count), NULL);
+    return priv->pools[pool];
+}
+
+int
+EventQueue__get_pool_count(EventQueue * self){
+    g_return_val_if_fail (self != NULL, 0);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), 0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    return g_atomic_int_get(&priv->pool_count);
+}
+
+const char *
+EventQueue__get_pool_name(EventQueue * self, int pool){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), NULL);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    g_return_val_if_fail (pool >= 0 && pool < g_atomic_int_get(&priv->pool_count), NULL);
+    return priv->pool_names[pool];
+}
+
+#ifdef EVENTQUEUE_HAS_BACKTRACE
+//Runs on the stuck worker. backtrace_symbols_fd doesn't allocate, unlike the logger.
+static void
+EventQueue__print_stack(int sig){
+    void * frames[EVENTQUEUE_WATCHDOG_FRAMES];
+    int count = backtrace(frames, EVENTQUEUE_WATCHDOG_FRAMES);
+    backtrace_symbols_fd(frames, count, STDERR_FILENO);
+}
+
+static GOnce stack_handler_once = G_ONCE_INIT;
+
+//Leaves the signal alone if the application already handles or ignores it
+static gpointer
+EventQueue__install_stack_handler(gpointer data){
+    void * frame;
+    struct sigaction action;
+    if(sigaction(EVENTQUEUE_WATCHDOG_SIGNAL, NULL, &action) || action.sa_handler != SIG_DFL){
+        C_WARN("EventQueue watchdog signal %d already in use. Stuck worker stacks won't be printed.",EVENTQUEUE_WATCHDOG_SIGNAL);
+        return GINT_TO_POINTER(FALSE);
+    }
+    //The first backtrace call loads libgcc, which isn't safe from a signal handler
+    backtrace(&frame, 1);
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = EventQueue__print_stack;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if(sigaction(EVENTQUEUE_WATCHDOG_SIGNAL, &action, NULL)){
+        return GINT_TO_POINTER(FALSE);
+    }
+    return GINT_TO_POINTER(TRUE);
+}
+#endif
+
+static void
+EventQueue__log_stalled(EventQueue * self, QueueThread * thread, QueueEvent * evt, int threshold){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    char * name = QueueMetrics__callback_name(QueueEvent__get_callback(evt));
+#ifdef EVENTQUEUE_HAS_BACKTRACE
+    if(GPOINTER_TO_INT(stack_handler_once.retval)){
+        C_WARN("EventQueue '%s' worker stuck for over %dms in %s [event %p]. Stack :",
+                priv->pool_names[EVENTQUEUE_POOL_DEFAULT], threshold, name, (void *) evt);
+        pthread_kill(QueueThread__get_thread(thread), EVENTQUEUE_WATCHDOG_SIGNAL);
+        g_free(name);
+        return;
+    }
+#endif
+    C_WARN("EventQueue '%s' worker stuck for over %dms in %s [event %p]",
+            priv->pool_names[EVENTQUEUE_POOL_DEFAULT], threshold, name, (void *) evt);
+    g_free(name);
+}
+
+/*
+ * Replace workers stuck on the same event past the watchdog threshold.
+ * The stuck worker is terminated, so it exits once its event returns instead of taking the next one.
+ * Replacements are capped at max threads, or the fixed pool size, so a callback that blocks
+ * every worker it lands on can't keep growing the process.
+ */
+static void
+EventQueue__watch_workers(EventQueue * self){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    int threshold = g_atomic_int_get(&priv->watchdog_threshold);
+    if(!threshold){
+        return;
+    }
+
+    gint64 since = g_get_monotonic_time() - threshold * G_TIME_SPAN_MILLISECOND;
+    GPtrArray * stuck = g_ptr_array_new(); //Pairs of thread and running event
+    QueueThread * thread;
+    int capped = FALSE;
+    P_MUTEX_LOCK(priv->threads_lock);
+    int cap = g_atomic_int_get(&priv->max_threads);
+    if(!cap){
+        cap = MAX((int) g_list_length(priv->threads) - g_atomic_int_get(&priv->stalled_count), 1);
+    }
+    GLIST_FOREACH(thread, priv->threads){
+        //Stalled workers are terminated too, like the ones leaving the pool
+        if(QueueThread__is_terminated(thread)){
+            continue;
+        }
+        if(g_atomic_int_get(&priv->stalled_count) >= cap){
+            capped = TRUE;
+            break;
+        }
+        QueueEvent * evt = QueueThread__ref_running(thread, since);
+        if(!evt){
+            continue;
+        }
+        QueueThread__terminate(thread);
+        g_hash_table_add(priv->stalled, thread);
+        g_atomic_int_inc(&priv->stalled_count);
+        g_ptr_array_add(stuck, g_object_ref(thread));
+        g_ptr_array_add(stuck, evt);
+    }
+    P_MUTEX_UNLOCK(priv->threads_lock);
+
+    if(!capped){
+        priv->stalled_capped = FALSE;
+    } else if(!priv->stalled_capped){
+        priv->stalled_capped = TRUE;
+        C_ERROR("EventQueue '%s' has %d stalled workers. No more will be replaced until one returns.",
+                priv->pool_names[EVENTQUEUE_POOL_DEFAULT], g_atomic_int_get(&priv->stalled_count));
+    }
+
+    guint i;
+    for(i=0;i<stuck->len;i+=2){
+        thread = g_ptr_array_index(stuck, i);
+        QueueEvent * evt = g_ptr_array_index(stuck, i+1);
+        EventQueue__log_stalled(self, thread, evt, threshold);
+        if(g_atomic_int_get(&priv->watchdog_cancel)){
+            QueueEvent__expire(evt);
+        }
+        EventQueue__start(self);
+        EventQueue__emit_signal(self, NULL, EVENTQUEUE_GROWN);
+        EventQueue__release_event(self, evt);
+        g_object_unref(thread);
+    }
+    g_ptr_array_free(stuck, TRUE);
+}
+
+//Join workers that exited without the whole pool stopping. Their pthread handles are kept until then.
+static void
+EventQueue__join_retired(EventQueue * self){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    P_MUTEX_LOCK(priv->threads_lock);
+    GList * retired = priv->retired;
+    priv->retired = NULL;
+    P_MUTEX_UNLOCK(priv->threads_lock);
+
+    GList * link;
+    for(link = retired; link; link = link->next){
+        P_THREAD_TYPE * pthread = (P_THREAD_TYPE *) link->data;
+        P_THREAD_JOIN(*pthread);
+        g_free(pthread);
+    }
+    g_list_free(retired);
+}
+
+/*
+ * Detach the current worker from the pool before it exits, so that the pool size is updated
+ * while the sleep lock is still held. The thread list owns a reference released by the worker on exit.
+ */
+static void
+EventQueue__retire_prelocked(EventQueue * self, QueueThread * thread){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    P_MUTEX_LOCK(priv->threads_lock);
+    GList * link = g_list_find(priv->threads, thread);
+    if(link){
+        priv->threads = g_list_delete_link(priv->threads, link);
+        g_atomic_int_add(&priv->thread_count, -1);
+        P_THREAD_TYPE * pthread = g_new(P_THREAD_TYPE, 1);
+        *pthread = QueueThread__get_thread(thread);
+        priv->retired = g_list_prepend(priv->retired, pthread);
+    }
+    P_MUTEX_UNLOCK(priv->threads_lock);
+    QueueThread__terminate(thread);
+}
+
+//Monotonic queued time of the oldest pending event, 0 when there is none
+static gint64
+EventQueue__oldest_pending_time(EventQueuePrivate * priv){
+    gint64 oldest = 0;
+    int lane;
+    int i;
+    P_MUTEX_LOCK(priv->pool_lock);
+    for(lane=0;lane<QUEUEEVENT_PRIORITY_COUNT;lane++){
+        QueueEventNode * head = priv->lanes[lane].head;
+        if(head && (!oldest || head->queued_time < oldest)){
+            oldest = head->queued_time;
+        }
+        gint64 ringed = (priv->rings[lane]) ? QueueRing__peek_time(priv->rings[lane]) : 0;
+        if(ringed && (!oldest || ringed < oldest)){
+            oldest = ringed;
+        }
+    }
+    P_MUTEX_UNLOCK(priv->pool_lock);
+
+    int count = g_atomic_int_get(&priv->deque_count);
+    for(i=0;i<count;i++){
+        EventQueueDeque * deque = priv->deques[i];
+        if(!g_atomic_int_get(&deque->count)){
+            continue;
+        }
+        P_MUTEX_LOCK(deque->lock);
+        QueueEventNode * head = deque->list.head;
+        if(head && (!oldest || head->queued_time < oldest)){
+            oldest = head->queued_time;
+        }
+        P_MUTEX_UNLOCK(deque->lock);
+    }
+    return oldest;
+}
+
+/*
+ * Grow the pool by one worker per tick while every worker is busy
+ * and the oldest pending event waited longer than the grow threshold.
+ * Blocking I/O keeps workers busy without using the CPU, so load is measured by waiting time.
+ */
+static gpointer
+EventQueue__monitor_thread(gpointer data){
+    EventQueue * self = QUEUE_EVENTQUEUE(data);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+
+    g_mutex_lock(&priv->monitor_lock);
+    while(priv->monitor_running){
+        gint64 threshold = priv->grow_threshold;
+        //Sample twice per threshold, so that an event never waits much longer than it
+        gint64 tick = CLAMP(threshold / 2, 10 * G_TIME_SPAN_MILLISECOND, G_TIME_SPAN_SECOND);
+        g_cond_wait_until(&priv->monitor_cond, &priv->monitor_lock, g_get_monotonic_time() + tick);
+        if(!priv->monitor_running){
+            break;
+        }
+        g_mutex_unlock(&priv->monitor_lock);
+
+        EventQueue__join_retired(self);
+
+        EventQueue__watch_workers(self);
+
+        //Stuck workers were already replaced, and don't count toward the limit
+        int size = g_atomic_int_get(&priv->thread_count) + g_atomic_int_get(&priv->starting_count)
+                    - g_atomic_int_get(&priv->stalled_count);
+        if(g_atomic_int_get(&priv->pending_count) 
+            && !g_atomic_int_get(&priv->idle_count)
+            && size < g_atomic_int_get(&priv->max_threads)){
+            gint64 oldest = EventQueue__oldest_pending_time(priv);
+            gint64 waited = (oldest) ? g_get_monotonic_time() - oldest : 0;
+            if(waited >= threshold){
+                C_INFO("EventQueue growing. Oldest event waited %" G_GINT64_FORMAT "ms [%d threads]",waited / G_TIME_SPAN_MILLISECOND, size + 1);
+                EventQueue__start(self);
+                EventQueue__emit_signal(self, NULL, EVENTQUEUE_GROWN);
+            }
+        }
+
+        g_mutex_lock(&priv->monitor_lock);
+    }
+    g_mutex_unlock(&priv->monitor_lock);
+    return NULL;
+}
+
+static void 
+EventQueue__stop_all_threads(EventQueue* self){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    P_MUTEX_LOCK(priv->threads_lock);
+    GList * childs = priv->threads;
+    QueueThread * thread;
+    int tlen = g_list_length(priv->threads);
+    P_THREAD_TYPE pthread_killed[tlen];
+    int index = 0;
+    for(;childs && (thread = childs->data, TRUE); childs = childs->next){
+        QueueThread__terminate(thread);
+        P_THREAD_TYPE pthread = QueueThread__get_thread(thread);
+        pthread_killed[index++] = pthread;
+    }
+    if(priv->threads){
+        g_list_free(priv->threads);
+        priv->threads = NULL;
+    }
+    g_atomic_int_set(&priv->thread_count, 0);
+    P_MUTEX_UNLOCK(priv->threads_lock);
+
+    //Notify sleeping thread
+    EventQueue__wake_all(priv);
+
+    //Thread resource clean up
+    for(index=0;index<tlen;index++){
+        P_THREAD_JOIN(pthread_killed[index]);
+    }
+    EventQueue__join_retired(self);
+}
+
+static void 
+EventQueue__dispose(GObject * obj){
+    EventQueue * queue = QUEUE_EVENTQUEUE(obj);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (queue);
+
+    //Scheduling pool-stats would take a new reference
+    g_atomic_int_set(&priv->disposing, 1);
+
+    //Blocked producers stop waiting for room
+    g_mutex_lock(&priv->room_lock);
+    g_cond_broadcast(&priv->room_cond);
+    g_mutex_unlock(&priv->room_lock);
+
+    //Pool workers resolve dependencies and emit signals through this queue, so they go first
+    int pool;
+    for(pool=EVENTQUEUE_POOL_DEFAULT+1;pool<priv->pool_count;pool++){
+        g_object_unref(priv->pools[pool]);
+        priv->pools[pool] = NULL;
+    }
+    for(pool=0;pool<EVENTQUEUE_MAX_POOLS;pool++){
+        g_free(priv->pool_names[pool]);
+        priv->pool_names[pool] = NULL;
+    }
+    priv->pool_count = 0;
+
+    //Stop growing the pool before shutting it down
+    if(priv->monitor){
+        g_mutex_lock(&priv->monitor_lock);
+        priv->monitor_running = 0;
+        g_cond_signal(&priv->monitor_cond);
+        g_mutex_unlock(&priv->monitor_lock);
+        g_thread_join(priv->monitor);
+        priv->monitor = NULL;
+    }
+
+    //Thread cleanup
+    EventQueue__stop_all_threads(queue);
+
+    //Workers are gone, so periodic events can't be rescheduled anymore.
+    //Events still held by the timer heap are released as cancelled.
+    if(priv->timer_thread){
+        g_mutex_lock(&priv->timer_lock);
+        priv->timer_running = 0;
+        g_cond_signal(&priv->timer_cond);
+        g_mutex_unlock(&priv->timer_lock);
+        g_thread_join(priv->timer_thread);
+        priv->timer_thread = NULL;
+    }
+    if(priv->timers){
+        while(priv->timers->len){
+            QueueEvent * evt = g_ptr_array_index(priv->timers, 0);
+            EventQueue__timer_remove_prelocked(priv, QueueEvent__get_node(evt));
+            QueueEvent__set_notify(evt, NULL, NULL);
+            QueueEvent__try_cancel(evt);
+            g_object_unref(evt);
+        }
+        g_ptr_array_free(priv->timers, TRUE);
+        priv->timers = NULL;
+    }
+    if(priv->deadlines){
+        //Only running events are tracked, and workers are gone
+        g_ptr_array_free(priv->deadlines, TRUE);
+        priv->deadlines = NULL;
+    }
+
+    if(priv->metrics_dump){
+        g_object_unref(priv->metrics_dump);
+        priv->metrics_dump = NULL;
+    }
+
+    if(priv->stalled){
+        g_hash_table_destroy(priv->stalled);
+        priv->stalled = NULL;
+    }
+
+    //Workers are gone, so nothing resolves dependencies anymore
+    if(priv->dependents){
+        GHashTableIter iter;
+        gpointer key;
+        gpointer value;
+        g_hash_table_iter_init(&iter, priv->dependents);
+        while(g_hash_table_iter_next(&iter, &key, &value)){
+            GPtrArray * links = value;
+            guint i;
+            for(i=0;i<links->len;i++){
+                EventQueueJoin * join = g_ptr_array_index(links, i);
+                if(g_atomic_int_dec_and_test(&join->refs)){
+                    g_object_unref(join->evt);
+                    g_free(join);
+                }
+            }
+            g_ptr_array_free(links, TRUE);
+            g_object_unref(key);
+        }
+        g_hash_table_destroy(priv->dependents);
+        priv->dependents = NULL;
+        priv->dependents_count = 0;
+    }
+    QueueEventNode * blocked_node;
+    while((blocked_node = QueueEventList__pop_head(&priv->blocked))){
+        QueueEvent__set_notify(blocked_node->evt, NULL, NULL);
+        QueueEvent__try_cancel(blocked_node->evt);
+        g_object_unref(blocked_node->evt);
+    }
+
+    QueueEventNode * free_node;
+    while((free_node = QueueEventList__pop_head(&priv->free_events))){
+        g_object_unref(free_node->evt);
+    }
+
+    //TODO Cancel pending event for clean up
+    int lane;
+    for(lane=0;lane<QUEUEEVENT_PRIORITY_COUNT;lane++){
+        if(priv->rings[lane]){
+            //Only the cell references are dropped, like the lanes below
+            QueueEventNode * node;
+            while((node = QueueRing__pop(priv->rings[lane]))){
+                g_object_unref(node->evt);
+            }
+            QueueRing__destroy(priv->rings[lane]);
+            priv->rings[lane] = NULL;
+        }
+        QueueEventList__init(&priv->lanes[lane]);
+        priv->lane_skips[lane] = 0;
+        g_atomic_int_set(&priv->lane_counts[lane], 0);
+        g_atomic_int_set(&priv->lane_overflow[lane], 0);
+    }
+    g_atomic_int_set(&priv->pending_count, 0);
+
+    //Nothing to cancel here, since threads are all dead
+    g_atomic_int_set(&priv->running_count, 0);
+
+    int i;
+    for(i=0;i<priv->deque_count;i++){
+        P_MUTEX_CLEANUP(priv->deques[i]->lock);
+        g_free(priv->deques[i]);
+        priv->deques[i] = NULL;
+    }
+    priv->deque_count = 0;
+
+    if(priv->scopes){
+        g_hash_table_destroy(priv->scopes);
+        priv->scopes = NULL;
+    }
+
+    g_cond_clear(&priv->sleep_cond);
+    g_mutex_clear(&priv->sleep_lock);
+    g_cond_clear(&priv->monitor_cond);
+    g_mutex_clear(&priv->monitor_lock);
+    g_cond_clear(&priv->timer_cond);
+    g_mutex_clear(&priv->timer_lock);
+    g_cond_clear(&priv->room_cond);
+    g_mutex_clear(&priv->room_lock);
+    P_MUTEX_CLEANUP(priv->pool_lock);
+    P_MUTEX_CLEANUP(priv->scope_lock);
+    P_MUTEX_CLEANUP(priv->threads_lock);
+    P_MUTEX_CLEANUP(priv->signal_lock);
+    P_MUTEX_CLEANUP(priv->free_lock);
+    P_MUTEX_CLEANUP(priv->deps_lock);
+
+    QueueMetrics__destroy(priv->metrics);
+    priv->metrics = NULL;
+
+    G_OBJECT_CLASS (EventQueue__parent_class)->dispose (obj);
+}
+
+static void
+EventQueue__class_init (EventQueueClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = EventQueue__dispose;
+
+    GType params[6];
+    params[0] = QUEUE_TYPE_EVENTTYPE | G_SIGNAL_TYPE_STATIC_SCOPE;
+    params[1] = G_TYPE_INT | G_SIGNAL_TYPE_STATIC_SCOPE;
+    params[2] = G_TYPE_INT | G_SIGNAL_TYPE_STATIC_SCOPE;
+    params[3] = G_TYPE_INT | G_SIGNAL_TYPE_STATIC_SCOPE;
+    params[4] = QUEUE_TYPE_QUEUEEVENT | G_SIGNAL_TYPE_STATIC_SCOPE;
+    params[5] = G_TYPE_INT | G_SIGNAL_TYPE_STATIC_SCOPE; //QueueEventPriority lane of the event, -1 without event
+    signals[POOL_CHANGED] =
+        g_signal_newv ("pool-changed",
+                        G_TYPE_FROM_CLASS (klass),
+                        G_SIGNAL_RUN_LAST | G_SIGNAL_NO_HOOKS,
+                        NULL /* closure */,
+                        NULL /* accumulator */,
+                        NULL /* accumulator data */,
+                        NULL /* C marshaller */,
+                        G_TYPE_NONE /* return_type */,
+                        6     /* n_params */,
+                        params  /* param_types */);
+    
+    //Running, pending, threads and delayed counters, coalesced and emitted on the main context
+    params[0] = G_TYPE_INT;
+    params[1] = G_TYPE_INT;
+    params[2] = G_TYPE_INT;
+    params[3] = G_TYPE_INT;
+    signals[POOL_STATS] =
+        g_signal_newv ("pool-stats",
+                        G_TYPE_FROM_CLASS (klass),
+                        G_SIGNAL_RUN_LAST | G_SIGNAL_NO_HOOKS,
+                        NULL /* closure */,
+                        NULL /* accumulator */,
+                        NULL /* accumulator data */,
+                        NULL /* C marshaller */,
+                        G_TYPE_NONE /* return_type */,
+                        4     /* n_params */,
+                        params  /* param_types */);
+
+    params[0] = QUEUE_TYPE_QUEUEEVENT | G_SIGNAL_TYPE_STATIC_SCOPE;
+    signals[EVT_ADDED] =
+        g_signal_newv ("evt-added",
+                        G_TYPE_FROM_CLASS (klass),
+                        G_SIGNAL_RUN_LAST | G_SIGNAL_NO_HOOKS,
+                        NULL /* closure */,
+                        NULL /* accumulator */,
+                        NULL /* accumulator data */,
+                        NULL /* C marshaller */,
+                        G_TYPE_NONE /* return_type */,
+                        1     /* n_params */,
+                        params  /* param_types */);
+
+    signals[EVT_STARTED] =
+        g_signal_newv ("evt-started",
+                        G_TYPE_FROM_CLASS (klass),
+                        G_SIGNAL_RUN_LAST | G_SIGNAL_NO_HOOKS,
+                        NULL /* closure */,
+                        NULL /* accumulator */,
+                        NULL /* accumulator data */,
+                        NULL /* C marshaller */,
+                        G_TYPE_NONE /* return_type */,
+                        1     /* n_params */,
+                        params  /* param_types */);
+
+    signals[EVT_FINISHED] =
+        g_signal_newv ("evt-finished",
+                        G_TYPE_FROM_CLASS (klass),
+                        G_SIGNAL_RUN_LAST | G_SIGNAL_NO_HOOKS,
+                        NULL /* closure */,
+                        NULL /* accumulator */,
+                        NULL /* accumulator data */,
+                        NULL /* C marshaller */,
+                        G_TYPE_NONE /* return_type */,
+                        1     /* n_params */,
+                        params  /* param_types */);
+
+    signals[EVT_CANCELLED] =
+        g_signal_newv ("evt-cancelled",
+                        G_TYPE_FROM_CLASS (klass),
+                        G_SIGNAL_RUN_LAST | G_SIGNAL_NO_HOOKS,
+                        NULL /* closure */,
+                        NULL /* accumulator */,
+                        NULL /* accumulator data */,
+                        NULL /* C marshaller */,
+                        G_TYPE_NONE /* return_type */,
+                        1     /* n_params */,
+                        params  /* param_types */);
+    
+}
+
+static void 
+EventQueue__init(EventQueue* self) {
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+
+    priv->threads = NULL;
+    int lane;
+    for(lane=0;lane<QUEUEEVENT_PRIORITY_COUNT;lane++){
+        QueueEventList__init(&priv->lanes[lane]);
+        priv->lane_skips[lane] = 0;
+        priv->lane_counts[lane] = 0;
+        priv->lane_overflow[lane] = 0;
+    }
+    priv->scopes = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    priv->deque_count = 0;
+    priv->steal_seed = 0;
+    for(lane=0;lane<QUEUEEVENT_PRIORITY_COUNT;lane++){
+        priv->rings[lane] = NULL;
+    }
+    priv->ring_capacity = 0;
+    priv->park_seq = 0;
+    priv->pending_count = 0;
+    priv->running_count = 0;
+    priv->thread_count = 0;
+    priv->idle_count = 0;
+
+    priv->starting_count = 0;
+    priv->min_threads = 0;
+    priv->max_threads = 0;
+    priv->grow_threshold = EVENTQUEUE_DEFAULT_GROW_THRESHOLD * G_TIME_SPAN_MILLISECOND;
+    priv->idle_timeout = EVENTQUEUE_DEFAULT_IDLE_TIMEOUT * G_TIME_SPAN_MILLISECOND;
+    priv->monitor = NULL;
+    priv->monitor_running = 0;
+    priv->retired = NULL;
+    priv->watchdog_threshold = 0;
+    priv->watchdog_cancel = FALSE;
+    priv->stalled = g_hash_table_new(g_direct_hash, g_direct_equal);
+    priv->stalled_count = 0;
+    priv->stalled_capped = FALSE;
+    priv->timers = g_ptr_array_new();
+    priv->deadlines = g_ptr_array_new();
+    priv->delayed_count = 0;
+    priv->timer_thread = NULL;
+    priv->timer_running = 0;
+    priv->stats_interval = EVENTQUEUE_DEFAULT_STATS_INTERVAL;
+    priv->stats_scheduled = 0;
+    priv->disposing = 0;
+    QueueEventList__init(&priv->free_events);
+    QueueEventList__init(&priv->blocked);
+    priv->dependents = g_hash_table_new(g_direct_hash, g_direct_equal);
+    priv->dependents_count = 0;
+    priv->metrics = QueueMetrics__new();
+    priv->metrics_dump = NULL;
+    int pool;
+    for(pool=0;pool<EVENTQUEUE_MAX_POOLS;pool++){
+        priv->pools[pool] = NULL;
+        priv->pool_names[pool] = NULL;
+    }
+    priv->pools[EVENTQUEUE_POOL_DEFAULT] = self;
+    priv->pool_names[EVENTQUEUE_POOL_DEFAULT] = g_strdup("default");
+    priv->pool_count = 1;
+    priv->parent = NULL;
+    priv->sched = (ThreadSched) THREAD_SCHED_INIT;
+    priv->sched_seq = 0;
+    priv->thread_serial = 0;
+    priv->bound.capacity = 0;
+    priv->bound.policy = EVENTQUEUE_OVERFLOW_BLOCK;
+    for(lane=0;lane<QUEUEEVENT_PRIORITY_COUNT;lane++){
+        priv->lane_bounds[lane].capacity = 0;
+        priv->lane_bounds[lane].policy = EVENTQUEUE_OVERFLOW_BLOCK;
+    }
+    int policy;
+    for(policy=0;policy<EVENTQUEUE_OVERFLOW_COUNT;policy++){
+        priv->overflow_counts[policy] = 0;
+    }
+    priv->reject_cb = NULL;
+    priv->reject_data = NULL;
+    priv->room_waiters = 0;
+
+    g_cond_init(&priv->sleep_cond);
+    g_mutex_init(&priv->sleep_lock);
+    g_cond_init(&priv->monitor_cond);
+    g_mutex_init(&priv->monitor_lock);
+    g_cond_init(&priv->timer_cond);
+    g_mutex_init(&priv->timer_lock);
+    g_cond_init(&priv->room_cond);
+    g_mutex_init(&priv->room_lock);
+    P_MUTEX_SETUP(priv->pool_lock);
+    P_MUTEX_SETUP(priv->scope_lock);
+    P_MUTEX_SETUP(priv->threads_lock);
+    P_MUTEX_SETUP(priv->signal_lock);
+    P_MUTEX_SETUP(priv->free_lock);
+    P_MUTEX_SETUP(priv->deps_lock);
+
+    if(EVENTQUEUE_READY_RING_CAPACITY > 0){
+        EventQueue__set_ready_ring(self, EVENTQUEUE_READY_RING_CAPACITY);
+    }
+}
+
+EventQueue* 
+EventQueue__new() {
+    return g_object_new (QUEUE_TYPE_EVENTQUEUE, NULL);
+}
+
+int 
+EventQueue__get_thread_count(EventQueue * self){
+    g_return_val_if_fail (self != NULL,0);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self),0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    return g_atomic_int_get(&priv->thread_count);
+}
+
+int 
+EventQueue__get_pending_count(EventQueue * self){
+    g_return_val_if_fail (self != NULL,0);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self),0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    return g_atomic_int_get(&priv->pending_count);
+}
+
+int 
+EventQueue__get_lane_pending_count(EventQueue * self, QueueEventPriority priority){
+    g_return_val_if_fail (self != NULL,0);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self),0);
+    g_return_val_if_fail (priority >= 0 && priority < QUEUEEVENT_PRIORITY_COUNT,0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    return g_atomic_int_get(&priv->lane_counts[priority]);
+}
+
+int 
+EventQueue__get_running_count(EventQueue * self){
+    g_return_val_if_fail (self != NULL,0);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self),0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    return g_atomic_int_get(&priv->running_count);
+}
+
+int 
+EventQueue__get_delayed_count(EventQueue * self){
+    g_return_val_if_fail (self != NULL,0);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self),0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    return g_atomic_int_get(&priv->delayed_count);
+}
+
+void 
+EventQueue__stop(EventQueue* self, int nthread){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    P_MUTEX_LOCK(priv->threads_lock);
+    int cancelled_count = 0;
+    GList * childs = priv->threads;
+    QueueThread * thread;
+    for(;childs && (thread = childs->data, TRUE); childs = childs->next){
+        if(cancelled_count == nthread){
+            break;
+        }
+        if(!QueueThread__is_terminated(thread)){
+            QueueThread__terminate(thread);
+            cancelled_count++;
+        }
+    }
+    P_MUTEX_UNLOCK(priv->threads_lock);
+
+    //Notify thread if it's sleeping
+    EventQueue__wake_all(priv);
+}
+
+static void EventQueue__resolve_dependents(EventQueue * self, QueueEvent * evt, int dispatched);
+
+static void 
+EventQueue__evt_state_changed_cb(QueueEvent * evt, QueueEventState state, void * user_data){
+    EventQueue * self = QUEUE_EVENTQUEUE(user_data);
     EventQueuePrivate *priv = EventQueue__get_instance_private (self);
     QueueEventType evt_type;
     switch(state){
@@ -293,58 +1976,965 @@ EventQueue__evt_state_changed_cb(QueueEvent * queue, QueueEventState state, Even
             return;
     }
 
-    P_MUTEX_LOCK(priv->pool_lock);
-    priv->running_events = g_list_remove(priv->running_events, QueueEvent__get_current());
-    EventQueue__emit_signal_prelocked(self, QueueEvent__get_current(), evt_type);
+    QueueEventNode * node = QueueEvent__get_node(evt);
+    if(state == QUEUEEVENT_DISPATCHED && QueueEvent__get_timeout(evt)){
+        EventQueue__disarm_deadline(self, evt);
+    }
+    if(state == QUEUEEVENT_DISPATCHED && node->dispatch_time){
+        gint64 now = g_get_monotonic_time();
+        QueueMetrics__record(priv->metrics, QueueEvent__get_callback(evt), QueueEvent__get_scope(evt), node->dispatch_time - node->queued_time, now - node->dispatch_time);
+        node->dispatch_time = 0;
+    }
+
+    P_MUTEX_LOCK(priv->scope_lock);
+    //A pending event cancelled directly stays queued until popped.
+    //A running event is already unlinked if its scope was cancelled.
+    //A running event cancelled directly is accounted for once its callback returns.
+    int woken = 0;
+    if(state == QUEUEEVENT_DISPATCHED && g_atomic_int_get(&node->running) && QueueEvent__get_scope_node(evt)->list){
+        g_atomic_int_add(&priv->running_count, -1);
+        if(QueueEvent__get_flags(evt) & QUEUEEVENT_FLAG_STRAND){
+            woken = EventQueue__strand_release_prelocked(priv, EventQueue__scope_entry(evt));
+        }
+        gint64 interval = QueueEvent__get_interval(evt);
+        if(interval && !QueueEvent__is_cancelled(evt)){
+            //Periodic event stays indexed under its scope until the next run
+            g_atomic_int_set(&node->running, 0);
+            g_object_ref(evt); //The worker releases its reference after dispatch
+            EventQueue__schedule_prelocked(self, evt, g_get_monotonic_time() + interval);
+        } else {
+            EventQueue__scope_unlink_prelocked(priv, evt);
+        }
+    }
+    P_MUTEX_UNLOCK(priv->scope_lock);
+    if(woken){
+        EventQueue__wake_workers(priv, 1);
+    }
+    EventQueue__emit_signal(self, evt, evt_type);
+
+    //A run cut short by a cancellation was already reported as cancelled
+    EventQueue__resolve_dependents(self, evt, state == QUEUEEVENT_DISPATCHED && !QueueEvent__is_cancelled(evt));
+}
+
+//Pending one time event of this scope running the same callback
+static QueueEvent *
+EventQueue__find_pending_prelocked(EventQueuePrivate * priv, void * scope, QueueEventCallback callback){
+    EventQueueScope * entry = g_hash_table_lookup(priv->scopes, scope);
+    if(!entry){
+        return NULL;
+    }
+    QueueEventNode * scope_node;
+    for(scope_node = entry->events.head; scope_node; scope_node = scope_node->next){
+        QueueEvent * evt = scope_node->evt;
+        QueueEventNode * node = QueueEvent__get_node(evt);
+        if(!g_atomic_int_get(&node->running) && g_atomic_pointer_get(&node->list)
+            && QueueEvent__get_callback(evt) == callback
+            && !QueueEvent__get_interval(evt)
+            && !QueueEvent__is_cancelled(evt)){
+            return evt;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Take a pending event out of the queue and its scope.
+ * A ready strand event holds its strand, so the next one is released, and woken is raised if it became ready.
+ * Returns FALSE if a worker popped the event meanwhile. It is then running and left as is.
+ */
+static int
+EventQueue__unqueue_prelocked(EventQueuePrivate * priv, QueueEvent * evt, int * woken){
+    EventQueueScope * entry = EventQueue__scope_entry(evt);
+    QueueEventNode * node = QueueEvent__get_node(evt);
+    if(node->list == &entry->strand_waiting){
+        QueueEventList__remove(&entry->strand_waiting, node);
+    } else if(node->list == &priv->blocked){
+        QueueEventList__remove(&priv->blocked, node);
+    } else {
+        int delayed = node->list == &priv->timers; //Stable while scope_lock is held
+        if(!EventQueue__remove_ready(priv, evt)){
+            return FALSE;
+        }
+        if(!delayed && (QueueEvent__get_flags(evt) & QUEUEEVENT_FLAG_STRAND)){
+            *woken += EventQueue__strand_release_prelocked(priv, entry);
+        }
+    }
+    EventQueue__scope_unlink_prelocked(priv, evt);
+    return TRUE;
+}
+
+/*
+ * Whether a ready insert adds an event to the lanes, so that it goes through the overflow policy.
+ * Coalescing into a pending event doesn't, nor does replacing one that already holds a slot.
+ * Decided before the record is made, so a concurrent pop or insert can still overshoot by one.
+ */
+static int
+EventQueue__takes_slot(EventQueuePrivate * priv, const QueueEventOptions * options, void * scope, QueueEventCallback callback){
+    if(options->coalesce == EVENTQUEUE_COALESCE_NONE || options->interval){
+        return TRUE;
+    }
+    int slot = TRUE;
+    P_MUTEX_LOCK(priv->scope_lock);
+    QueueEvent * pending = EventQueue__find_pending_prelocked(priv, scope, callback);
+    if(pending){
+        //Timers and blocked events are moved under scope_lock only, unlike ready ones
+        gpointer list = g_atomic_pointer_get(&QueueEvent__get_node(pending)->list);
+        slot = options->coalesce != EVENTQUEUE_COALESCE_KEEP_FIRST
+                && (list == &priv->timers || list == &priv->blocked);
+    }
+    P_MUTEX_UNLOCK(priv->scope_lock);
+    return slot;
+}
+
+static void EventQueue_to_notify(QueueEvent * evt, EventQueue * self);
+
+//Reuse a finished record when one is available
+static QueueEvent *
+EventQueue__acquire_event(EventQueuePrivate * priv, void * scope, QueueEventPriority priority, QueueEventCallback callback, QueueEventCleanupCallback cleanup_cb, void * user_data, int managed){
+    P_MUTEX_LOCK(priv->free_lock);
+    QueueEventNode * node = QueueEventList__pop_head(&priv->free_events);
+    P_MUTEX_UNLOCK(priv->free_lock);
+    if(!node){
+        return QueueEvent__new(scope, priority, callback, cleanup_cb, user_data, managed);
+    }
+    QueueEvent__reuse(node->evt, scope, priority, callback, cleanup_cb, user_data, managed);
+    return node->evt;
+}
+
+/*
+ * Drop a reference to an event handed out by the queue.
+ * The last reference returns the record to the free list instead of finalizing it,
+ * unless external listeners are still attached to it.
+ */
+void
+EventQueue__release_event(EventQueue * self, QueueEvent * evt){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    g_return_if_fail (evt != NULL);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+
+    if(g_atomic_int_get(&priv->disposing) || !QueueEvent__recycle(evt)){
+        g_object_unref(evt);
+        return;
+    }
+
+    P_MUTEX_LOCK(priv->free_lock);
+    if(priv->free_events.length < EVENTQUEUE_MAX_FREE_EVENTS){
+        QueueEventList__push_tail(&priv->free_events, QueueEvent__get_node(evt));
+        evt = NULL;
+    }
+    P_MUTEX_UNLOCK(priv->free_lock);
+    if(evt){
+        g_object_unref(evt);
+    }
+}
+
+//Release the data of an event refused before a record was made for it
+static void
+EventQueue__discard(void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data), int managed){
+    if(cleanup_cb){
+        cleanup_cb(NULL, 1,user_data);
+    }
+    if(managed){
+        g_object_unref(G_OBJECT(user_data));
+    }
+}
+
+//Overload is logged as the count of each policy reaches a power of two, instead of once per event
+static void
+EventQueue__count_overflow(EventQueuePrivate * priv, QueueEventOverflow policy){
+    int count = g_atomic_int_add(&priv->overflow_counts[policy], 1) + 1;
+    if(!(count & (count - 1))){
+        C_WARN("EventQueue '%s' overloaded. [%s : %d]",priv->pool_names[EVENTQUEUE_POOL_DEFAULT],EventQueue__overflow_names[policy],count);
+    }
+}
+
+//Whether pending plus extra events reach the capacity. An empty queue always takes the next event.
+static int
+EventQueue__bound_full(EventQueueBound * bound, gint * pending_count, int extra){
+    int capacity = g_atomic_int_get(&bound->capacity);
+    if(!capacity){
+        return FALSE;
+    }
+    int pending = g_atomic_int_get(pending_count);
+    return pending > 0 && pending + extra >= capacity;
+}
+
+/*
+ * Oldest ready event of a lane, taken out of the lane but still linked under its scope. The caller holds scope_lock.
+ * Ringed events come first, since the lane only takes the ring overflow.
+ * Stale cells of cancelled events are returned through stale, to be released without the lock.
+ */
+static QueueEvent *
+EventQueue__take_oldest_prelocked(EventQueuePrivate * priv, int lane, GList ** stale){
+    QueueRing * ring = priv->rings[lane];
+    QueueEventNode * node;
+    if(ring){
+        while((node = QueueRing__pop(ring))){
+            if(g_atomic_pointer_compare_and_exchange(&node->list, ring, NULL)){
+                g_atomic_int_add(&priv->lane_counts[lane], -1);
+                g_atomic_int_add(&priv->pending_count, -1);
+                g_object_unref(node->evt); //Cell reference. The queue still holds its own.
+                return node->evt;
+            }
+            *stale = g_list_prepend(*stale, node->evt);
+        }
+    }
+    P_MUTEX_LOCK(priv->pool_lock);
+    node = QueueEventList__pop_head(&priv->lanes[lane]);
+    if(node){
+        g_atomic_int_add(&priv->lane_counts[lane], -1);
+        g_atomic_int_add(&priv->lane_overflow[lane], -1);
+        g_atomic_int_add(&priv->pending_count, -1);
+    }
+    P_MUTEX_UNLOCK(priv->pool_lock);
+    return (node) ? node->evt : NULL;
+}
+
+//Cancel the oldest ready event of a lane, or of the lowest non-empty lane when lane is -1. Returns FALSE if there is none.
+static int
+EventQueue__drop_oldest(EventQueue * self, int lane){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    QueueEvent * victim = NULL;
+    GList * stale = NULL;
+    int woken = 0;
+    int first = (lane < 0) ? QUEUEEVENT_PRIORITY_COUNT - 1 : lane;
+    int last = (lane < 0) ? 0 : lane;
+
+    P_MUTEX_LOCK(priv->scope_lock);
+    for(lane=first;lane>=last && !victim;lane--){
+        victim = EventQueue__take_oldest_prelocked(priv, lane, &stale);
+    }
+    if(victim){
+        //A ready strand event holds its strand
+        if(QueueEvent__get_flags(victim) & QUEUEEVENT_FLAG_STRAND){
+            woken = EventQueue__strand_release_prelocked(priv, EventQueue__scope_entry(victim));
+        }
+        EventQueue__scope_unlink_prelocked(priv, victim);
+    }
+    P_MUTEX_UNLOCK(priv->scope_lock);
+
+    QueueEvent * evt;
+    GLIST_FOREACH(evt, stale){
+        EventQueue__release_event(self, evt);
+    }
+    g_list_free(stale);
+    if(woken){
+        EventQueue__wake_workers(priv, 1);
+    }
+    if(!victim){
+        return FALSE;
+    }
+
+    C_TRAIL("Dropping oldest pending event...");
+    QueueEvent__try_cancel(victim);
+    EventQueue_to_notify(victim, self);
+    return TRUE;
+}
+
+/*
+ * Apply the overflow policy before an event is queued in a lane.
+ * Only the ready lanes are measured. Strand waiters, blocked dependents and timers aren't, see EventQueue__set_capacity.
+ * Extra counts the events of the same batch admitted before this one.
+ * Returns FALSE if the event is refused, in which case the caller discards it.
+ */
+static int
+EventQueue__admit(EventQueue * self, QueueEventPriority lane, int extra, void * scope, void * user_data){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    int waited = FALSE;
+    for(;;){
+        EventQueueBound * bound;
+        int victim_lane = lane;
+        if(EventQueue__bound_full(&priv->lane_bounds[lane], &priv->lane_counts[lane], extra)){
+            bound = &priv->lane_bounds[lane];
+        } else if(EventQueue__bound_full(&priv->bound, &priv->pending_count, extra)){
+            bound = &priv->bound;
+            victim_lane = -1;
+        } else {
+            return TRUE;
+        }
+
+        switch(g_atomic_int_get(&bound->policy)){
+            case EVENTQUEUE_OVERFLOW_BLOCK:
+                //A worker waiting on a queue could be the one expected to make room
+                if(local_deque || g_atomic_int_get(&priv->disposing)){
+                    return TRUE;
+                }
+                if(!waited){
+                    waited = TRUE;
+                    EventQueue__count_overflow(priv, EVENTQUEUE_OVERFLOW_BLOCK);
+                }
+                //Polled as well, since cancellations make room without signalling
+                g_mutex_lock(&priv->room_lock);
+                g_atomic_int_inc(&priv->room_waiters);
+                if(EventQueue__bound_full(bound, (bound == &priv->bound) ? &priv->pending_count : &priv->lane_counts[lane], extra)){
+                    g_cond_wait_until(&priv->room_cond, &priv->room_lock, g_get_monotonic_time() + EVENTQUEUE_ROOM_POLL * G_TIME_SPAN_MILLISECOND);
+                }
+                g_atomic_int_add(&priv->room_waiters, -1);
+                g_mutex_unlock(&priv->room_lock);
+                break;
+            case EVENTQUEUE_OVERFLOW_REJECT:
+                EventQueue__count_overflow(priv, EVENTQUEUE_OVERFLOW_REJECT);
+                if(priv->reject_cb){
+                    priv->reject_cb(EventQueue__root(self), lane, scope, user_data, priv->reject_data);
+                }
+                return FALSE;
+            case EVENTQUEUE_OVERFLOW_DROP_OLDEST:
+                if(EventQueue__drop_oldest(self, victim_lane)){
+                    EventQueue__count_overflow(priv, EVENTQUEUE_OVERFLOW_DROP_OLDEST);
+                    break;
+                }
+                //Only events of the same batch are ahead
+                EventQueue__count_overflow(priv, EVENTQUEUE_OVERFLOW_DROP_NEWEST);
+                return FALSE;
+            case EVENTQUEUE_OVERFLOW_DROP_NEWEST:
+            default:
+                EventQueue__count_overflow(priv, EVENTQUEUE_OVERFLOW_DROP_NEWEST);
+                return FALSE;
+        }
+    }
+}
+
+//Apply the insertion options to a fresh record, before it is published
+static void
+EventQueue__prepare_event(EventQueue * self, QueueEvent * record, const QueueEventOptions * options){
+    QueueEvent__set_notify(record, EventQueue__evt_state_changed_cb, self);
+    if(options->flags){
+        QueueEvent__set_flags(record, options->flags);
+    }
+    if(options->interval){
+        QueueEvent__set_interval(record, options->interval * G_TIME_SPAN_MILLISECOND);
+    }
+    if(options->timeout){
+        QueueEvent__set_timeout(record, options->timeout * G_TIME_SPAN_MILLISECOND);
+    }
+}
+
+static void EventQueue__cascade_cancel(EventQueue * self, QueueEvent * evt);
+
+/*
+ * The antecedents of a blocked event are satisfied.
+ * It goes through the overflow policy like any event entering a lane, and is cancelled if refused.
+ */
+static void
+EventQueue__unblock(EventQueue * self, QueueEvent * evt){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    QueueEventNode * node = QueueEvent__get_node(evt);
+    int ready = 0;
+    if(!EventQueue__admit(self, QueueEvent__get_priority(evt), 0, QueueEvent__get_scope(evt), QueueEvent__get_user_data(evt))){
+        EventQueue__cascade_cancel(self, evt);
+        return;
+    }
+    P_MUTEX_LOCK(priv->scope_lock);
+    //Otherwise it was cancelled or coalesced while blocked
+    if(node->list == &priv->blocked){
+        QueueEventList__remove(&priv->blocked, node);
+        node->queued_time = g_get_monotonic_time();
+        ready = EventQueue__make_ready_prelocked(priv, evt, FALSE);
+    }
+    P_MUTEX_UNLOCK(priv->scope_lock);
+    if(ready){
+        EventQueue__wake_workers(priv, 1);
+    }
+}
+
+//The antecedents of a blocked event can no longer be satisfied
+static void
+EventQueue__cascade_cancel(EventQueue * self, QueueEvent * evt){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    QueueEventNode * node = QueueEvent__get_node(evt);
+    int blocked = FALSE;
+    P_MUTEX_LOCK(priv->scope_lock);
+    if(node->list == &priv->blocked){
+        QueueEventList__remove(&priv->blocked, node);
+        EventQueue__scope_unlink_prelocked(priv, evt);
+        blocked = TRUE;
+    }
+    P_MUTEX_UNLOCK(priv->scope_lock);
+    if(!blocked){
+        return;
+    }
+    C_TRAIL("Cancelling dependent event...");
+    //Reported to its own dependents through the state change
+    QueueEvent__try_cancel(evt);
+    EventQueue_to_notify(evt, self);
+}
+
+static void
+EventQueue__join_report(EventQueueJoin * join, int dispatched){
+    int fire = -1;
+    if(dispatched){
+        if(join->mode == EVENTQUEUE_JOIN_ANY || g_atomic_int_dec_and_test(&join->remaining)){
+            fire = g_atomic_int_compare_and_exchange(&join->resolved, 0, 1) ? TRUE : -1;
+        }
+    } else {
+        if(join->mode == EVENTQUEUE_JOIN_ALL || g_atomic_int_dec_and_test(&join->remaining)){
+            fire = g_atomic_int_compare_and_exchange(&join->resolved, 0, 1) ? FALSE : -1;
+        }
+    }
+
+    if(fire == TRUE){
+        EventQueue__unblock(join->queue, join->evt);
+    } else if(fire == FALSE){
+        EventQueue__cascade_cancel(join->queue, join->evt);
+    }
+
+    if(g_atomic_int_dec_and_test(&join->refs)){
+        EventQueue__release_event(join->queue, join->evt);
+        g_free(join);
+    }
+}
+
+//Report a finished or cancelled antecedent to the events waiting on it. Only the first report counts.
+static void
+EventQueue__resolve_dependents(EventQueue * self, QueueEvent * evt, int dispatched){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (EventQueue__root(self));
+    if(!g_atomic_int_get(&priv->dependents_count)){
+        return;
+    }
+    P_MUTEX_LOCK(priv->deps_lock);
+    GPtrArray * links = g_hash_table_lookup(priv->dependents, evt);
+    if(links){
+        g_hash_table_steal(priv->dependents, evt);
+        g_atomic_int_add(&priv->dependents_count, -1);
+    }
+    P_MUTEX_UNLOCK(priv->deps_lock);
+    if(!links){
+        return;
+    }
+    g_object_unref(evt); //Key reference. The caller still holds its own.
+
+    guint i;
+    for(i=0;i<links->len;i++){
+        EventQueue__join_report(g_ptr_array_index(links, i), dispatched);
+    }
+    g_ptr_array_free(links, TRUE);
+}
+
+/*
+ * Coalesce, link and route a new record. Shared by single and batched inserts.
+ * Returns the pending event that KEEP_FIRST keeps instead, leaving the record unlinked.
+ * A pending event taken over by KEEP_LAST is returned through replaced, to cancel once unlocked.
+ * With a ready array, ready events other than strand ones are collected there to be published together.
+ */
+static QueueEvent *
+EventQueue__place_prelocked(EventQueue * self, QueueEvent * record, const QueueEventOptions * options, gint64 now, int local, QueueEvent ** replaced, int * woken, QueueEvent ** ready, int * ready_count){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    *replaced = NULL;
+    if(options->coalesce != EVENTQUEUE_COALESCE_NONE && !options->interval){
+        QueueEvent * pending = EventQueue__find_pending_prelocked(priv, QueueEvent__get_scope(record), QueueEvent__get_callback(record));
+        if(pending && options->coalesce == EVENTQUEUE_COALESCE_KEEP_FIRST){
+            return pending;
+        } else if(pending && EventQueue__unqueue_prelocked(priv, pending, woken)){
+            *replaced = pending;
+        }
+    }
+    EventQueue__scope_link_prelocked(priv, record);
+    QueueEvent__get_node(record)->queued_time = now;
+    if(options->delay > 0){
+        //Consumes no worker until due
+        EventQueue__schedule_prelocked(self, record, now + options->delay * G_TIME_SPAN_MILLISECOND);
+    } else if(ready && !(QueueEvent__get_flags(record) & QUEUEEVENT_FLAG_STRAND)){
+        ready[(*ready_count)++] = record;
+    } else {
+        //Strand events wait on their strand, and skip the rings anyway
+        *woken += EventQueue__make_ready_prelocked(priv, record, local);
+    }
+    return NULL;
+}
+
+/*
+ * Link the event under its scope without making it ready, then register it with every antecedent.
+ * Antecedents already finished or cancelled report right away.
+ * The state is checked under deps_lock, which a finishing antecedent takes after updating it.
+ */
+static QueueEvent *
+EventQueue__insert_after_private(EventQueue * self, const QueueEventOptions * options, QueueEventJoin mode, QueueEvent ** antecedents, int count, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data), int managed){
+    EventQueue * pool = EventQueue__route(self, options);
+    if(pool != self){
+        return EventQueue__insert_after_private(pool, options, mode, antecedents, count, scope, callback, user_data, cleanup_cb, managed);
+    }
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    EventQueuePrivate *deps = EventQueue__get_instance_private (EventQueue__root(self));
+    C_TRAIL("Adding dependent event to queue");
+    if(QueueEvent__get_current() && QueueEvent__is_cancelled(QueueEvent__get_current())){
+        C_WARN("Ignoring event dispatched from cancelled event...");
+        if(cleanup_cb){
+            cleanup_cb(NULL, 1,user_data);
+        }
+        if(managed){
+            g_object_unref(G_OBJECT(user_data));
+        }
+        return NULL;
+    }
+
+    QueueEvent * record = EventQueue__acquire_event(priv, scope, options->priority, callback,cleanup_cb, user_data, managed);
+    EventQueue__prepare_event(self, record, options);
+    g_object_ref(record); //Returned reference, released below unless held
+
+    EventQueueJoin * join = g_new0(EventQueueJoin, 1);
+    join->evt = g_object_ref(record);
+    join->queue = self;
+    join->mode = mode;
+    join->remaining = count;
+    join->resolved = 0;
+    join->refs = count;
+
+    P_MUTEX_LOCK(priv->scope_lock);
+    EventQueue__scope_link_prelocked(priv, record);
+    QueueEventList__push_tail(&priv->blocked, QueueEvent__get_node(record));
+    P_MUTEX_UNLOCK(priv->scope_lock);
+    EventQueue__emit_signal(self,record,EVENTQUEUE_ADDED);
+
+    int i;
+    for(i=0;i<count;i++){
+        QueueEvent * antecedent = antecedents[i];
+        int outcome = -1;
+        P_MUTEX_LOCK(deps->deps_lock);
+        if(QueueEvent__is_cancelled(antecedent)){
+            outcome = FALSE;
+        } else if(QueueEvent__is_finished(antecedent)){
+            outcome = TRUE;
+        } else {
+            GPtrArray * links = g_hash_table_lookup(deps->dependents, antecedent);
+            if(!links){
+                links = g_ptr_array_new();
+                //Keeps the record from being recycled and reused while dependents are keyed on it
+                g_hash_table_insert(deps->dependents, g_object_ref(antecedent), links);
+                g_atomic_int_inc(&deps->dependents_count);
+            }
+            g_ptr_array_add(links, join);
+        }
+        P_MUTEX_UNLOCK(deps->deps_lock);
+        if(outcome >= 0){
+            EventQueue__join_report(join, outcome);
+        }
+    }
+
+    if(!options->hold){
+        EventQueue__release_event(self, record);
+    }
+    return record;
+}
+
+static QueueEvent * 
+EventQueue__insert_private(EventQueue* self, const QueueEventOptions * options, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data), int managed){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), NULL);
+    EventQueue * pool = EventQueue__route(self, options);
+    if(pool != self){
+        return EventQueue__insert_private(pool, options, scope, callback, user_data, cleanup_cb, managed);
+    }
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    QueueEvent * record = NULL;
+    C_TRAIL("Adding new event to queue");
+    if(!QueueEvent__get_current() || !QueueEvent__is_cancelled(QueueEvent__get_current())){
+        if(options->delay <= 0 && EventQueue__takes_slot(priv, options, scope, QUEUEEVENT_CALLBACK_FUNC(callback))
+                && !EventQueue__admit(self, options->priority, 0, scope, user_data)){
+            EventQueue__discard(user_data, cleanup_cb, managed);
+            return NULL;
+        }
+        record = EventQueue__acquire_event(priv, scope, options->priority, callback,cleanup_cb, user_data, managed);
+        EventQueue__prepare_event(self, record, options);
+        g_object_ref(record); //Adding extra reference in case thread finish the event before the signal completes
+
+        int ready = 0;
+        QueueEvent * replaced = NULL;
+        //Follow-up work spawned by a running event stays on its worker, unless it is interactive
+        int local = QueueEvent__get_current() && local_deque && local_deque->queue == self && options->priority != QUEUEEVENT_PRIORITY_INTERACTIVE;
+        P_MUTEX_LOCK(priv->scope_lock);
+        QueueEvent * pending = EventQueue__place_prelocked(self, record, options, g_get_monotonic_time(), local, &replaced, &ready, NULL, NULL);
+        if(pending){
+            if(options->hold){
+                g_object_ref(pending);
+            }
+            P_MUTEX_UNLOCK(priv->scope_lock);
+            C_TRAIL("Coalesced event into pending event");
+            //Released as cancelled, which runs the cleanup and releases managed data
+            QueueEvent__set_notify(record, NULL, NULL);
+            QueueEvent__cancel(record);
+            g_object_unref(record);
+            EventQueue__release_event(self, record);
+            return pending;
+        }
+        P_MUTEX_UNLOCK(priv->scope_lock);
+
+        if(replaced){
+            C_TRAIL("Coalesced pending event into new event");
+            QueueEvent__try_cancel(replaced);
+            EventQueue_to_notify(replaced, self);
+        }
+
+        if(ready){
+            EventQueue__wake_workers(priv, ready); //Signal q thread that the event is ready to invoke
+        }
+        EventQueue__emit_signal(self,record,EVENTQUEUE_ADDED);
+        if(!options->hold){
+            EventQueue__release_event(self, record);
+        }
+    } else {
+        C_WARN("Ignoring event dispatched from cancelled event...");
+        if(cleanup_cb){
+            cleanup_cb(NULL, 1,user_data);
+        }
+        if(managed){
+            g_object_unref(G_OBJECT(user_data));
+        }
+    }
+    return record;
+}
+
+QueueEvent * 
+EventQueue__insert_plain_priority(EventQueue* self, QueueEventPriority priority, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), NULL);
+    g_return_val_if_fail (priority >= 0 && priority < QUEUEEVENT_PRIORITY_COUNT, NULL);
+    QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+    options.priority = priority;
+    return EventQueue__insert_private(self, &options, scope, callback, user_data,cleanup_cb, 0);
+}
+
+QueueEvent * 
+EventQueue__insert_priority(EventQueue* self, QueueEventPriority priority, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), NULL);
+    g_return_val_if_fail (priority >= 0 && priority < QUEUEEVENT_PRIORITY_COUNT, NULL);
+
+    if(G_IS_OBJECT(user_data)){
+        g_object_ref(G_OBJECT(user_data));
+    } else {
+        C_FIXME("Invalid GObject. Use EventQueue_insert_plain instead.");
+    }
+
+    QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+    options.priority = priority;
+    return EventQueue__insert_private(self, &options, scope, callback, user_data,cleanup_cb, 1);
+}
+
+QueueEvent * 
+EventQueue__insert_plain(EventQueue* self, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
+    return EventQueue__insert_plain_priority(self, QUEUEEVENT_PRIORITY_NORMAL, scope, callback, user_data, cleanup_cb);
+}
+
+QueueEvent * 
+EventQueue__insert(EventQueue* self, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
+    return EventQueue__insert_priority(self, QUEUEEVENT_PRIORITY_NORMAL, scope, callback, user_data, cleanup_cb);
+}
+
+QueueEvent * 
+EventQueue__insert_plain_delayed(EventQueue* self, int delay, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), NULL);
+    g_return_val_if_fail (delay >= 0, NULL);
+    QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+    options.delay = delay;
+    return EventQueue__insert_private(self, &options, scope, callback, user_data,cleanup_cb, 0);
+}
+
+QueueEvent * 
+EventQueue__insert_delayed(EventQueue* self, int delay, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), NULL);
+    g_return_val_if_fail (delay >= 0, NULL);
+
+    if(G_IS_OBJECT(user_data)){
+        g_object_ref(G_OBJECT(user_data));
+    } else {
+        C_FIXME("Invalid GObject. Use EventQueue__insert_plain_delayed instead.");
+    }
+
+    QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+    options.delay = delay;
+    return EventQueue__insert_private(self, &options, scope, callback, user_data,cleanup_cb, 1);
+}
+
+//The first run happens one interval after insertion
+QueueEvent * 
+EventQueue__insert_plain_periodic(EventQueue* self, int interval, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), NULL);
+    g_return_val_if_fail (interval > 0, NULL);
+    QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+    options.delay = interval;
+    options.interval = interval;
+    return EventQueue__insert_private(self, &options, scope, callback, user_data,cleanup_cb, 0);
+}
+
+QueueEvent * 
+EventQueue__insert_periodic(EventQueue* self, int interval, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), NULL);
+    g_return_val_if_fail (interval > 0, NULL);
+
+    if(G_IS_OBJECT(user_data)){
+        g_object_ref(G_OBJECT(user_data));
+    } else {
+        C_FIXME("Invalid GObject. Use EventQueue__insert_plain_periodic instead.");
+    }
+
+    QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+    options.delay = interval;
+    options.interval = interval;
+    return EventQueue__insert_private(self, &options, scope, callback, user_data,cleanup_cb, 1);
 }
 
-static QueueEvent * 
-EventQueue__insert_private(EventQueue* self, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data), int managed){
+QueueEvent * 
+EventQueue__insert_plain_with_options(EventQueue* self, const QueueEventOptions * options, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
     g_return_val_if_fail (self != NULL, NULL);
     g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), NULL);
-    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
-    QueueEvent * record = NULL;
-    C_TRAIL("Adding new event to queue");
-    if(!QueueEvent__get_current() || !QueueEvent__is_cancelled(QueueEvent__get_current())){
-        P_MUTEX_LOCK(priv->pool_lock);
-        record = QueueEvent__new(scope, callback,cleanup_cb, user_data, managed);
-        g_signal_connect (G_OBJECT (record), "state-changed", G_CALLBACK (EventQueue__evt_state_changed_cb), self);
-        priv->events = g_list_append(priv->events, record);
-        g_object_ref(record); //Adding extra reference in case thread finish the event before the signal completes
-        P_COND_SIGNAL(priv->sleep_cond); //Signal q thread that the event is ready to invoke
-        EventQueue__emit_signal_prelocked(self,record,EVENTQUEUE_ADDED);
-        g_object_unref(record);
+    g_return_val_if_fail (options != NULL, NULL);
+    g_return_val_if_fail (options->priority >= 0 && options->priority < QUEUEEVENT_PRIORITY_COUNT, NULL);
+    g_return_val_if_fail (options->delay >= 0 && options->interval >= 0 && options->timeout >= 0, NULL);
+    return EventQueue__insert_private(self, options, scope, callback, user_data,cleanup_cb, 0);
+}
+
+QueueEvent * 
+EventQueue__insert_with_options(EventQueue* self, const QueueEventOptions * options, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), NULL);
+    g_return_val_if_fail (options != NULL, NULL);
+    g_return_val_if_fail (options->priority >= 0 && options->priority < QUEUEEVENT_PRIORITY_COUNT, NULL);
+    g_return_val_if_fail (options->delay >= 0 && options->interval >= 0 && options->timeout >= 0, NULL);
+
+    if(G_IS_OBJECT(user_data)){
+        g_object_ref(G_OBJECT(user_data));
     } else {
-        C_WARN("Ignoring event dispatched from cancelled event...");
-        if(cleanup_cb){
-            cleanup_cb(NULL, 1,user_data);
-        }
-        if(managed){
-            g_object_unref(G_OBJECT(user_data));
-        }
+        C_FIXME("Invalid GObject. Use EventQueue__insert_plain_with_options instead.");
     }
-    return record;
+
+    return EventQueue__insert_private(self, options, scope, callback, user_data,cleanup_cb, 1);
 }
 
 QueueEvent * 
-EventQueue__insert_plain(EventQueue* self, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
+EventQueue__insert_plain_after(EventQueue* self, const QueueEventOptions * options, QueueEventJoin join, QueueEvent ** antecedents, int count, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
     g_return_val_if_fail (self != NULL, NULL);
     g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), NULL);
-    return EventQueue__insert_private(self,scope, callback, user_data,cleanup_cb, 0);
+    g_return_val_if_fail (options != NULL, NULL);
+    g_return_val_if_fail (antecedents != NULL && count > 0, NULL);
+    g_return_val_if_fail (options->priority >= 0 && options->priority < QUEUEEVENT_PRIORITY_COUNT, NULL);
+    g_return_val_if_fail (!options->delay && !options->interval && options->coalesce == EVENTQUEUE_COALESCE_NONE && options->timeout >= 0, NULL);
+    return EventQueue__insert_after_private(self, options, join, antecedents, count, scope, callback, user_data, cleanup_cb, 0);
 }
 
 QueueEvent * 
-EventQueue__insert(EventQueue* self, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
+EventQueue__insert_after(EventQueue* self, const QueueEventOptions * options, QueueEventJoin join, QueueEvent ** antecedents, int count, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
     g_return_val_if_fail (self != NULL, NULL);
     g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), NULL);
+    g_return_val_if_fail (options != NULL, NULL);
+    g_return_val_if_fail (antecedents != NULL && count > 0, NULL);
+    g_return_val_if_fail (options->priority >= 0 && options->priority < QUEUEEVENT_PRIORITY_COUNT, NULL);
+    g_return_val_if_fail (!options->delay && !options->interval && options->coalesce == EVENTQUEUE_COALESCE_NONE && options->timeout >= 0, NULL);
 
     if(G_IS_OBJECT(user_data)){
         g_object_ref(G_OBJECT(user_data));
     } else {
-        C_FIXME("Invalid GObject. Use EventQueue_insert_plain instead.");
+        C_FIXME("Invalid GObject. Use EventQueue__insert_plain_after instead.");
+    }
+
+    return EventQueue__insert_after_private(self, options, join, antecedents, count, scope, callback, user_data, cleanup_cb, 1);
+}
+
+QueueEvent * 
+EventQueue__then_plain(EventQueue* self, QueueEvent * antecedent, const QueueEventOptions * options, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
+    return EventQueue__insert_plain_after(self, options, EVENTQUEUE_JOIN_ALL, &antecedent, 1, scope, callback, user_data, cleanup_cb);
+}
+
+QueueEvent * 
+EventQueue__then(EventQueue* self, QueueEvent * antecedent, const QueueEventOptions * options, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data)){
+    return EventQueue__insert_after(self, options, EVENTQUEUE_JOIN_ALL, &antecedent, 1, scope, callback, user_data, cleanup_cb);
+}
+
+/*
+ * Publish a batch under a single scope lock and a single pool lock acquisition.
+ * Wakes one worker per ready event. Each event is reported through evt-added,
+ * and the batch once through pool-changed.
+ * Returns the number of events queued, which excludes events coalesced into pending ones.
+ */
+static int
+EventQueue__insert_many_private(EventQueue * self, const QueueEventOptions * options, const QueueEventEntry * entries, int count, int managed){
+    EventQueue * pool = EventQueue__route(self, options);
+    if(pool != self){
+        return EventQueue__insert_many_private(pool, options, entries, count, managed);
+    }
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    int i;
+    C_TRAIL("Adding %d events to queue", count);
+    if(QueueEvent__get_current() && QueueEvent__is_cancelled(QueueEvent__get_current())){
+        C_WARN("Ignoring events dispatched from cancelled event...");
+        for(i=0;i<count;i++){
+            if(entries[i].cleanup_cb){
+                entries[i].cleanup_cb(NULL, 1, entries[i].user_data);
+            }
+            if(managed){
+                g_object_unref(G_OBJECT(entries[i].user_data));
+            }
+        }
+        return 0;
+    }
+
+    //Refused entries are left out of the batch
+    QueueEventEntry * admitted = NULL;
+    if(options->delay <= 0){
+        int kept = 0;
+        int slots = 0;
+        for(i=0;i<count;i++){
+            int slot = EventQueue__takes_slot(priv, options, entries[i].scope, entries[i].callback);
+            if(slot && !EventQueue__admit(self, options->priority, slots, entries[i].scope, entries[i].user_data)){
+                EventQueue__discard(entries[i].user_data, entries[i].cleanup_cb, managed);
+                if(!admitted){
+                    admitted = g_new(QueueEventEntry, count);
+                    memcpy(admitted, entries, sizeof(QueueEventEntry) * i);
+                }
+            } else {
+                if(admitted){
+                    admitted[kept] = entries[i];
+                }
+                kept++;
+                slots += slot;
+            }
+        }
+        if(admitted){
+            entries = admitted;
+            count = kept;
+        }
+        if(!count){
+            g_free(admitted);
+            return 0;
+        }
+    }
+
+    QueueEvent ** records = g_new(QueueEvent *, count);
+    QueueEvent ** ready = g_new(QueueEvent *, count);
+    int ready_count = 0;
+    int queued = 0;
+    int woken = 0;
+    GList * dropped = NULL;
+    GList * replaced = NULL;
+
+    P_MUTEX_LOCK(priv->free_lock);
+    for(i=0;i<count;i++){
+        QueueEventNode * node = QueueEventList__pop_head(&priv->free_events);
+        records[i] = (node) ? node->evt : NULL;
+    }
+    P_MUTEX_UNLOCK(priv->free_lock);
+    for(i=0;i<count;i++){
+        const QueueEventEntry * entry = &entries[i];
+        if(records[i]){
+            QueueEvent__reuse(records[i], entry->scope, options->priority, entry->callback, entry->cleanup_cb, entry->user_data, managed);
+        } else {
+            records[i] = QueueEvent__new(entry->scope, options->priority, entry->callback, entry->cleanup_cb, entry->user_data, managed);
+        }
+        EventQueue__prepare_event(self, records[i], options);
+    }
+
+    //Checked once up front. Handlers connected during the batch miss it.
+    int report = g_signal_has_handler_pending(EventQueue__root(self), signals[EVT_ADDED], 0, TRUE);
+    gint64 now = g_get_monotonic_time();
+    P_MUTEX_LOCK(priv->scope_lock);
+    for(i=0;i<count;i++){
+        QueueEvent * record = records[i];
+        QueueEvent * pending;
+        if(EventQueue__place_prelocked(self, record, options, now, FALSE, &pending, &woken, ready, &ready_count)){
+            dropped = g_list_prepend(dropped, record);
+            records[i] = NULL;
+            continue;
+        }
+        if(pending){
+            replaced = g_list_prepend(replaced, pending);
+        }
+        if(report){
+            g_object_ref(record); //Kept until evt-added is emitted, like single inserts
+        }
+        queued++;
+    }
+    int overflow = 0;
+    for(i=0;i<ready_count;i++){
+        if(!EventQueue__ring_push(priv, ready[i])){
+            ready[overflow++] = ready[i];
+        }
+    }
+    if(overflow){
+        P_MUTEX_LOCK(priv->pool_lock);
+        for(i=0;i<overflow;i++){
+            EventQueue__push_ready_prelocked(priv, ready[i]);
+        }
+        P_MUTEX_UNLOCK(priv->pool_lock);
+    }
+    P_MUTEX_UNLOCK(priv->scope_lock);
+
+    if(ready_count + woken){
+        EventQueue__wake_workers(priv, ready_count + woken);
+    }
+
+    QueueEvent * evt;
+    GLIST_FOREACH(evt, replaced){
+        C_TRAIL("Coalesced pending event into new event");
+        QueueEvent__try_cancel(evt);
+        EventQueue_to_notify(evt, self);
+    }
+    GLIST_FOREACH(evt, dropped){
+        //Released as cancelled, which runs the cleanup and releases managed data
+        C_TRAIL("Coalesced event into pending event");
+        QueueEvent__set_notify(evt, NULL, NULL);
+        QueueEvent__cancel(evt);
+        EventQueue__release_event(self, evt);
+    }
+    g_list_free(replaced);
+    g_list_free(dropped);
+    g_free(ready);
+    g_free(admitted);
+
+    for(i=0;report && i<count;i++){
+        if(records[i]){
+            g_signal_emit (EventQueue__root(self), signals[EVT_ADDED], 0, records[i]);
+            EventQueue__release_event(self, records[i]);
+        }
+    }
+    g_free(records);
+
+    if(queued){
+        EventQueue__emit_signal(self, NULL, EVENTQUEUE_ADDED);
+    }
+    return queued;
+}
+
+int
+EventQueue__insert_plain_many(EventQueue * self, const QueueEventOptions * options, const QueueEventEntry * entries, int count){
+    g_return_val_if_fail (self != NULL, 0);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), 0);
+    g_return_val_if_fail (options != NULL, 0);
+    g_return_val_if_fail (entries != NULL || count == 0, 0);
+    g_return_val_if_fail (options->priority >= 0 && options->priority < QUEUEEVENT_PRIORITY_COUNT, 0);
+    g_return_val_if_fail (options->delay >= 0 && options->interval >= 0 && options->timeout >= 0, 0);
+    g_return_val_if_fail (!options->hold, 0);
+    if(count <= 0){
+        return 0;
+    }
+    return EventQueue__insert_many_private(self, options, entries, count, 0);
+}
+
+int
+EventQueue__insert_many(EventQueue * self, const QueueEventOptions * options, const QueueEventEntry * entries, int count){
+    g_return_val_if_fail (self != NULL, 0);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), 0);
+    g_return_val_if_fail (options != NULL, 0);
+    g_return_val_if_fail (entries != NULL || count == 0, 0);
+    g_return_val_if_fail (options->priority >= 0 && options->priority < QUEUEEVENT_PRIORITY_COUNT, 0);
+    g_return_val_if_fail (options->delay >= 0 && options->interval >= 0 && options->timeout >= 0, 0);
+    g_return_val_if_fail (!options->hold, 0);
+    if(count <= 0){
+        return 0;
     }
 
-    return EventQueue__insert_private(self,scope, callback, user_data,cleanup_cb, 1);
+    int i;
+    for(i=0;i<count;i++){
+        if(G_IS_OBJECT(entries[i].user_data)){
+            g_object_ref(G_OBJECT(entries[i].user_data));
+        } else {
+            C_FIXME("Invalid GObject. Use EventQueue__insert_plain_many instead.");
+        }
+    }
+    return EventQueue__insert_many_private(self, options, entries, count, 1);
 }
 
 static void 
@@ -352,13 +2942,17 @@ EventQueue_to_notify(QueueEvent * evt, EventQueue * self){
     C_INFO("Cancelling pending event...");
     EventQueue__emit_signal(self, evt, EVENTQUEUE_CANCELLED);
     EventQueue__emit_signal(self, evt, EVENTQUEUE_FINISHED);
-    g_object_unref(evt);
+    //Dropped without a state change, so the cancellation cascades from here
+    EventQueue__resolve_dependents(self, evt, FALSE);
+    EventQueue__release_event(self, evt);
 }
 
 static void 
 EventQueue_to_cancel(QueueEvent * evt, EventQueue * self){
     C_INFO("Cancelling running event...");
-    QueueEvent__cancel(evt);
+    //Its deadline or the watchdog may have cancelled it already
+    QueueEvent__try_cancel(evt);
+    EventQueue__release_event(self, evt);
 }
 
 void 
@@ -366,46 +2960,92 @@ EventQueue__cancel_scopes(EventQueue * self, void ** scopes, int count){
     g_return_if_fail (self != NULL);
     g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
     EventQueuePrivate *priv = EventQueue__get_instance_private (self);
-    P_MUTEX_LOCK(priv->pool_lock);
-    int i, a, evtcount;
+    P_MUTEX_LOCK(priv->scope_lock);
+    int a;
+    QueueEventNode * scope_node;
     
     GList * to_notify = NULL;
     GList * to_cancel = NULL;
 
-    //Clean up pending events
-    evtcount = g_list_length(priv->events);
-    for(i=0;i<evtcount;i++){
-        QueueEvent * evt = g_list_nth_data(priv->events,i);
-        for(a=0;a<count;a++){
-            void * scope_to_cancel = scopes[a];
-            if(scope_to_cancel == QueueEvent__get_scope(evt)){
-                C_INFO("Removing from queue...");
-                priv->events = g_list_remove(priv->events,evt);
-                i--;
-                evtcount--;
-                to_notify = g_list_append(to_notify, evt);
-            }
+    //Only visit the events indexed under the requested scopes
+    for(a=0;a<count;a++){
+        EventQueueScope * entry = g_hash_table_lookup(priv->scopes, scopes[a]);
+        if(!entry){
+            continue;
         }
-    }
 
-    //Cancellation request for running event
-    evtcount = g_list_length(priv->running_events);
-    for(i=0;i<evtcount;i++){
-        QueueEvent * evt = g_list_nth_data(priv->running_events, i);
-        for(a=0;a<count;a++){
-            void * scope_to_cancel = scopes[a];
-            if(scope_to_cancel == QueueEvent__get_scope(evt)){
-                priv->running_events = g_list_remove(priv->running_events,evt);
-                i--;
-                evtcount--;
-                to_cancel = g_list_append(to_cancel, evt);
+        QueueEvent * holder = NULL;
+        while((scope_node = QueueEventList__pop_head(&entry->events))){
+            QueueEvent * evt = scope_node->evt;
+            QueueEventNode * node = QueueEvent__get_node(evt);
+            if(node->list == &entry->strand_waiting){
+                //Strand events waiting on the scope are pending without being ready
+                QueueEventList__remove(&entry->strand_waiting, node);
+                to_notify = g_list_prepend(to_notify, evt);
+            } else if(node->list == &priv->blocked){
+                //Dependent events still waiting on their antecedents
+                QueueEventList__remove(&priv->blocked, node);
+                to_notify = g_list_prepend(to_notify, evt);
+            } else if(EventQueue__remove_ready(priv, evt)){
+                //Clean up pending events
+                C_INFO("Removing from queue...");
+                to_notify = g_list_prepend(to_notify, evt);
+            } else if(evt == entry->strand_holder){
+                //Keeps the scope and its strand until it returns, so the next strand event can't run alongside it
+                holder = evt;
+                to_cancel = g_list_prepend(to_cancel, g_object_ref(evt));
+            } else {
+                //Cancellation request for running event. The worker may release it as soon as the lock drops.
+                g_atomic_int_add(&priv->running_count, -1);
+                to_cancel = g_list_prepend(to_cancel, g_object_ref(evt));
             }
         }
+        if(holder){
+            QueueEventList__push_tail(&entry->events, QueueEvent__get_scope_node(holder));
+        } else {
+            g_hash_table_remove(priv->scopes, scopes[a]);
+        }
     }
-    P_MUTEX_UNLOCK(priv->pool_lock);
+    P_MUTEX_UNLOCK(priv->scope_lock);
 
+    to_cancel = g_list_reverse(to_cancel);
+    to_notify = g_list_reverse(to_notify);
     g_list_foreach(to_cancel, (GFunc)EventQueue_to_cancel, self);
     g_list_foreach(to_notify, (GFunc)EventQueue_to_notify, self);
+    g_list_free(to_cancel);
+    g_list_free(to_notify);
+
+    //Cancelled scopes are going away
+    for(a=0;a<count;a++){
+        QueueMetrics__forget_scope(priv->metrics, scopes[a]);
+    }
+
+    //A scope can have events in every pool
+    int pool_count = g_atomic_int_get(&priv->pool_count);
+    for(a=EVENTQUEUE_POOL_DEFAULT+1;a<pool_count;a++){
+        EventQueue__cancel_scopes(priv->pools[a], scopes, count);
+    }
+}
+
+//Called by the worker on itself
+static void
+EventQueue__apply_sched(EventQueue * self){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    ThreadSched sched;
+    P_MUTEX_LOCK(priv->threads_lock);
+    sched = priv->sched;
+    local_sched_seq = g_atomic_int_get(&priv->sched_seq);
+    P_MUTEX_UNLOCK(priv->threads_lock);
+    ThreadSched__apply(&sched);
+}
+
+static void
+EventQueue__name_worker(EventQueue * self){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    char name[THREAD_SCHED_NAME_LENGTH];
+    int serial = g_atomic_int_add(&priv->thread_serial, 1);
+    snprintf(name, sizeof(name), "eq-%s-%d", priv->pool_names[EVENTQUEUE_POOL_DEFAULT], serial);
+    ThreadSched__set_name(name);
 }
 
 QueueEvent * 
@@ -413,18 +3053,42 @@ EventQueue__pop(EventQueue* self){
     g_return_val_if_fail (self != NULL,NULL);
     g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self),NULL);
     EventQueuePrivate *priv = EventQueue__get_instance_private (self);
-    P_MUTEX_LOCK(priv->pool_lock);
-    if(QueueThread__is_terminated(QueueThread__get_current())){ //Check for cancelled thread after lock acquired
-        P_MUTEX_UNLOCK(priv->pool_lock);
+    if(QueueThread__is_terminated(QueueThread__get_current())){
         return NULL;
     }
-    QueueEvent * qe = g_list_nth_data(priv->events, 0);
+    if(g_atomic_int_get(&priv->sched_seq) != local_sched_seq){
+        EventQueue__apply_sched(self);
+    }
+
+    QueueEvent * qe = NULL;
+    EventQueueDeque * own = (local_deque && local_deque->queue == self) ? local_deque : NULL;
+    //Interactive work never waits behind local follow-up work
+    if(g_atomic_int_get(&priv->lane_counts[QUEUEEVENT_PRIORITY_INTERACTIVE])){
+        qe = EventQueue__pop_global(self);
+    }
+    if(!qe && own){
+        qe = EventQueue__pop_deque(priv, own, TRUE);
+    }
+    if(!qe){
+        qe = EventQueue__pop_global(self);
+    }
+    if(!qe){
+        qe = EventQueue__steal(priv, own);
+    }
+
     if(qe) {
-        priv->events = g_list_remove(priv->events, qe);
-        priv->running_events = g_list_append(priv->running_events, qe);
-        EventQueue__emit_signal_prelocked(self,qe,EVENTQUEUE_DISPATCHING);
-    } else {
-        P_MUTEX_UNLOCK(priv->pool_lock);
+        if(g_atomic_int_get(&priv->room_waiters)){
+            g_mutex_lock(&priv->room_lock);
+            g_cond_broadcast(&priv->room_cond);
+            g_mutex_unlock(&priv->room_lock);
+        }
+        QueueEventNode * node = QueueEvent__get_node(qe);
+        node->dispatch_time = g_get_monotonic_time();
+        gint64 timeout = QueueEvent__get_timeout(qe);
+        if(timeout){
+            EventQueue__arm_deadline(self, qe, node->dispatch_time + timeout);
+        }
+        EventQueue__emit_signal(self,qe,EVENTQUEUE_DISPATCHING);
     }
 
     return qe;
@@ -435,17 +3099,36 @@ EventQueue__thread_state_changed_cb(QueueThread * thread, QueueThreadState state
     EventQueuePrivate *priv = EventQueue__get_instance_private (self);
     switch(state){
         case QUEUETHREAD_STARTED:
+            EventQueue__name_worker(self);
+            EventQueue__apply_sched(self);
+            EventQueue__acquire_deque(self);
             P_MUTEX_LOCK(priv->signal_lock);
             P_MUTEX_LOCK(priv->threads_lock);
-            priv->threads = g_list_append(priv->threads, thread);
+            priv->threads = g_list_prepend(priv->threads, thread);
+            g_atomic_int_inc(&priv->thread_count);
+            g_atomic_int_add(&priv->starting_count, -1);
             P_MUTEX_UNLOCK(priv->threads_lock);
             EventQueue__emit_signal(self, QueueEvent__get_current(), EVENTQUEUE_STARTED);
             P_MUTEX_UNLOCK(priv->signal_lock);
             break;
         case QUEUETHREAD_FINISHED:
+            EventQueue__release_deque(self);
             P_MUTEX_LOCK(priv->signal_lock);
             P_MUTEX_LOCK(priv->threads_lock);
-            priv->threads = g_list_remove(priv->threads,thread);
+            //The list is already cleared when all threads are stopped at once, and idle workers leave it as they retire
+            GList * link = g_list_find(priv->threads, thread);
+            if(link){
+                //Stopped or stalled worker, joined by the monitor or when the pool stops
+                priv->threads = g_list_delete_link(priv->threads, link);
+                g_atomic_int_add(&priv->thread_count, -1);
+                P_THREAD_TYPE * pthread = g_new(P_THREAD_TYPE, 1);
+                *pthread = QueueThread__get_thread(thread);
+                priv->retired = g_list_prepend(priv->retired, pthread);
+            }
+            if(g_hash_table_remove(priv->stalled, thread)){
+                g_atomic_int_add(&priv->stalled_count, -1);
+                C_INFO("EventQueue '%s' stuck worker finished its event.",priv->pool_names[EVENTQUEUE_POOL_DEFAULT]);
+            }
             P_MUTEX_UNLOCK(priv->threads_lock);
             g_object_unref(thread);
             EventQueue__emit_signal(self, QueueEvent__get_current(), EVENTQUEUE_FINISHED);
@@ -461,15 +3144,333 @@ void
 EventQueue__start(EventQueue* self){
     g_return_if_fail (self != NULL);
     g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
     QueueThread * qt = QueueThread__new(self);
+    g_atomic_int_inc(&priv->starting_count);
     g_signal_connect (G_OBJECT (qt), "state-changed", G_CALLBACK (EventQueue__thread_state_changed_cb), self);
     QueueThread__start(qt);
 }
 
+//Sleep lock held, so concurrent timeouts are decided one at a time
+static int
+EventQueue__idle_expired_prelocked(EventQueue * self, QueueThread * thread){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    if(g_atomic_int_get(&priv->thread_count) > g_atomic_int_get(&priv->min_threads)){
+        EventQueue__retire_prelocked(self, thread);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+#ifdef EVENTQUEUE_HAS_FUTEX
+/*
+ * Futex parking used along with the ready rings, so an inserter never takes a lock to wake a worker.
+ * The wake sequence is sampled before the pending counter is checked,
+ * so a wake up issued in between fails the futex wait instead of being lost.
+ */
+static int
+EventQueue__park_worker(EventQueue * self, QueueThread * thread){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    int retired = FALSE;
+    g_atomic_int_inc(&priv->idle_count);
+    gint64 deadline = g_get_monotonic_time() + priv->idle_timeout;
+    for(;;){
+        gint seq = g_atomic_int_get(&priv->park_seq);
+        if(g_atomic_int_get(&priv->pending_count) || QueueThread__is_terminated(thread)
+                || g_atomic_int_get(&priv->sched_seq) != local_sched_seq){
+            break;
+        }
+        gint64 timeout = -1;
+        if(g_atomic_int_get(&priv->max_threads)){
+            timeout = MAX(deadline - g_get_monotonic_time(), 0);
+        }
+        if(EventQueue__park(&priv->park_seq, seq, timeout)){
+            continue;
+        }
+        g_mutex_lock(&priv->sleep_lock);
+        retired = EventQueue__idle_expired_prelocked(self, thread);
+        g_mutex_unlock(&priv->sleep_lock);
+        if(retired){
+            break;
+        }
+        deadline = g_get_monotonic_time() + priv->idle_timeout;
+    }
+    g_atomic_int_add(&priv->idle_count, -1);
+    return retired;
+}
+#endif
+
+/*
+ * The idle counter is raised before the pending counter is checked, and inserters raise the
+ * pending counter before checking idle workers, so a wake up can't be lost in between.
+ */
+static int
+EventQueue__sleep_worker(EventQueue * self, QueueThread * thread){
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    int retired = FALSE;
+    g_mutex_lock(&priv->sleep_lock);
+    g_atomic_int_inc(&priv->idle_count);
+    gint64 deadline = g_get_monotonic_time() + priv->idle_timeout;
+    //A new scheduling setting wakes the worker, so it applies it from EventQueue__pop
+    while(!g_atomic_int_get(&priv->pending_count) && !QueueThread__is_terminated(thread)
+            && g_atomic_int_get(&priv->sched_seq) == local_sched_seq){
+        if(!g_atomic_int_get(&priv->max_threads)){
+            g_cond_wait(&priv->sleep_cond, &priv->sleep_lock);
+        } else if(!g_cond_wait_until(&priv->sleep_cond, &priv->sleep_lock, deadline)){
+            if(EventQueue__idle_expired_prelocked(self, thread)){
+                retired = TRUE;
+                break;
+            }
+            deadline = g_get_monotonic_time() + priv->idle_timeout;
+        }
+    }
+    g_atomic_int_add(&priv->idle_count, -1);
+    g_mutex_unlock(&priv->sleep_lock);
+    return retired;
+}
+
+/*
+ * Park the calling worker until any lane or deque holds an event, or the worker is terminated.
+ * With an elastic pool, a worker idle for longer than the idle timeout retires
+ * as long as the pool stays above its minimum size.
+ */
+void 
+EventQueue__wait_for_event(EventQueue * self){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    QueueThread * thread = QueueThread__get_current();
+    int retired;
+#ifdef EVENTQUEUE_HAS_FUTEX
+    if(priv->ring_capacity){
+        retired = EventQueue__park_worker(self, thread);
+    } else
+#endif
+    retired = EventQueue__sleep_worker(self, thread);
+
+    if(retired){
+        C_INFO("EventQueue idle worker retired. [%d threads]",g_atomic_int_get(&priv->thread_count));
+        EventQueue__emit_signal(self, NULL, EVENTQUEUE_SHRUNK);
+    }
+}
+
+void 
+EventQueue__set_pool_limits(EventQueue * self, int min_threads, int max_threads){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    g_return_if_fail (min_threads >= 0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    if(max_threads < min_threads){
+        C_WARN("EventQueue max threads %d below min threads %d. Using %d.",max_threads,min_threads,min_threads);
+        max_threads = min_threads;
+    }
+    if(max_threads > EVENTQUEUE_MAX_DEQUES){
+        max_threads = EVENTQUEUE_MAX_DEQUES;
+    }
+
+    C_INFO("EventQueue pool limits [%d-%d]",min_threads,max_threads);
+    g_atomic_int_set(&priv->min_threads, min_threads);
+    g_atomic_int_set(&priv->max_threads, max_threads);
+
+    int current = g_atomic_int_get(&priv->thread_count) + g_atomic_int_get(&priv->starting_count)
+                    - g_atomic_int_get(&priv->stalled_count);
+    for(;current < min_threads;current++){
+        EventQueue__start(self);
+    }
+    if(current > max_threads){
+        EventQueue__stop(self, current - max_threads);
+    }
+
+    g_mutex_lock(&priv->monitor_lock);
+    if(!priv->monitor){
+        priv->monitor_running = 1;
+        priv->monitor = g_thread_new("eq-monitor", EventQueue__monitor_thread, self);
+    }
+    g_mutex_unlock(&priv->monitor_lock);
+
+    //Let idle workers pick up the new idle timeout policy
+    EventQueue__wake_all(priv);
+}
+
+int 
+EventQueue__get_min_threads(EventQueue * self){
+    g_return_val_if_fail (self != NULL,0);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self),0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    return g_atomic_int_get(&priv->min_threads);
+}
+
+int 
+EventQueue__get_max_threads(EventQueue * self){
+    g_return_val_if_fail (self != NULL,0);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self),0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    return g_atomic_int_get(&priv->max_threads);
+}
+
+void
+EventQueue__set_thread_sched(EventQueue * self, const ThreadSched * sched){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    g_return_if_fail (sched != NULL);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    char cpus[THREAD_SCHED_CPUS_LENGTH];
+    ThreadSched__format_cpus(sched, cpus, sizeof(cpus));
+    C_INFO("EventQueue '%s' thread scheduling [nice %d%s, cpus '%s']",priv->pool_names[EVENTQUEUE_POOL_DEFAULT],sched->nice,sched->idle ? ", idle" : "",cpus);
+
+    P_MUTEX_LOCK(priv->threads_lock);
+    priv->sched = *sched;
+    g_atomic_int_inc(&priv->sched_seq);
+    P_MUTEX_UNLOCK(priv->threads_lock);
+
+    //Idle workers apply it right away, busy ones after their current event
+    EventQueue__wake_all(priv);
+}
+
+void
+EventQueue__get_thread_sched(EventQueue * self, ThreadSched * sched){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    g_return_if_fail (sched != NULL);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    P_MUTEX_LOCK(priv->threads_lock);
+    *sched = priv->sched;
+    P_MUTEX_UNLOCK(priv->threads_lock);
+}
+
+void
+EventQueue__set_watchdog(EventQueue * self, int milliseconds, int cancel){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    g_return_if_fail (milliseconds >= 0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+#ifdef EVENTQUEUE_HAS_BACKTRACE
+    if(milliseconds){
+        g_once(&stack_handler_once, EventQueue__install_stack_handler, NULL);
+    }
+#endif
+    g_atomic_int_set(&priv->watchdog_cancel, cancel);
+    g_atomic_int_set(&priv->watchdog_threshold, milliseconds);
+}
+
+int
+EventQueue__get_stalled_count(EventQueue * self){
+    g_return_val_if_fail (self != NULL,0);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self),0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    return g_atomic_int_get(&priv->stalled_count);
+}
+
+void 
+EventQueue__set_grow_threshold(EventQueue * self, int milliseconds){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    g_return_if_fail (milliseconds > 0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    g_mutex_lock(&priv->monitor_lock);
+    priv->grow_threshold = milliseconds * G_TIME_SPAN_MILLISECOND;
+    g_mutex_unlock(&priv->monitor_lock);
+}
+
 void 
-EventQueue__wait_condition(EventQueue * self, P_MUTEX_TYPE lock){
+EventQueue__set_idle_timeout(EventQueue * self, int milliseconds){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    g_return_if_fail (milliseconds > 0);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    g_mutex_lock(&priv->sleep_lock);
+    priv->idle_timeout = milliseconds * G_TIME_SPAN_MILLISECOND;
+    g_mutex_unlock(&priv->sleep_lock);
+}
+int
+EventQueue__get_callback_metrics(EventQueue * self, QueueEventCallback callback, QueueMetricsSummary * summary){
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), FALSE);
+    g_return_val_if_fail (summary != NULL, FALSE);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    return QueueMetrics__get_callback(priv->metrics, callback, summary);
+}
+
+int
+EventQueue__get_scope_metrics(EventQueue * self, void * scope, QueueMetricsSummary * summary){
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (QUEUE_IS_EVENTQUEUE (self), FALSE);
+    g_return_val_if_fail (summary != NULL, FALSE);
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    return QueueMetrics__get_scope(priv->metrics, scope, summary);
+}
+
+void
+EventQueue__dump_metrics(EventQueue * self){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    QueueMetrics__dump(priv->metrics);
+    int policy;
+    for(policy=0;policy<EVENTQUEUE_OVERFLOW_COUNT;policy++){
+        int count = g_atomic_int_get(&priv->overflow_counts[policy]);
+        if(count){
+            C_INFO("EventQueue overflow [%s : %d]",EventQueue__overflow_names[policy],count);
+        }
+    }
+    int pool;
+    int pool_count = g_atomic_int_get(&priv->pool_count);
+    for(pool=EVENTQUEUE_POOL_DEFAULT+1;pool<pool_count;pool++){
+        C_INFO("EventQueue pool '%s' :",priv->pool_names[pool]);
+        EventQueue__dump_metrics(priv->pools[pool]);
+    }
+}
+
+void
+EventQueue__reset_metrics(EventQueue * self){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    EventQueuePrivate *priv = EventQueue__get_instance_private (self);
+    QueueMetrics__reset(priv->metrics);
+    int policy;
+    for(policy=0;policy<EVENTQUEUE_OVERFLOW_COUNT;policy++){
+        g_atomic_int_set(&priv->overflow_counts[policy], 0);
+    }
+    int pool;
+    int pool_count = g_atomic_int_get(&priv->pool_count);
+    for(pool=EVENTQUEUE_POOL_DEFAULT+1;pool<pool_count;pool++){
+        EventQueue__reset_metrics(priv->pools[pool]);
+    }
+}
+
+static void
+EventQueue__metrics_dump_cb(QueueEvent * evt, void * user_data){
+    if(QueueEvent__is_cancelled(evt)){
+        return;
+    }
+    EventQueue__dump_metrics(QUEUE_EVENTQUEUE(user_data));
+}
+
+//Periodically log the metrics from an idle priority event. 0 disables the dump.
+void
+EventQueue__set_metrics_interval(EventQueue * self, int milliseconds){
     g_return_if_fail (self != NULL);
     g_return_if_fail (QUEUE_IS_EVENTQUEUE (self));
+    g_return_if_fail (milliseconds >= 0);
     EventQueuePrivate *priv = EventQueue__get_instance_private (self);
-    P_COND_WAIT(priv->sleep_cond, lock);
-}
\ No newline at end of file
+
+    QueueEvent * dump = NULL;
+    if(milliseconds){
+        QueueEventOptions options = QUEUEEVENT_OPTIONS_INIT;
+        options.priority = QUEUEEVENT_PRIORITY_IDLE;
+        options.delay = milliseconds;
+        options.interval = milliseconds;
+        options.hold = TRUE;
+        dump = EventQueue__insert_plain_with_options(self, &options, self, EventQueue__metrics_dump_cb, self, NULL);
+    }
+
+    P_MUTEX_LOCK(priv->threads_lock);
+    QueueEvent * previous = priv->metrics_dump;
+    priv->metrics_dump = dump;
+    P_MUTEX_UNLOCK(priv->threads_lock);
+
+    if(previous){
+        QueueEvent__try_cancel(previous);
+        g_object_unref(previous);
+    }
+}
@@ -8,7 +8,9 @@ typedef struct _EventQueue EventQueue;
 
 #include "queue_thread.h"
 #include "queue_event.h"
+#include "queue_metrics.h"
 #include "portable_thread.h"
+#include "../utils/thread_sched.h"
 
 G_BEGIN_DECLS
 
@@ -18,9 +20,73 @@ typedef enum {
   EVENTQUEUE_CANCELLED              = 2,
   EVENTQUEUE_ADDED                  = 3,
   EVENTQUEUE_STARTED                = 4,
-  EVENTQUEUE_FINISHED                = 5
+  EVENTQUEUE_FINISHED                = 5,
+  EVENTQUEUE_GROWN                  = 6,
+  EVENTQUEUE_SHRUNK                 = 7
 } QueueEventType;
 
+//What happens when an event with the same scope and callback is already pending
+typedef enum {
+  EVENTQUEUE_COALESCE_NONE          = 0, //Append
+  EVENTQUEUE_COALESCE_KEEP_FIRST    = 1, //Drop the new event and return the pending one
+  EVENTQUEUE_COALESCE_LAST_WINS     = 2  //Cancel the pending event and append the new one
+} QueueEventCoalesce;
+
+//Insertion settings. Start from QUEUEEVENT_OPTIONS_INIT so that new fields keep their defaults.
+typedef struct {
+  QueueEventPriority priority;
+  QueueEventFlags flags;
+  int delay; //Milliseconds before the event becomes ready
+  int interval; //Milliseconds between periodic runs, 0 for a one time event
+  QueueEventCoalesce coalesce;
+  int hold; //Return a new reference released by the caller. Otherwise the returned event is recycled once finished.
+  int timeout; //Milliseconds a dispatched event can run before it expires and its token fires, 0 for none. I/O that ignores the token still holds the worker.
+  int pool; //Named pool running the event, from EventQueue__add_pool. 0 for the default pool.
+} QueueEventOptions;
+
+//One event of a batch inserted with EventQueue__insert_many
+typedef struct {
+  void * scope;
+  QueueEventCallback callback;
+  void * user_data;
+  QueueEventCleanupCallback cleanup_cb;
+} QueueEventEntry;
+
+//How an event inserted with EventQueue__insert_after joins its antecedents
+typedef enum {
+  EVENTQUEUE_JOIN_ALL               = 0, //Ready once every antecedent dispatched. Cancelled as soon as one is cancelled.
+  EVENTQUEUE_JOIN_ANY               = 1  //Ready once any antecedent dispatched. Cancelled once all of them are cancelled.
+} QueueEventJoin;
+
+/*
+ * What an insert does once the pending events reach the capacity of the queue or of their lane.
+ * Refused events are released as cancelled, so their cleanup runs, and the insert returns NULL.
+ */
+typedef enum {
+  EVENTQUEUE_OVERFLOW_BLOCK         = 0, //Wait for room. Queue workers never wait, they go over capacity.
+  EVENTQUEUE_OVERFLOW_REJECT        = 1, //Refuse the new event and report it to the reject callback
+  EVENTQUEUE_OVERFLOW_DROP_OLDEST   = 2, //Cancel the oldest pending event to make room
+  EVENTQUEUE_OVERFLOW_DROP_NEWEST   = 3  //Refuse the new event
+} QueueEventOverflow;
+
+#define EVENTQUEUE_OVERFLOW_COUNT 4
+
+//Called on the inserting thread, before the refused event's cleanup
+typedef void (*QueueEventRejectCallback) (EventQueue * queue, QueueEventPriority lane, void * scope, void * user_data, void * reject_data);
+
+#define QUEUEEVENT_OPTIONS_INIT { QUEUEEVENT_PRIORITY_NORMAL, QUEUEEVENT_FLAG_NONE, 0, 0, EVENTQUEUE_COALESCE_NONE, FALSE, 0, 0 }
+
+#define EVENTQUEUE_DEFAULT_MIN_THREADS 2
+#define EVENTQUEUE_DEFAULT_MAX_THREADS 32
+#define EVENTQUEUE_DEFAULT_GROW_THRESHOLD 200 //Milliseconds an event can wait while every worker is busy
+#define EVENTQUEUE_DEFAULT_IDLE_TIMEOUT 30000 //Milliseconds an extra worker stays idle before exiting
+#define EVENTQUEUE_DEFAULT_STATS_INTERVAL 100 //Milliseconds between pool-stats emissions
+#define EVENTQUEUE_ROOM_POLL 50 //Milliseconds between capacity checks of a blocked producer
+#define EVENTQUEUE_WATCHDOG_FRAMES 64 //Stack frames logged for a stuck worker
+#define EVENTQUEUE_POOL_DEFAULT 0
+#define EVENTQUEUE_MAX_POOLS 8 //Including the default pool
+#define EVENTQUEUE_POOL_CPU_NAME "cpu" //Conventional pool for local CPU bound work
+
 #ifndef g_enum_to_nick
 #define g_enum_to_nick(type,val) (g_enum_get_value(g_type_class_ref (type),val)->value_nick)
 #endif
@@ -44,12 +110,90 @@ EventQueue* EventQueue__new();
 
 QueueEvent * EventQueue__insert(EventQueue* queue, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
 QueueEvent * EventQueue__insert_plain(EventQueue* self, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
+QueueEvent * EventQueue__insert_priority(EventQueue* queue, QueueEventPriority priority, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
+QueueEvent * EventQueue__insert_plain_priority(EventQueue* self, QueueEventPriority priority, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
+QueueEvent * EventQueue__insert_delayed(EventQueue* queue, int delay, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
+QueueEvent * EventQueue__insert_plain_delayed(EventQueue* self, int delay, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
+QueueEvent * EventQueue__insert_periodic(EventQueue* queue, int interval, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
+QueueEvent * EventQueue__insert_plain_periodic(EventQueue* self, int interval, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
+QueueEvent * EventQueue__insert_with_options(EventQueue* queue, const QueueEventOptions * options, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
+QueueEvent * EventQueue__insert_plain_with_options(EventQueue* self, const QueueEventOptions * options, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
+/*
+ * Dependent events stay pending without using a worker until their antecedents resolve,
+ * and cancellations cascade through the graph. Antecedents must be held by the caller
+ * (QueueEventOptions.hold) or be the current event. Delay, interval and coalescing aren't supported.
+ * The overflow policy applies once the dependent becomes ready, and a refused one is cancelled.
+ */
+QueueEvent * EventQueue__insert_after(EventQueue* queue, const QueueEventOptions * options, QueueEventJoin join, QueueEvent ** antecedents, int count, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
+QueueEvent * EventQueue__insert_plain_after(EventQueue* self, const QueueEventOptions * options, QueueEventJoin join, QueueEvent ** antecedents, int count, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
+QueueEvent * EventQueue__then(EventQueue* queue, QueueEvent * antecedent, const QueueEventOptions * options, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), gpointer user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
+QueueEvent * EventQueue__then_plain(EventQueue* self, QueueEvent * antecedent, const QueueEventOptions * options, void * scope, void (*callback)(QueueEvent * qevt, void * user_data), void * user_data, void (*cleanup_cb)(QueueEvent * qevt, int cancelled, void * user_data));
+int EventQueue__insert_many(EventQueue* queue, const QueueEventOptions * options, const QueueEventEntry * entries, int count);
+int EventQueue__insert_plain_many(EventQueue* self, const QueueEventOptions * options, const QueueEventEntry * entries, int count);
 QueueEvent * EventQueue__pop(EventQueue* self);
+void EventQueue__release_event(EventQueue * self, QueueEvent * evt);
 void EventQueue__start(EventQueue* self);
 void EventQueue__stop(EventQueue* self, int nthread);
 int EventQueue__get_thread_count(EventQueue * self);
+int EventQueue__get_pending_count(EventQueue * self);
+int EventQueue__get_lane_pending_count(EventQueue * self, QueueEventPriority priority);
+int EventQueue__get_running_count(EventQueue * self);
+int EventQueue__get_delayed_count(EventQueue * self);
 void EventQueue__cancel_scopes(EventQueue * self, void ** scopes, int count);
-void EventQueue__wait_condition(EventQueue * self, P_MUTEX_TYPE lock);
+void EventQueue__wait_for_event(EventQueue * self);
+void EventQueue__set_pool_limits(EventQueue * self, int min_threads, int max_threads);
+int EventQueue__get_min_threads(EventQueue * self);
+int EventQueue__get_max_threads(EventQueue * self);
+void EventQueue__set_grow_threshold(EventQueue * self, int milliseconds);
+void EventQueue__set_idle_timeout(EventQueue * self, int milliseconds);
+void EventQueue__set_stats_interval(EventQueue * self, int milliseconds);
+void EventQueue__set_ready_ring(EventQueue * self, int capacity);
+/*
+ * Stuck worker watchdog, checked by the pool monitor. 0 milliseconds disables it.
+ * A worker running the same event past the threshold has its callback logged,
+ * and is replaced by a new worker, up to max threads. It exits once the event returns.
+ * Its stack is printed too when built with EVENTQUEUE_WATCHDOG_STACKS and the signal is free.
+ * With cancel, the event is also expired like a missed deadline, so its token aborts cancellable I/O.
+ */
+void EventQueue__set_watchdog(EventQueue * self, int milliseconds, int cancel);
+//Replaced workers still running their stuck event
+int EventQueue__get_stalled_count(EventQueue * self);
+/*
+ * Optional bound on the ready events of the queue, or of one lane, 0 for unbounded.
+ * Only events sitting in the ready lanes count against it. Delayed events on their timer, dependents
+ * waiting on antecedents and strand events queued behind their strand aren't counted, since they hold no worker.
+ * Delayed events bypass the policy, dependents go through it once ready. Lane capacities are checked first.
+ * Concurrent producers can overshoot the capacity by one event each.
+ */
+void EventQueue__set_capacity(EventQueue * self, int capacity, QueueEventOverflow policy);
+void EventQueue__set_lane_capacity(EventQueue * self, QueueEventPriority lane, int capacity, QueueEventOverflow policy);
+void EventQueue__set_reject_callback(EventQueue * self, QueueEventRejectCallback callback, void * reject_data);
+//Events refused or dropped under the policy, or producers that waited for EVENTQUEUE_OVERFLOW_BLOCK
+int EventQueue__get_overflow_count(EventQueue * self, QueueEventOverflow policy);
+/*
+ * Named pools (bulkheads) share the queue API, but each one has its own workers, lanes and limits,
+ * so saturating one pool never delays the events of another. Events are routed with QueueEventOptions.pool.
+ * Scope cancellation, dependencies and signals span every pool. Counters and pool settings are per pool.
+ */
+int EventQueue__add_pool(EventQueue * self, const char * name, int min_threads, int max_threads);
+//Returns EVENTQUEUE_POOL_DEFAULT for an unknown name
+int EventQueue__get_pool_id(EventQueue * self, const char * name);
+//Queue running the events of a pool, to tune it with the setters above. Owned by self.
+EventQueue * EventQueue__get_pool(EventQueue * self, int pool);
+int EventQueue__get_pool_count(EventQueue * self);
+const char * EventQueue__get_pool_name(EventQueue * self, int pool);
+/*
+ * Nice value, SCHED_IDLE and cpu affinity of the workers, applied by each worker as it starts,
+ * and by running workers before their next event. Workers are named "eq-<pool>-<n>".
+ * Per pool, and a new pool starts with the setting of the default pool.
+ */
+void EventQueue__set_thread_sched(EventQueue * self, const ThreadSched * sched);
+void EventQueue__get_thread_sched(EventQueue * self, ThreadSched * sched);
+int EventQueue__get_callback_metrics(EventQueue * self, QueueEventCallback callback, QueueMetricsSummary * summary);
+int EventQueue__get_scope_metrics(EventQueue * self, void * scope, QueueMetricsSummary * summary);
+void EventQueue__dump_metrics(EventQueue * self);
+void EventQueue__reset_metrics(EventQueue * self);
+void EventQueue__set_metrics_interval(EventQueue * self, int milliseconds);
 
 G_END_DECLS
 
@@ -1,5 +1,4 @@
 #include "queue_event.h"
-#include "portable_thread.h"
 #include <stdlib.h>
 #include "clogger.h"
 
@@ -17,14 +16,24 @@ enum {
 
 typedef struct {
     int managed;
-    int cancelled;
-    int finished;
-    P_MUTEX_TYPE prop_lock;
+    gint cancelled;
+    gint finished;
     void * scope;
+    QueueEventPriority priority;
+    gint64 interval; //Microseconds between periodic invocations, 0 for a one time event
+    gint64 timeout; //Microseconds a dispatched event can run before it expires, 0 for none
+    gint expired;
+    GCancellable * cancellable;
+    QueueEventFlags flags;
     QueueEventCallback callback;
     QueueEventCleanupCallback cleanup_cb;
+    QueueEventNotify notify; //Owning queue, called ahead of the state-changed signal
+    void * notify_data;
 
     void * user_data;
+
+    QueueEventNode node;
+    QueueEventNode scope_node;
 } QueueEventPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE(QueueEvent, QueueEvent_, G_TYPE_OBJECT)
@@ -49,13 +58,31 @@ QueueEventState__get_type (void){
         return g_define_type_id__volatile;
 }
 
+GType
+QueueEventPriority__get_type (void){
+        static gsize g_define_type_id__volatile = 0;
+
+        if (g_once_init_enter(&g_define_type_id__volatile)) {
+                static const GEnumValue values[] = {
+                        { QUEUEEVENT_PRIORITY_INTERACTIVE,  "QUEUEEVENT_PRIORITY_INTERACTIVE",  "Interactive"},
+                        { QUEUEEVENT_PRIORITY_NORMAL,       "QUEUEEVENT_PRIORITY_NORMAL",       "Normal"},
+                        { QUEUEEVENT_PRIORITY_BACKGROUND,   "QUEUEEVENT_PRIORITY_BACKGROUND",   "Background"},
+                        { QUEUEEVENT_PRIORITY_IDLE,         "QUEUEEVENT_PRIORITY_IDLE",         "Idle"},
+                        { 0,                                NULL,                               NULL}
+                };
+                GType g_define_type_id = g_enum_register_static(g_intern_static_string("QueueEventPriority"), values);
+                g_once_init_leave(&g_define_type_id__volatile, g_define_type_id);
+        }
+
+        return g_define_type_id__volatile;
+}
+
 static void
-QueueEvent__dispose (GObject *object){
-    QueueEvent * self = QUEUE_QUEUEEVENT(object);
+QueueEvent__release_data(QueueEvent * self){
     QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
 
     if(priv->cleanup_cb){
-        priv->cleanup_cb(self, priv->cancelled, priv->user_data);
+        priv->cleanup_cb(self, g_atomic_int_get(&priv->cancelled), priv->user_data);
         priv->cleanup_cb = NULL;
     }
 
@@ -63,8 +90,49 @@ QueueEvent__dispose (GObject *object){
         g_object_unref(G_OBJECT(priv->user_data));
         priv->managed = FALSE;
     }
+}
 
-    P_MUTEX_CLEANUP(priv->prop_lock);
+static void
+QueueEvent__reset_node(QueueEvent * self, QueueEventNode * node){
+    node->prev = NULL;
+    node->next = NULL;
+    node->list = NULL;
+    node->evt = self;
+    node->running = 0;
+    node->queued_time = 0;
+    node->due_time = 0;
+    node->dispatch_time = 0;
+    node->heap_index = -1;
+}
+
+static void
+QueueEvent__setup(QueueEvent * self, void * scope, QueueEventPriority priority, QueueEventCallback callback, QueueEventCleanupCallback cleanup_cb, void * user_data, int managed){
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+    priv->managed = managed;
+    priv->cancelled = 0;
+    priv->finished = 0;
+    priv->scope = scope;
+    priv->priority = priority;
+    priv->interval = 0;
+    priv->timeout = 0;
+    priv->expired = 0;
+    priv->flags = QUEUEEVENT_FLAG_NONE;
+    priv->callback = callback;
+    priv->cleanup_cb = cleanup_cb;
+    priv->notify = NULL;
+    priv->notify_data = NULL;
+    priv->user_data = user_data;
+    QueueEvent__reset_node(self, &priv->node);
+    QueueEvent__reset_node(self, &priv->scope_node);
+}
+
+static void
+QueueEvent__dispose (GObject *object){
+    QueueEvent * self = QUEUE_QUEUEEVENT(object);
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    QueueEvent__release_data(self);
+    g_clear_object(&priv->cancellable);
 
     G_OBJECT_CLASS (QueueEvent__parent_class)->dispose (object);
 }
@@ -163,35 +231,139 @@ QueueEvent__class_init (QueueEventClass * klass){
 static void 
 QueueEvent__init(QueueEvent * self){
     QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
-    P_MUTEX_SETUP(priv->prop_lock);
-    priv->cancelled = 0;
-    priv->finished = 0;
+    priv->cancellable = NULL;
+    QueueEvent__setup(self, NULL, QUEUEEVENT_PRIORITY_NORMAL, NULL, NULL, NULL, FALSE);
 }
 
 QueueEvent* 
-QueueEvent__new(void * scope, QueueEventCallback callback, QueueEventCleanupCallback cleanup_cb, void * user_data, int managed){
-    QueueEvent * self = g_object_new (QUEUE_TYPE_QUEUEEVENT,
-                        "scope", scope,
-                        "userdata", user_data,
-                        "managed",managed,
-                        NULL);
-    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
-    priv->callback = callback;
-    priv->cleanup_cb = cleanup_cb;
+QueueEvent__new(void * scope, QueueEventPriority priority, QueueEventCallback callback, QueueEventCleanupCallback cleanup_cb, void * user_data, int managed){
+    //Skipping construct properties keeps allocation off the GValue path
+    QueueEvent * self = g_object_new (QUEUE_TYPE_QUEUEEVENT, NULL);
+    QueueEvent__setup(self, scope, priority, callback, cleanup_cb, user_data, managed);
     return self;
 }
 
+int
+QueueEvent__recycle(QueueEvent * self){
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (QUEUE_IS_QUEUEEVENT (self), FALSE);
+
+    /*
+     * Only the sole owner can reset the record. External listeners keep it alive as a regular object.
+     * Everything that keeps a pointer to a queued record outside of a lock also holds a reference to it,
+     * so nobody can take a new reference once the count is down to the caller's own.
+     */
+    if(g_atomic_int_get(&G_OBJECT(self)->ref_count) != 1 || g_signal_has_handler_pending(self, signals[SIGNAL_STATE_CHANGED], 0, FALSE)){
+        return FALSE;
+    }
+
+    QueueEvent__release_data(self);
+    QueueEvent__setup(self, NULL, QUEUEEVENT_PRIORITY_NORMAL, NULL, NULL, NULL, FALSE);
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+    if(priv->cancellable){
+        if(g_atomic_int_get(&G_OBJECT(priv->cancellable)->ref_count) == 1){
+            g_cancellable_reset(priv->cancellable);
+        } else {
+            //Still referenced by I/O started from the callback
+            g_clear_object(&priv->cancellable);
+        }
+    }
+    return TRUE;
+}
+
+void
+QueueEvent__reuse(QueueEvent * self, void * scope, QueueEventPriority priority, QueueEventCallback callback, QueueEventCleanupCallback cleanup_cb, void * user_data, int managed){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_QUEUEEVENT (self));
+    QueueEvent__setup(self, scope, priority, callback, cleanup_cb, user_data, managed);
+}
+
+void
+QueueEvent__set_notify(QueueEvent * self, QueueEventNotify notify, void * notify_data){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_QUEUEEVENT (self));
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    priv->notify = notify;
+    priv->notify_data = notify_data;
+}
+
+static void
+QueueEvent__state_changed(QueueEvent * self, QueueEventState state){
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+    if(priv->notify){
+        priv->notify(self, state, priv->notify_data);
+    }
+    if(g_signal_has_handler_pending(self, signals[SIGNAL_STATE_CHANGED], 0, FALSE)){
+        g_signal_emit (self, signals[SIGNAL_STATE_CHANGED], 0, state);
+    }
+}
+
+int
+QueueEvent__try_cancel(QueueEvent * self){
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (QUEUE_IS_QUEUEEVENT (self), FALSE);
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    if(!g_atomic_int_compare_and_exchange(&priv->cancelled, 0, 1)){
+        return FALSE;
+    }
+    GCancellable * cancellable = g_atomic_pointer_get(&priv->cancellable);
+    if(cancellable){
+        g_cancellable_cancel(cancellable);
+    }
+    QueueEvent__state_changed(self, QUEUEEVENT_CANCELLED);
+    return TRUE;
+}
+
 void 
 QueueEvent__cancel(QueueEvent * self){
     g_return_if_fail (self != NULL);
     g_return_if_fail (QUEUE_IS_QUEUEEVENT (self));
+
+    int cancelled = QueueEvent__try_cancel(self);
+    g_return_if_fail (cancelled);
+}
+
+GCancellable *
+QueueEvent__get_cancellable(QueueEvent * self){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_QUEUEEVENT (self), NULL);
     QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
 
-    g_return_if_fail (priv->cancelled == 0);
-    P_MUTEX_LOCK(priv->prop_lock);
-    priv->cancelled = 1;
-    P_MUTEX_UNLOCK(priv->prop_lock);
-    g_signal_emit (self, signals[SIGNAL_STATE_CHANGED], 0, QUEUEEVENT_CANCELLED);
+    GCancellable * cancellable = g_atomic_pointer_get(&priv->cancellable);
+    if(cancellable){
+        return cancellable;
+    }
+    cancellable = g_cancellable_new();
+    if(!g_atomic_pointer_compare_and_exchange(&priv->cancellable, NULL, cancellable)){
+        g_object_unref(cancellable);
+        return g_atomic_pointer_get(&priv->cancellable);
+    }
+    //Cancelled before the token existed
+    if(g_atomic_int_get(&priv->cancelled)){
+        g_cancellable_cancel(cancellable);
+    }
+    return cancellable;
+}
+
+void
+QueueEvent__expire(QueueEvent * self){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_QUEUEEVENT (self));
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    g_atomic_int_set(&priv->expired, 1);
+    QueueEvent__try_cancel(self);
+}
+
+int
+QueueEvent__is_expired(QueueEvent * self){
+    g_return_val_if_fail (self != NULL, FALSE);
+    g_return_val_if_fail (QUEUE_IS_QUEUEEVENT (self), FALSE);
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    return g_atomic_int_get(&priv->expired);
 }
 
 int 
@@ -200,11 +372,7 @@ QueueEvent__is_cancelled(QueueEvent * self){
     g_return_val_if_fail (QUEUE_IS_QUEUEEVENT (self), FALSE);
     QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
 
-    int ret;
-    P_MUTEX_LOCK(priv->prop_lock);
-    ret = priv->cancelled;
-    P_MUTEX_UNLOCK(priv->prop_lock);
-    return ret;
+    return g_atomic_int_get(&priv->cancelled);
 }
 
 int 
@@ -213,11 +381,7 @@ QueueEvent__is_finished(QueueEvent * self){
     g_return_val_if_fail (QUEUE_IS_QUEUEEVENT (self), TRUE);
     QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
 
-    int ret;
-    P_MUTEX_LOCK(priv->prop_lock);
-    ret = priv->finished;
-    P_MUTEX_UNLOCK(priv->prop_lock);
-    return ret;
+    return g_atomic_int_get(&priv->finished);
 }
 
 void 
@@ -227,23 +391,20 @@ QueueEvent__invoke(QueueEvent * self){
     QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
     if(priv->callback){
         priv->callback(self,priv->user_data);
-        P_MUTEX_LOCK(priv->prop_lock);
-        if(!priv->cancelled){
-            priv->finished = 1;
-        }
-        P_MUTEX_UNLOCK(priv->prop_lock);
-        g_signal_emit (self, signals[SIGNAL_STATE_CHANGED], 0, QUEUEEVENT_DISPATCHED);
     }
-
-    if(priv->cleanup_cb){
-        priv->cleanup_cb(self, priv->cancelled, priv->user_data);
-        priv->cleanup_cb = NULL;
+    int cancelled = g_atomic_int_get(&priv->cancelled);
+    int periodic = priv->interval && !cancelled;
+    if(!cancelled && !periodic){
+        g_atomic_int_set(&priv->finished, 1);
     }
-
-    if(priv->managed){
-        g_object_unref(G_OBJECT(priv->user_data));
-        priv->managed = FALSE;
+    //Reported without a callback too, so the queue accounts for the run and releases its strand
+    QueueEvent__state_changed(self, QUEUEEVENT_DISPATCHED);
+    if(periodic){
+        //Rescheduled by the queue. Cleanup is deferred until it is cancelled or released.
+        return;
     }
+
+    QueueEvent__release_data(self);
 }
 
 void * 
@@ -253,4 +414,103 @@ QueueEvent__get_scope(QueueEvent * self){
     QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
 
     return priv->scope;
-}
\ No newline at end of file
+}
+
+void * 
+QueueEvent__get_user_data(QueueEvent * self){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_QUEUEEVENT (self), NULL);
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    return priv->user_data;
+}
+
+QueueEventPriority 
+QueueEvent__get_priority(QueueEvent * self){
+    g_return_val_if_fail (self != NULL, QUEUEEVENT_PRIORITY_NORMAL);
+    g_return_val_if_fail (QUEUE_IS_QUEUEEVENT (self), QUEUEEVENT_PRIORITY_NORMAL);
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    return priv->priority;
+}
+
+QueueEventCallback 
+QueueEvent__get_callback(QueueEvent * self){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_QUEUEEVENT (self), NULL);
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    return priv->callback;
+}
+
+QueueEventNode * 
+QueueEvent__get_node(QueueEvent * self){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_QUEUEEVENT (self), NULL);
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    return &priv->node;
+}
+
+QueueEventNode * 
+QueueEvent__get_scope_node(QueueEvent * self){
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (QUEUE_IS_QUEUEEVENT (self), NULL);
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    return &priv->scope_node;
+}
+
+void 
+QueueEvent__set_flags(QueueEvent * self, QueueEventFlags flags){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_QUEUEEVENT (self));
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    priv->flags = flags;
+}
+
+QueueEventFlags 
+QueueEvent__get_flags(QueueEvent * self){
+    g_return_val_if_fail (self != NULL, QUEUEEVENT_FLAG_NONE);
+    g_return_val_if_fail (QUEUE_IS_QUEUEEVENT (self), QUEUEEVENT_FLAG_NONE);
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    return priv->flags;
+}
+
+void 
+QueueEvent__set_interval(QueueEvent * self, gint64 interval){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_QUEUEEVENT (self));
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    priv->interval = interval;
+}
+
+gint64 
+QueueEvent__get_interval(QueueEvent * self){
+    g_return_val_if_fail (self != NULL, 0);
+    g_return_val_if_fail (QUEUE_IS_QUEUEEVENT (self), 0);
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    return priv->interval;
+}
+
+void 
+QueueEvent__set_timeout(QueueEvent * self, gint64 timeout){
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (QUEUE_IS_QUEUEEVENT (self));
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    priv->timeout = timeout;
+}
+
+gint64 
+QueueEvent__get_timeout(QueueEvent * self){
+    g_return_val_if_fail (self != NULL, 0);
+    g_return_val_if_fail (QUEUE_IS_QUEUEEVENT (self), 0);
+    QueueEventPrivate *priv = QueueEvent__get_instance_private (self);
+
+    return priv->timeout;
+}
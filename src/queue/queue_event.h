@@ -3,6 +3,7 @@
 
 
 #include <glib-object.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -15,6 +16,20 @@ typedef void (*QueueEventCallback) (QueueEvent  *self, void * user_data);
 typedef void (*QueueEventCleanupCallback) (QueueEvent  *self, int cancelled, void * user_data);
 #define QUEUEEVENT_CLEANUP_FUNC(f) ((QueueEventCleanupCallback) (void (*)(void)) (f))
 
+//Intrusive link embedded in every event. Used by EventQueue to chain events without allocation.
+typedef struct _QueueEventNode QueueEventNode;
+struct _QueueEventNode {
+  QueueEventNode * prev;
+  QueueEventNode * next;
+  void * list; //Owning list, NULL when unlinked
+  QueueEvent * evt;
+  gint running; //Set by EventQueue once the event is dispatched
+  gint64 queued_time; //Monotonic time at which EventQueue made the event ready
+  gint64 due_time; //Monotonic time at which a delayed event becomes ready
+  gint64 dispatch_time; //Monotonic time at which a worker popped the event
+  int heap_index; //Position in the EventQueue timer or deadline heap, -1 when not scheduled
+};
+
 struct _QueueEvent {
   GObject parent_instance;
 };
@@ -28,6 +43,24 @@ typedef enum {
   QUEUEEVENT_CANCELLED              = 1
 } QueueEventState;
 
+//Priority lanes, drained in order with starvation protection for the lower lanes
+typedef enum {
+  QUEUEEVENT_PRIORITY_INTERACTIVE   = 0,
+  QUEUEEVENT_PRIORITY_NORMAL        = 1,
+  QUEUEEVENT_PRIORITY_BACKGROUND    = 2,
+  QUEUEEVENT_PRIORITY_IDLE          = 3
+} QueueEventPriority;
+
+#define QUEUEEVENT_PRIORITY_COUNT 4
+
+typedef enum {
+  QUEUEEVENT_FLAG_NONE              = 0,
+  QUEUEEVENT_FLAG_STRAND            = 1 << 0 //Run one at a time with the other strand events of its scope, by priority then in order
+} QueueEventFlags;
+
+//Direct state notification used by the owning queue, avoiding a signal connection per event
+typedef void (*QueueEventNotify) (QueueEvent * self, QueueEventState state, void * notify_data);
+
 #ifndef g_enum_to_nick
 #define g_enum_to_nick(type,val) (g_enum_get_value(g_type_class_ref (type),val)->value_nick)
 #endif
@@ -35,12 +68,43 @@ typedef enum {
 GType QueueEventState__get_type (void) G_GNUC_CONST;
 #define QUEUE_TYPE_EVENTSTATE (QueueEventState__get_type())
 
-QueueEvent* QueueEvent__new(void * scope, QueueEventCallback callback, QueueEventCleanupCallback cleanup_cb, void * user_data, int managed);
+GType QueueEventPriority__get_type (void) G_GNUC_CONST;
+#define QUEUE_TYPE_EVENTPRIORITY (QueueEventPriority__get_type())
+
+QueueEvent* QueueEvent__new(void * scope, QueueEventPriority priority, QueueEventCallback callback, QueueEventCleanupCallback cleanup_cb, void * user_data, int managed);
 void * QueueEvent__get_scope(QueueEvent * evt);
+void * QueueEvent__get_user_data(QueueEvent * self);
+QueueEventPriority QueueEvent__get_priority(QueueEvent * self);
+QueueEventCallback QueueEvent__get_callback(QueueEvent * self);
 void QueueEvent__cancel(QueueEvent * self);
+//Same as QueueEvent__cancel, for events that a deadline, the watchdog or another thread may cancel first. Returns FALSE if it already was.
+int QueueEvent__try_cancel(QueueEvent * self);
 int QueueEvent__is_cancelled(QueueEvent * self);
 int QueueEvent__is_finished(QueueEvent * self);
 void QueueEvent__invoke(QueueEvent * self);
+QueueEventNode * QueueEvent__get_node(QueueEvent * self);
+QueueEventNode * QueueEvent__get_scope_node(QueueEvent * self);
+//Flags and interval are set before the event is queued and read lock-free afterwards
+void QueueEvent__set_flags(QueueEvent * self, QueueEventFlags flags);
+QueueEventFlags QueueEvent__get_flags(QueueEvent * self);
+void QueueEvent__set_interval(QueueEvent * self, gint64 interval);
+gint64 QueueEvent__get_interval(QueueEvent * self);
+void QueueEvent__set_timeout(QueueEvent * self, gint64 timeout);
+gint64 QueueEvent__get_timeout(QueueEvent * self);
+/*
+ * Token fired when the event is cancelled or runs past its deadline.
+ * Created on first use and owned by the event. Pass it to cancellable I/O from the callback.
+ */
+GCancellable * QueueEvent__get_cancellable(QueueEvent * self);
+void QueueEvent__expire(QueueEvent * self);
+int QueueEvent__is_expired(QueueEvent * self);
+void QueueEvent__set_notify(QueueEvent * self, QueueEventNotify notify, void * notify_data);
+/*
+ * Runs the pending cleanup and clears the record so it can be reused.
+ * Fails if anyone else holds a reference or listens to "state-changed".
+ */
+int QueueEvent__recycle(QueueEvent * self);
+void QueueEvent__reuse(QueueEvent * self, void * scope, QueueEventPriority priority, QueueEventCallback callback, QueueEventCleanupCallback cleanup_cb, void * user_data, int managed);
 
 G_END_DECLS
 
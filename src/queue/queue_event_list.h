@@ -0,0 +1,112 @@
+#ifndef QUEUE_EVENT_LIST_H_
+#define QUEUE_EVENT_LIST_H_
+
+#include "queue_event.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Intrusive doubly linked list of QueueEvent nodes.
+ * Nodes are embedded in the QueueEvent itself, so linking and unlinking never allocates.
+ * A node can only belong to one list at a time. The caller is responsible for locking.
+ */
+typedef struct {
+    QueueEventNode * head;
+    QueueEventNode * tail;
+    int length;
+} QueueEventList;
+
+static inline void
+QueueEventList__init(QueueEventList * list){
+    list->head = NULL;
+    list->tail = NULL;
+    list->length = 0;
+}
+
+static inline int
+QueueEventList__contains(QueueEventList * list, QueueEventNode * node){
+    return node->list == list;
+}
+
+static inline void
+QueueEventList__push_tail(QueueEventList * list, QueueEventNode * node){
+    node->list = list;
+    node->next = NULL;
+    node->prev = list->tail;
+    if(list->tail){
+        list->tail->next = node;
+    } else {
+        list->head = node;
+    }
+    list->tail = node;
+    list->length++;
+}
+
+static inline void
+QueueEventList__push_head(QueueEventList * list, QueueEventNode * node){
+    node->list = list;
+    node->prev = NULL;
+    node->next = list->head;
+    if(list->head){
+        list->head->prev = node;
+    } else {
+        list->tail = node;
+    }
+    list->head = node;
+    list->length++;
+}
+
+//Link the node right after pos, or at the head when pos is NULL
+static inline void
+QueueEventList__insert_after(QueueEventList * list, QueueEventNode * pos, QueueEventNode * node){
+    if(!pos){
+        QueueEventList__push_head(list, node);
+        return;
+    }
+    node->list = list;
+    node->prev = pos;
+    node->next = pos->next;
+    if(pos->next){
+        pos->next->prev = node;
+    } else {
+        list->tail = node;
+    }
+    pos->next = node;
+    list->length++;
+}
+
+static inline void
+QueueEventList__remove(QueueEventList * list, QueueEventNode * node){
+    if(node->prev){
+        node->prev->next = node->next;
+    } else {
+        list->head = node->next;
+    }
+    if(node->next){
+        node->next->prev = node->prev;
+    } else {
+        list->tail = node->prev;
+    }
+    node->prev = NULL;
+    node->next = NULL;
+    node->list = NULL;
+    list->length--;
+}
+
+static inline QueueEventNode *
+QueueEventList__pop_head(QueueEventList * list){
+    QueueEventNode * node = list->head;
+    if(node) QueueEventList__remove(list, node);
+    return node;
+}
+
+static inline QueueEventNode *
+QueueEventList__pop_tail(QueueEventList * list){
+    QueueEventNode * node = list->tail;
+    if(node) QueueEventList__remove(list, node);
+    return node;
+}
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,287 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <string.h>
+#include "queue_metrics.h"
+#include "clogger.h"
+
+#define QUEUEMETRICS_MAX_SCOPES 256
+
+typedef struct {
+    gint64 counts[QUEUEMETRICS_BUCKET_COUNT];
+    gint64 count;
+    gint64 sum;
+    gint64 max;
+} QueueMetricsHistogram;
+
+typedef struct {
+    char * name;
+    QueueMetricsHistogram wait;
+    QueueMetricsHistogram run;
+} QueueMetricsEntry;
+
+/*
+ * Workers record concurrently under the reader lock, with relaxed atomic updates of the histograms.
+ * The writer lock is only taken to add or remove entries, so known callbacks never serialise the workers.
+ */
+struct _QueueMetrics {
+    GHashTable * callbacks; //QueueEventCallback -> QueueMetricsEntry
+    GHashTable * scopes; //scope pointer -> QueueMetricsEntry
+    GRWLock lock;
+};
+
+static int
+QueueMetrics__bucket_index(gint64 value){
+    if(value < 0){
+        value = 0;
+    }
+    if(value < (1 << QUEUEMETRICS_SUB_BUCKET_BITS)){
+        return (int) value;
+    }
+    int msb = 63 - __builtin_clzll((unsigned long long) value);
+    int shift = msb - QUEUEMETRICS_SUB_BUCKET_BITS;
+    int index = ((msb - QUEUEMETRICS_SUB_BUCKET_BITS + 1) << QUEUEMETRICS_SUB_BUCKET_BITS) + (int) ((value >> shift) & ((1 << QUEUEMETRICS_SUB_BUCKET_BITS) - 1));
+    return (index < QUEUEMETRICS_BUCKET_COUNT) ? index : QUEUEMETRICS_BUCKET_COUNT - 1;
+}
+
+//Highest value recorded in a bucket
+static gint64
+QueueMetrics__bucket_value(int index){
+    int magnitude = index >> QUEUEMETRICS_SUB_BUCKET_BITS;
+    gint64 sub = index & ((1 << QUEUEMETRICS_SUB_BUCKET_BITS) - 1);
+    if(magnitude == 0){
+        return sub;
+    }
+    int shift = magnitude - 1;
+    return (((1 << QUEUEMETRICS_SUB_BUCKET_BITS) + sub + 1) << shift) - 1;
+}
+
+static void
+QueueMetrics__histogram_record(QueueMetricsHistogram * histogram, gint64 value){
+    __atomic_fetch_add(&histogram->counts[QueueMetrics__bucket_index(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->sum, value, __ATOMIC_RELAXED);
+    gint64 max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+    while(value > max && !__atomic_compare_exchange_n(&histogram->max, &max, value, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+//Copy taken while workers may still be recording. Counters can be off by the events in flight.
+static void
+QueueMetrics__histogram_load(QueueMetricsHistogram * histogram, QueueMetricsHistogram * out){
+    int i;
+    for(i=0;i<QUEUEMETRICS_BUCKET_COUNT;i++){
+        out->counts[i] = __atomic_load_n(&histogram->counts[i], __ATOMIC_RELAXED);
+    }
+    out->count = __atomic_load_n(&histogram->count, __ATOMIC_RELAXED);
+    out->sum = __atomic_load_n(&histogram->sum, __ATOMIC_RELAXED);
+    out->max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+}
+
+static gint64
+QueueMetrics__histogram_percentile(QueueMetricsHistogram * histogram, double percentile){
+    gint64 rank = (gint64) (histogram->count * percentile / 100.0 + 0.5);
+    gint64 seen = 0;
+    int i;
+    if(rank < 1){
+        rank = 1;
+    }
+    for(i=0;i<QUEUEMETRICS_BUCKET_COUNT;i++){
+        seen += histogram->counts[i];
+        if(seen >= rank){
+            gint64 value = QueueMetrics__bucket_value(i);
+            return (value < histogram->max) ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+static void
+QueueMetrics__histogram_summary(QueueMetricsHistogram * recorded, QueueMetricsPercentiles * out){
+    QueueMetricsHistogram copy;
+    QueueMetricsHistogram * histogram = &copy;
+    QueueMetrics__histogram_load(recorded, &copy);
+    out->count = histogram->count;
+    if(!histogram->count){
+        out->mean = out->p50 = out->p95 = out->p99 = out->max = 0;
+        return;
+    }
+    out->mean = histogram->sum / histogram->count;
+    out->p50 = QueueMetrics__histogram_percentile(histogram, 50);
+    out->p95 = QueueMetrics__histogram_percentile(histogram, 95);
+    out->p99 = QueueMetrics__histogram_percentile(histogram, 99);
+    out->max = histogram->max;
+}
+
+//Exported symbols resolve by name. Static ones fall back to an offset usable with addr2line.
+char *
+QueueMetrics__callback_name(QueueEventCallback callback){
+    void * address = GSIZE_TO_POINTER((gsize) callback);
+    Dl_info info;
+    if(dladdr(address, &info)){
+        if(info.dli_sname){
+            return g_strdup(info.dli_sname);
+        }
+        if(info.dli_fname){
+            const char * module = strrchr(info.dli_fname, '/');
+            return g_strdup_printf("%s+%#lx", module ? module + 1 : info.dli_fname, (unsigned long) ((char *) address - (char *) info.dli_fbase));
+        }
+    }
+    return g_strdup_printf("%p", address);
+}
+
+static void
+QueueMetrics__entry_free(gpointer data){
+    QueueMetricsEntry * entry = data;
+    g_free(entry->name);
+    g_free(entry);
+}
+
+static QueueMetricsEntry *
+QueueMetrics__entry_new(char * name){
+    QueueMetricsEntry * entry = g_new0(QueueMetricsEntry, 1);
+    entry->name = name;
+    return entry;
+}
+
+QueueMetrics *
+QueueMetrics__new(void){
+    QueueMetrics * self = g_new0(QueueMetrics, 1);
+    self->callbacks = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, QueueMetrics__entry_free);
+    self->scopes = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, QueueMetrics__entry_free);
+    g_rw_lock_init(&self->lock);
+    return self;
+}
+
+void
+QueueMetrics__destroy(QueueMetrics * self){
+    if(!self){
+        return;
+    }
+    g_hash_table_destroy(self->callbacks);
+    g_hash_table_destroy(self->scopes);
+    g_rw_lock_clear(&self->lock);
+    g_free(self);
+}
+
+//Adds the missing entries under the writer lock. Returns with the reader lock held.
+static void
+QueueMetrics__add_entries(QueueMetrics * self, QueueEventCallback callback, void * scope){
+    gpointer key = GSIZE_TO_POINTER((gsize) callback);
+    g_rw_lock_writer_lock(&self->lock);
+    if(!g_hash_table_lookup(self->callbacks, key)){
+        g_hash_table_insert(self->callbacks, key, QueueMetrics__entry_new(QueueMetrics__callback_name(callback)));
+    }
+    if(scope && !g_hash_table_lookup(self->scopes, scope) && g_hash_table_size(self->scopes) < QUEUEMETRICS_MAX_SCOPES){
+        g_hash_table_insert(self->scopes, scope, QueueMetrics__entry_new(g_strdup_printf("%p", scope)));
+    }
+    g_rw_lock_writer_unlock(&self->lock);
+    g_rw_lock_reader_lock(&self->lock);
+}
+
+void
+QueueMetrics__record(QueueMetrics * self, QueueEventCallback callback, void * scope, gint64 wait, gint64 run){
+    gpointer key = GSIZE_TO_POINTER((gsize) callback);
+    g_rw_lock_reader_lock(&self->lock);
+    QueueMetricsEntry * entry = g_hash_table_lookup(self->callbacks, key);
+    QueueMetricsEntry * scope_entry = (scope) ? g_hash_table_lookup(self->scopes, scope) : NULL;
+    if(!entry || (scope && !scope_entry && g_hash_table_size(self->scopes) < QUEUEMETRICS_MAX_SCOPES)){
+        g_rw_lock_reader_unlock(&self->lock);
+        QueueMetrics__add_entries(self, callback, scope);
+        entry = g_hash_table_lookup(self->callbacks, key);
+        scope_entry = (scope) ? g_hash_table_lookup(self->scopes, scope) : NULL;
+    }
+    //Removed by a reset in between
+    if(entry){
+        QueueMetrics__histogram_record(&entry->wait, wait);
+        QueueMetrics__histogram_record(&entry->run, run);
+    }
+    if(scope_entry){
+        QueueMetrics__histogram_record(&scope_entry->wait, wait);
+        QueueMetrics__histogram_record(&scope_entry->run, run);
+    }
+    g_rw_lock_reader_unlock(&self->lock);
+}
+
+static int
+QueueMetrics__get_entry(QueueMetrics * self, GHashTable * table, gpointer key, QueueMetricsSummary * summary){
+    int ret = FALSE;
+    g_rw_lock_reader_lock(&self->lock);
+    QueueMetricsEntry * entry = g_hash_table_lookup(table, key);
+    if(entry){
+        QueueMetrics__histogram_summary(&entry->wait, &summary->wait);
+        QueueMetrics__histogram_summary(&entry->run, &summary->run);
+        ret = TRUE;
+    }
+    g_rw_lock_reader_unlock(&self->lock);
+    return ret;
+}
+
+int
+QueueMetrics__get_callback(QueueMetrics * self, QueueEventCallback callback, QueueMetricsSummary * summary){
+    return QueueMetrics__get_entry(self, self->callbacks, GSIZE_TO_POINTER((gsize) callback), summary);
+}
+
+int
+QueueMetrics__get_scope(QueueMetrics * self, void * scope, QueueMetricsSummary * summary){
+    return QueueMetrics__get_entry(self, self->scopes, scope, summary);
+}
+
+void
+QueueMetrics__forget_scope(QueueMetrics * self, void * scope){
+    g_rw_lock_writer_lock(&self->lock);
+    g_hash_table_remove(self->scopes, scope);
+    g_rw_lock_writer_unlock(&self->lock);
+}
+
+void
+QueueMetrics__reset(QueueMetrics * self){
+    g_rw_lock_writer_lock(&self->lock);
+    g_hash_table_remove_all(self->callbacks);
+    g_hash_table_remove_all(self->scopes);
+    g_rw_lock_writer_unlock(&self->lock);
+}
+
+//Busiest first, by total run time
+static gint
+QueueMetrics__compare_run_time(gconstpointer a, gconstpointer b){
+    const QueueMetricsEntry * entry_a = *(QueueMetricsEntry * const *) a;
+    const QueueMetricsEntry * entry_b = *(QueueMetricsEntry * const *) b;
+    gint64 sum_a = __atomic_load_n(&entry_a->run.sum, __ATOMIC_RELAXED);
+    gint64 sum_b = __atomic_load_n(&entry_b->run.sum, __ATOMIC_RELAXED);
+    if(sum_a == sum_b){
+        return 0;
+    }
+    return (sum_a < sum_b) ? 1 : -1;
+}
+
+static void
+QueueMetrics__dump_table(GHashTable * table, const char * kind){
+    GPtrArray * entries = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, table);
+    while(g_hash_table_iter_next(&iter, NULL, &value)){
+        g_ptr_array_add(entries, value);
+    }
+    g_ptr_array_sort(entries, QueueMetrics__compare_run_time);
+
+    guint i;
+    for(i=0;i<entries->len;i++){
+        QueueMetricsEntry * entry = g_ptr_array_index(entries, i);
+        QueueMetricsSummary summary;
+        QueueMetrics__histogram_summary(&entry->wait, &summary.wait);
+        QueueMetrics__histogram_summary(&entry->run, &summary.run);
+        C_INFO("[%s %s] count %" G_GINT64_FORMAT " wait p50/p95/p99 %" G_GINT64_FORMAT "/%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT "us run p50/p95/p99/max %" G_GINT64_FORMAT "/%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT "us",
+            kind, entry->name, summary.run.count,
+            summary.wait.p50, summary.wait.p95, summary.wait.p99,
+            summary.run.p50, summary.run.p95, summary.run.p99, summary.run.max);
+    }
+    g_ptr_array_free(entries, TRUE);
+}
+
+void
+QueueMetrics__dump(QueueMetrics * self){
+    g_rw_lock_reader_lock(&self->lock);
+    QueueMetrics__dump_table(self->callbacks, "callback");
+    QueueMetrics__dump_table(self->scopes, "scope");
+    g_rw_lock_reader_unlock(&self->lock);
+}
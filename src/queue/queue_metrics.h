@@ -0,0 +1,45 @@
+#ifndef QUEUE_METRICS_H_
+#define QUEUE_METRICS_H_
+
+#include "queue_event.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Log-linear latency histograms. Each power of two is split in 8 linear sub-buckets,
+ * which bounds the recording error to 12.5% without allocating.
+ */
+#define QUEUEMETRICS_SUB_BUCKET_BITS 3
+#define QUEUEMETRICS_MAGNITUDES 44 //Up to 2^44 microseconds
+#define QUEUEMETRICS_BUCKET_COUNT (QUEUEMETRICS_MAGNITUDES << QUEUEMETRICS_SUB_BUCKET_BITS)
+
+typedef struct {
+  gint64 count;
+  gint64 mean; //Microseconds
+  gint64 p50;
+  gint64 p95;
+  gint64 p99;
+  gint64 max;
+} QueueMetricsPercentiles;
+
+typedef struct {
+  QueueMetricsPercentiles wait; //Ready to dispatched
+  QueueMetricsPercentiles run; //Dispatched to finished
+} QueueMetricsSummary;
+
+typedef struct _QueueMetrics QueueMetrics;
+
+QueueMetrics * QueueMetrics__new(void);
+void QueueMetrics__destroy(QueueMetrics * self);
+void QueueMetrics__record(QueueMetrics * self, QueueEventCallback callback, void * scope, gint64 wait, gint64 run);
+int QueueMetrics__get_callback(QueueMetrics * self, QueueEventCallback callback, QueueMetricsSummary * summary);
+int QueueMetrics__get_scope(QueueMetrics * self, void * scope, QueueMetricsSummary * summary);
+void QueueMetrics__forget_scope(QueueMetrics * self, void * scope);
+void QueueMetrics__reset(QueueMetrics * self);
+void QueueMetrics__dump(QueueMetrics * self);
+//Symbol name of the callback, or module and offset when it isn't exported. Free with g_free.
+char * QueueMetrics__callback_name(QueueEventCallback callback);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,112 @@
+#include "queue_ring.h"
+
+#define QUEUERING_CACHE_LINE 64
+
+typedef struct {
+    gsize sequence;
+    QueueEventNode * node;
+    gint64 queued_time;
+} QueueRingCell;
+
+//Positions are kept on separate cache lines, so producers and consumers don't share one
+struct _QueueRing {
+    QueueRingCell * cells;
+    gsize mask;
+    char pad0[QUEUERING_CACHE_LINE];
+    gsize enqueue_pos;
+    char pad1[QUEUERING_CACHE_LINE];
+    gsize dequeue_pos;
+    char pad2[QUEUERING_CACHE_LINE];
+};
+
+QueueRing *
+QueueRing__new(int capacity){
+    gsize size = 2;
+    gsize i;
+    while(size < (gsize) capacity){
+        size <<= 1;
+    }
+
+    QueueRing * self = g_new0(QueueRing, 1);
+    self->cells = g_new0(QueueRingCell, size);
+    self->mask = size - 1;
+    for(i=0;i<size;i++){
+        self->cells[i].sequence = i;
+    }
+    self->enqueue_pos = 0;
+    self->dequeue_pos = 0;
+    return self;
+}
+
+void
+QueueRing__destroy(QueueRing * self){
+    if(!self){
+        return;
+    }
+    g_free(self->cells);
+    g_free(self);
+}
+
+int
+QueueRing__get_capacity(QueueRing * self){
+    return (int) (self->mask + 1);
+}
+
+/*
+ * A cell is free for position pos when its sequence equals pos,
+ * and holds the node published for pos once its sequence equals pos + 1.
+ */
+int
+QueueRing__push(QueueRing * self, QueueEventNode * node, gint64 queued_time){
+    gsize pos = __atomic_load_n(&self->enqueue_pos, __ATOMIC_RELAXED);
+    for(;;){
+        QueueRingCell * cell = &self->cells[pos & self->mask];
+        gsize sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        gssize diff = (gssize) sequence - (gssize) pos;
+        if(diff == 0){
+            if(__atomic_compare_exchange_n(&self->enqueue_pos, &pos, pos + 1, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+                cell->node = node;
+                __atomic_store_n(&cell->queued_time, queued_time, __ATOMIC_RELAXED);
+                __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+                return TRUE;
+            }
+        } else if(diff < 0){
+            return FALSE;
+        } else {
+            pos = __atomic_load_n(&self->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+QueueEventNode *
+QueueRing__pop(QueueRing * self){
+    gsize pos = __atomic_load_n(&self->dequeue_pos, __ATOMIC_RELAXED);
+    for(;;){
+        QueueRingCell * cell = &self->cells[pos & self->mask];
+        gsize sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        gssize diff = (gssize) sequence - (gssize) (pos + 1);
+        if(diff == 0){
+            if(__atomic_compare_exchange_n(&self->dequeue_pos, &pos, pos + 1, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+                QueueEventNode * node = cell->node;
+                //Hands the cell back to producers one lap later
+                __atomic_store_n(&cell->sequence, pos + self->mask + 1, __ATOMIC_RELEASE);
+                return node;
+            }
+        } else if(diff < 0){
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&self->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+gint64
+QueueRing__peek_time(QueueRing * self){
+    gsize pos = __atomic_load_n(&self->dequeue_pos, __ATOMIC_RELAXED);
+    QueueRingCell * cell = &self->cells[pos & self->mask];
+    if(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) != pos + 1){
+        return 0;
+    }
+    //Only a hint for the pool monitor, the cell may be consumed meanwhile
+    return __atomic_load_n(&cell->queued_time, __ATOMIC_RELAXED);
+}
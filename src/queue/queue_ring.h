@@ -0,0 +1,27 @@
+#ifndef QUEUE_RING_H_
+#define QUEUE_RING_H_
+
+#include "queue_event.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Bounded multi-producer multi-consumer ring of QueueEvent nodes.
+ * Each cell carries a sequence number, so producers and consumers only contend
+ * on the position counters with a compare and exchange, without any lock.
+ */
+typedef struct _QueueRing QueueRing;
+
+QueueRing * QueueRing__new(int capacity); //Rounded up to a power of two
+void QueueRing__destroy(QueueRing * self);
+int QueueRing__get_capacity(QueueRing * self);
+//Returns FALSE when the ring is full
+int QueueRing__push(QueueRing * self, QueueEventNode * node, gint64 queued_time);
+//Returns NULL when the ring is empty
+QueueEventNode * QueueRing__pop(QueueRing * self);
+//Queued time of the oldest cell, without dereferencing its node. 0 when empty.
+gint64 QueueRing__peek_time(QueueRing * self);
+
+G_END_DECLS
+
+#endif
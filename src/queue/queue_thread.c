@@ -20,9 +20,11 @@ typedef struct {
     P_THREAD_TYPE pthread;
     int started;
     EventQueue * queue;
-    P_MUTEX_TYPE sleep_lock;
     P_MUTEX_TYPE cancel_lock;
     int terminated;
+    //Event being invoked, and since when. Under cancel_lock, for the watchdog.
+    QueueEvent * running;
+    gint64 running_since;
 } QueueThreadPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE(QueueThread, QueueThread_, G_TYPE_OBJECT)
@@ -50,7 +52,6 @@ QueueThreadState__get_type (void){
 static void 
 QueueThread__dispose(GObject * obj){
     QueueThreadPrivate *priv = QueueThread__get_instance_private (QUEUE_THREAD(obj));
-    P_MUTEX_CLEANUP(priv->sleep_lock);
     P_MUTEX_CLEANUP(priv->cancel_lock);
     priv->started = 0;
     priv->terminated = 0;
@@ -76,6 +77,16 @@ QueueThread__get_current(){
     return queue_thread;
 }
 
+//Cleared before the event is released, so a reference taken under the lock always targets the running record
+static void
+QueueThread__set_running(QueueThread * self, QueueEvent * evt){
+    QueueThreadPrivate *priv = QueueThread__get_instance_private (self);
+    P_MUTEX_LOCK(priv->cancel_lock);
+    priv->running = evt;
+    priv->running_since = (evt) ? g_get_monotonic_time() : 0;
+    P_MUTEX_UNLOCK(priv->cancel_lock);
+}
+
 static void * 
 priv_QueueThread_call(void * data){
     queue_thread = (QueueThread*) data;
@@ -88,19 +99,16 @@ priv_QueueThread_call(void * data){
         queue_event = EventQueue__pop(priv->queue);
 
         if(!queue_event){
-            P_MUTEX_LOCK(priv->sleep_lock);
-            if(QueueThread__is_terminated(queue_thread)){
-                P_MUTEX_UNLOCK(priv->sleep_lock);
-                goto exit;
-            }
-            EventQueue__wait_condition(priv->queue,priv->sleep_lock);
-            P_MUTEX_UNLOCK(priv->sleep_lock);
+            EventQueue__wait_for_event(priv->queue);
             continue;
         }
         
+        QueueThread__set_running(queue_thread, queue_event);
         QueueEvent__invoke(queue_event);
-        g_object_unref(queue_event);
+        QueueEvent * finished = queue_event;
         queue_event = NULL;
+        QueueThread__set_running(queue_thread, NULL);
+        EventQueue__release_event(priv->queue, finished);
     }
 
 exit:
@@ -184,10 +192,11 @@ QueueThread__init(QueueThread * self){
     QueueThreadPrivate *priv = QueueThread__get_instance_private (self);
     priv->queue = NULL;
     
-    P_MUTEX_SETUP(priv->sleep_lock);
     P_MUTEX_SETUP(priv->cancel_lock);
     priv->started = 0;
     priv->terminated = 0;
+    priv->running = NULL;
+    priv->running_since = 0;
 }
 
 void 
@@ -236,4 +245,19 @@ QueueThread__get_thread(QueueThread* self){
     g_return_val_if_fail (QUEUE_IS_THREAD (self),FALSE);
     QueueThreadPrivate *priv = QueueThread__get_instance_private (self);
     return priv->pthread;
-}
\ No newline at end of file
+}
+
+QueueEvent *
+QueueThread__ref_running(QueueThread * self, gint64 since){
+    g_return_val_if_fail (self != NULL,NULL);
+    g_return_val_if_fail (QUEUE_IS_THREAD (self),NULL);
+    QueueThreadPrivate *priv = QueueThread__get_instance_private (self);
+
+    QueueEvent * evt = NULL;
+    P_MUTEX_LOCK(priv->cancel_lock);
+    if(priv->running && priv->running_since <= since){
+        evt = g_object_ref(priv->running);
+    }
+    P_MUTEX_UNLOCK(priv->cancel_lock);
+    return evt;
+}
@@ -36,11 +36,19 @@ struct _QueueThreadClass {
   GObjectClass parent_class;
 };
 
-QueueThread * QueueThread__new(EventQueue* queue); 
+/*
+ * Each QueueThread runs its events on its own OS thread, one at a time.
+ * Callbacks blocking on the network are expected to hold their worker, and the elastic pool grows for them.
+ * Events aren't switched as coroutines on a shared thread, since the SOAP transport blocks inside onvifsoap
+ * without a yield point, and a callback may hold locks or thread-locals (QueueEvent__get_current) across a wait.
+ */
+QueueThread * QueueThread__new(EventQueue* queue);
 void QueueThread__terminate(QueueThread* self);
 int QueueThread__is_terminated(QueueThread* self);
 void QueueThread__start(QueueThread * self);
 P_THREAD_TYPE QueueThread__get_thread(QueueThread* self);
+//Referenced event the thread has been running since the monotonic time 'since' or earlier. NULL otherwise.
+QueueEvent * QueueThread__ref_running(QueueThread * self, gint64 since);
 
 //Thread-local function returning the current context pointers
 //Designed to be used within background events
@@ -0,0 +1,246 @@
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE
+#endif
+#include "thread_sched.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include "clogger.h"
+
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+    #include <unistd.h>
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+#endif
+
+#ifndef TRUE
+    #define TRUE 1
+#endif
+#ifndef FALSE
+    #define FALSE 0
+#endif
+
+#ifdef __linux__
+static int
+ThreadSched__apply_policy(const ThreadSched * sched){
+    struct sched_param param;
+    int policy;
+    if(pthread_getschedparam(pthread_self(), &policy, &param)){
+        return FALSE;
+    }
+    int target = sched->idle ? SCHED_IDLE : SCHED_OTHER;
+    if(policy == target){
+        return TRUE;
+    }
+    //Leaving SCHED_IDLE requires CAP_SYS_NICE or a matching RLIMIT_NICE
+    param.sched_priority = 0;
+    int ret = pthread_setschedparam(pthread_self(), target, &param);
+    if(ret){
+        C_WARN("Unable to set thread policy to %s : %s",sched->idle ? "SCHED_IDLE" : "SCHED_OTHER",strerror(ret));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static int
+ThreadSched__apply_nice(const ThreadSched * sched){
+    pid_t tid = (pid_t) syscall(SYS_gettid);
+    //The main thread carries the process nice value, which is the base of the offset
+    errno = 0;
+    int base = getpriority(PRIO_PROCESS, getpid());
+    if(base == -1 && errno){
+        return FALSE;
+    }
+    int nice = base + sched->nice;
+    if(getpriority(PRIO_PROCESS, tid) == nice){
+        return TRUE;
+    }
+    //Lowering the nice value back requires CAP_SYS_NICE or a matching RLIMIT_NICE
+    if(setpriority(PRIO_PROCESS, tid, nice)){
+        C_WARN("Unable to set thread nice value to %d : %s",nice,strerror(errno));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static int
+ThreadSched__apply_cpus(const ThreadSched * sched){
+    cpu_set_t set;
+    int cpu;
+
+    CPU_ZERO(&set);
+    if(!sched->cpus || sched->exclude){
+        //Starts from the cores of the main thread, so clearing the mask undoes a previous pinning
+        if(sched_getaffinity(getpid(), sizeof(set), &set)){
+            return FALSE;
+        }
+        for(cpu=0;cpu<THREAD_SCHED_MAX_CPUS;cpu++){
+            if(sched->cpus & ((uint64_t) 1 << cpu)){
+                CPU_CLR(cpu, &set);
+            }
+        }
+    } else {
+        for(cpu=0;cpu<THREAD_SCHED_MAX_CPUS;cpu++){
+            if(sched->cpus & ((uint64_t) 1 << cpu)){
+                CPU_SET(cpu, &set);
+            }
+        }
+    }
+    if(!CPU_COUNT(&set)){
+        C_WARN("Thread cpu list leaves no core available. Affinity left unchanged.");
+        return FALSE;
+    }
+
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if(ret){
+        C_WARN("Unable to set thread affinity : %s",strerror(ret));
+        return FALSE;
+    }
+    return TRUE;
+}
+#endif
+
+int
+ThreadSched__apply(const ThreadSched * sched){
+    if(!sched){
+        return FALSE;
+    }
+#ifdef __linux__
+    int ret = ThreadSched__apply_policy(sched);
+    //SCHED_IDLE threads ignore their nice value
+    if(!sched->idle){
+        ret &= ThreadSched__apply_nice(sched);
+    }
+    ret &= ThreadSched__apply_cpus(sched);
+    return ret;
+#else
+    if(sched->nice || sched->idle || sched->cpus){
+        C_WARN("Thread scheduling isn't supported on this platform");
+        return FALSE;
+    }
+    return TRUE;
+#endif
+}
+
+void
+ThreadSched__set_name(const char * name){
+#ifdef __linux__
+    char buffer[THREAD_SCHED_NAME_LENGTH];
+    if(!name){
+        return;
+    }
+    strncpy(buffer, name, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+    pthread_setname_np(pthread_self(), buffer);
+#endif
+}
+
+int
+ThreadSched__equals(const ThreadSched * a, const ThreadSched * b){
+    return a->nice == b->nice && a->idle == b->idle && a->cpus == b->cpus && a->exclude == b->exclude;
+}
+
+static int
+ThreadSched__parse_cpu(const char ** pos){
+    char * end;
+    if(!isdigit((unsigned char) **pos)){
+        return -1;
+    }
+    long cpu = strtol(*pos, &end, 10);
+    if(cpu >= THREAD_SCHED_MAX_CPUS){
+        return -1;
+    }
+    *pos = end;
+    return (int) cpu;
+}
+
+int
+ThreadSched__parse_cpus(ThreadSched * sched, const char * list){
+    uint64_t cpus = 0;
+    int exclude = FALSE;
+    const char * pos = list ? list : "";
+
+    while(isspace((unsigned char) *pos)) pos++;
+    if(*pos == '^'){
+        exclude = TRUE;
+        pos++;
+    }
+    while(isspace((unsigned char) *pos)) pos++;
+    if(!*pos){
+        if(exclude){
+            return FALSE;
+        }
+        sched->cpus = 0;
+        sched->exclude = FALSE;
+        return TRUE;
+    }
+
+    for(;;){
+        int first = ThreadSched__parse_cpu(&pos);
+        int last = first;
+        if(first < 0){
+            return FALSE;
+        }
+        if(*pos == '-'){
+            pos++;
+            last = ThreadSched__parse_cpu(&pos);
+            if(last < first){
+                return FALSE;
+            }
+        }
+        for(;first<=last;first++){
+            cpus |= (uint64_t) 1 << first;
+        }
+
+        while(isspace((unsigned char) *pos)) pos++;
+        if(!*pos){
+            break;
+        }
+        if(*pos != ','){
+            return FALSE;
+        }
+        pos++;
+        while(isspace((unsigned char) *pos)) pos++;
+    }
+
+    sched->cpus = cpus;
+    sched->exclude = exclude;
+    return TRUE;
+}
+
+void
+ThreadSched__format_cpus(const ThreadSched * sched, char * buffer, int length){
+    int used = 0;
+    int cpu = 0;
+    if(length < 1){
+        return;
+    }
+    buffer[0] = '\0';
+    if(!sched->cpus){
+        return;
+    }
+    if(sched->exclude){
+        used += snprintf(buffer, length, "^");
+    }
+    while(cpu < THREAD_SCHED_MAX_CPUS && used < length){
+        if(!(sched->cpus & ((uint64_t) 1 << cpu))){
+            cpu++;
+            continue;
+        }
+        int last = cpu;
+        while(last + 1 < THREAD_SCHED_MAX_CPUS && (sched->cpus & ((uint64_t) 1 << (last + 1)))){
+            last++;
+        }
+        const char * separator = (used && buffer[used-1] != '^') ? "," : "";
+        if(last == cpu){
+            used += snprintf(buffer + used, length - used, "%s%d", separator, cpu);
+        } else {
+            used += snprintf(buffer + used, length - used, "%s%d-%d", separator, cpu, last);
+        }
+        cpu = last + 1;
+    }
+}
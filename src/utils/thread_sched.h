@@ -0,0 +1,39 @@
+#ifndef THREAD_SCHED_H_
+#define THREAD_SCHED_H_
+
+#include <stdint.h>
+
+#define THREAD_SCHED_MAX_CPUS 64
+#define THREAD_SCHED_NAME_LENGTH 16 //Including the null terminator, as limited by the kernel
+#define THREAD_SCHED_CPUS_LENGTH 192 //Longest formatted cpu list, "0,2,4,...,62"
+
+/*
+ * Scheduling applied by a thread on itself.
+ * nice is added to the process nice value, and idle moves the thread to SCHED_IDLE.
+ * cpus is a mask of allowed cores, or of excluded cores when exclude is set. 0 uses the cores of the main thread.
+ * Threads created afterward by the calling thread inherit all three.
+ */
+typedef struct {
+    int nice;
+    int idle;
+    uint64_t cpus;
+    int exclude;
+} ThreadSched;
+
+#define THREAD_SCHED_INIT { 0, 0, 0, 0 }
+
+//Applies sched on the calling thread. Returns FALSE if any setting was refused.
+int ThreadSched__apply(const ThreadSched * sched);
+//Truncated to THREAD_SCHED_NAME_LENGTH - 1 characters, so it shows up in 'top -H'
+void ThreadSched__set_name(const char * name);
+int ThreadSched__equals(const ThreadSched * a, const ThreadSched * b);
+
+/*
+ * Parses a cpu list like "0-1,3" into sched->cpus. A leading '^' excludes the listed cores instead.
+ * An empty list clears the mask. Returns FALSE and leaves sched unchanged on invalid input.
+ */
+int ThreadSched__parse_cpus(ThreadSched * sched, const char * list);
+//Formats sched->cpus back into a cpu list. Empty when the mask is clear.
+void ThreadSched__format_cpus(const ThreadSched * sched, char * buffer, int length);
+
+#endif